@@ -146,19 +146,14 @@ class PatchParser:
         }
 
     def parse_diff(self, workdir, hexsha):
-        line_changes = []
         commit = self.repo.get_commit(hexsha)
-        for f in commit.modified_files:
-            if f.change_type != ModificationType.MODIFY:
-                continue
-            for added in f.diff_parsed['added']:
-                line_changes.append('+' + f.new_path + ':' + str(added[0]))
-            for deleted in f.diff_parsed['deleted']:
-                line_changes.append('-' + f.old_path + ':' + str(deleted[0]))
-
         with open(os.path.join(workdir, 'diff.txt'), 'w') as f:
-            for line in line_changes:
-                f.write(line + '\n')
+            for modified in commit.modified_files:
+                if modified.change_type != ModificationType.MODIFY:
+                    continue
+                f.write('--- a/' + modified.old_path + '\n')
+                f.write('+++ b/' + modified.new_path + '\n')
+                f.write(modified.diff.rstrip('\n') + '\n')
         return os.path.join(workdir, 'diff.txt')
 
 
@@ -0,0 +1,61 @@
+#ifndef CLEARBLUE_CALLCONTEXT_H
+#define CLEARBLUE_CALLCONTEXT_H
+
+#include <llvm/IR/Function.h>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+// Lazily enumerates the call chains starting at a function, one chain per
+// path of the call graph, instead of materializing all of them up front.
+// Chains are cut after kLimit functions, so chains sharing the kLimit
+// functions closest to the start collapse into one, and the enumeration
+// stops once budget chains were yielded. A limit of 0 means unlimited.
+class CallContextIterator {
+public:
+  typedef map<Function *, set<Function *>> CallEdges;
+
+  // edges maps a function to the next functions of the chain, either its
+  // callers or its callees. isEnd forces a chain to end at a function.
+  // Chains are yielded from start to end, or reversed if upward is set.
+  CallContextIterator(Function *func, const CallEdges &edges,
+                      function<bool(Function *)> isEnd, bool upward,
+                      unsigned kLimit = 0, unsigned budget = 0);
+
+  // store the next call chain into context, false once all chains were
+  // yielded or the budget is hit
+  bool next(vector<Function *> &context);
+
+  bool isBudgetHit() const { return budgetHit; }
+
+  unsigned getNumYielded() const { return numYielded; }
+
+private:
+  struct Frame {
+    set<Function *>::const_iterator cur, end;
+    bool isLeaf;
+    bool yielded;
+  };
+
+  const CallEdges &edges;
+  function<bool(Function *)> isEnd;
+  bool upward;
+  unsigned kLimit;
+  unsigned budget;
+
+  unsigned numYielded = 0;
+  bool budgetHit = false;
+
+  vector<Function *> curChain;
+  vector<Frame> frames;
+
+  void enter(Function *func);
+
+  bool isOnChain(Function *func) const;
+};
+
+#endif // CLEARBLUE_CALLCONTEXT_H
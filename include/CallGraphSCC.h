@@ -0,0 +1,46 @@
+#ifndef CLEARBLUE_CALLGRAPHSCC_H
+#define CLEARBLUE_CALLGRAPHSCC_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Function.h>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+// Strongly connected components of the call graph, computed once with an
+// iterative Tarjan so that recursion neither throws nor overflows the stack.
+// SCC ids are in reverse topological order: the SCCs a function calls into
+// always have smaller ids than its own SCC.
+class CallGraphSCC {
+public:
+  typedef map<Function *, set<Function *>> CallEdges;
+
+  void build(const CallEdges &caller2Callee);
+
+  // the SCC of func, -1 if func is not in the call graph
+  int getSCC(Function *func) const;
+
+  const vector<Function *> &getMembers(unsigned scc) const {
+    return members[scc];
+  }
+
+  // the SCCs called from scc, without scc itself
+  const vector<unsigned> &getSuccs(unsigned scc) const { return succs[scc]; }
+
+  // whether the functions of scc call each other, or a function of scc
+  // calls itself
+  bool isRecursive(unsigned scc) const { return recursive[scc]; }
+
+  unsigned size() const { return members.size(); }
+
+private:
+  DenseMap<Function *, unsigned> func2SCC;
+  vector<vector<Function *>> members;
+  vector<vector<unsigned>> succs;
+  vector<bool> recursive;
+};
+
+#endif // CLEARBLUE_CALLGRAPHSCC_H
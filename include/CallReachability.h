@@ -0,0 +1,29 @@
+#ifndef CLEARBLUE_CALLREACHABILITY_H
+#define CLEARBLUE_CALLREACHABILITY_H
+
+#include "CallGraphSCC.h"
+#include <llvm/ADT/BitVector.h>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+// Transitive-callee index over the SCCs of the call graph. Every SCC keeps a
+// bitset of the SCCs it reaches through one or more calls, computed once in
+// reverse topological order, so a query is a hash lookup plus a bit test and
+// does not allocate.
+class CallReachability {
+public:
+  void build(const CallGraphSCC &callGraphSCC);
+
+  // whether callee is reached from caller through at least one call
+  bool reaches(Function *caller, Function *callee) const;
+
+  size_t size() const { return reachable.size(); }
+
+private:
+  const CallGraphSCC *SCCs = nullptr;
+  vector<BitVector> reachable;
+};
+
+#endif // CLEARBLUE_CALLREACHABILITY_H
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "IR/SEG/SymbolicExprGraphSolver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/raw_ostream.h"
+#include <deque>
+#include <map>
+#include <unordered_map>
 #include <vector>
 
 class EnhancedSEGWrapper;
@@ -20,12 +24,19 @@ enum NodeType {
   NODE_VAR,
 };
 
+class ConditionNode;
+
+typedef SmallVector<ConditionNode *, 2> ConditionChildren;
+
 class ConditionNode {
 public:
   NodeType type;
-  LLVMContext context;
   SEGNodeBase *value = nullptr;
-  vector<ConditionNode *> children;
+  ConditionChildren children;
+
+  // structural hash and unique id, only set on interned nodes
+  size_t hash = 0;
+  unsigned id = 0;
 
   EnhancedSEGWrapper *SEGWrapper;
 
@@ -44,8 +55,12 @@ public:
     this->children.clear();
   }
 
+  // structurally equal up to the order of AND/OR operands, or mergeable
   bool isEqual(ConditionNode *other);
 
+  // the structural comparison of isEqual that also merges sub-conditions
+  bool isMergeEqual(ConditionNode *other);
+
   // Add child node
   void addChild(ConditionNode *child) { children.push_back(child); }
 
@@ -153,14 +168,57 @@ public:
   void addUnique(vector<ConditionNode *> &list, ConditionNode *node);
 };
 
+// Owns the ConditionNodes of one analysis and interns them: conditions
+// that are structurally equal up to the order of AND/OR operands map to the
+// same canonical node, so comparing them is a pointer compare.
+class ConditionArena {
+  deque<ConditionNode> nodes;
+  unordered_map<size_t, SmallVector<ConditionNode *, 1>> buckets;
+  unsigned numInterned = 0;
+
+public:
+  template <typename... Args> ConditionNode *create(Args &&...args) {
+    nodes.emplace_back(std::forward<Args>(args)...);
+    return &nodes.back();
+  }
+
+  // the canonical node of the current structure of node; canonical nodes
+  // are shared and must not be mutated
+  ConditionNode *intern(ConditionNode *node);
+
+  // a mutable deep copy of node
+  ConditionNode *clone(ConditionNode *node);
+
+  // interned simplified form of interned conditions, keyed by their id,
+  // nullptr if the condition never holds
+  map<unsigned, ConditionNode *> simplifiedById;
+
+  size_t size() const { return nodes.size(); }
+};
+
 class ConditionTree {
 
 public:
+  // one bit per assignment of the atoms, 64 assignments per word
+  typedef vector<uint64_t> TruthTable;
+
+  // evaluate node under the assignments in atomTables, all of the same
+  // size; like simplifyConst, constants constrain nothing and are dropped
+  // from their parent, false if node is dropped as a whole. As in
+  // toSMTExpr, an empty OR is false and an empty AND is true.
+  static bool evaluate(ConditionNode *node,
+                       const map<SEGNodeBase *, TruthTable> &atomTables,
+                       TruthTable &table);
+
   static ConditionNode *parseFromString(string str,
                                         EnhancedSEGWrapper *SEGWrapper,
                                         set<SEGNodeBase *> nodeSet);
+  // minimal sum of prime implicants of node, NODE_CONST if nothing
+  // constrains it and nullptr if it never holds; node is left untouched
   static ConditionNode *simplifyCondition(EnhancedSEGWrapper *SEGWrapper,
                                           ConditionNode *node);
+
+  // the simplified condition under which node2 holds but node1 does not
   static ConditionNode *diffCondition(ConditionNode *node1,
                                       ConditionNode *node2);
 };
@@ -1,11 +1,16 @@
 #ifndef CLEARBLUE_ENHANCEDSEG_H
 #define CLEARBLUE_ENHANCEDSEG_H
 
+#include "CallContext.h"
+#include "CallGraphSCC.h"
+#include "CallReachability.h"
 #include "ConditionNode.h"
 #include "DriverSpecs.h"
 #include "NodeHelper.h"
 #include "SensitiveOps.h"
+#include "TracePool.h"
 #include "UtilsHelper.h"
+#include "ValueFlowPathDAG.h"
 #include <llvm/Support/Casting.h>
 #include <queue>
 #include <utility>
@@ -28,6 +33,56 @@ using namespace std;
 
 typedef ControlDependenceGraph::CDType CDType;
 
+// kinds of input and output nodes a value-flow trace may yield, one bit per
+// InputType and one bit per OutputType
+typedef unsigned IOKindMask;
+
+const IOKindMask IO_MASK_ALL = ~0u;
+
+const IOKindMask IO_MASK_INPUTS = 0xffffu;
+
+const IOKindMask IO_MASK_OUTPUTS = ~IO_MASK_INPUTS;
+
+inline IOKindMask inputKindMask(InputType type) { return 1u << type; }
+
+inline IOKindMask outputKindMask(OutputType type) { return 1u << (16 + type); }
+
+struct seg_patch_cmp {
+  LLVMValueIndexer *instance;
+  seg_patch_cmp() : instance(LLVMValueIndexer::get()) {}
+
+  bool operator()(const SEGObject *A, const SEGObject *B) const {
+    if (!A || !B) {
+      // Handle null pointers explicitly
+      return A < B;
+    }
+    StringRef funcSEGA = "";
+    StringRef funcSEGB = "";
+    if (A && A->getParentGraph() && A->getParentGraph()->getBaseFunc() &&
+        A->getParentGraph()->getBaseFunc()->hasName()) {
+      funcSEGA = A->getParentGraph()->getBaseFunc()->getName();
+    }
+    if (B && B->getParentGraph() && B->getParentGraph()->getBaseFunc() &&
+        B->getParentGraph()->getBaseFunc()->hasName()) {
+      funcSEGB = B->getParentGraph()->getBaseFunc()->getName();
+    }
+
+    if (funcSEGA != funcSEGB) {
+      return funcSEGA < funcSEGB;
+    } else {
+      int indexSEGA = A ? A->getSEGIndex() : -1;
+      int indexSEGB = B ? B->getSEGIndex() : -1;
+      if (indexSEGA != indexSEGB || (indexSEGA == -1 && indexSEGB == -1)) {
+        return indexSEGA < indexSEGB;
+      } else {
+        int indexA = A ? A->getObjIndex() : -1;
+        int indexB = B ? B->getObjIndex() : -1;
+        return indexA < indexB;
+      }
+    }
+  }
+};
+
 struct SEGTraceWithBB {
   vector<SEGObject *> trace;
   vector<BasicBlock *> bbs;
@@ -35,12 +90,13 @@ struct SEGTraceWithBB {
   SEGTraceWithBB(){};
 
   SEGTraceWithBB(vector<SEGObject *> trace, vector<BasicBlock *> bbs)
-      : trace(trace), bbs(bbs){};
+      : trace(std::move(trace)), bbs(std::move(bbs)){};
 
-  SEGTraceWithBB(SEGTraceWithBB const &trace1) {
-    trace = trace1.trace;
-    bbs = trace1.bbs;
-  };
+  // movable, so traces handed over to sets and enhanced traces are not copied
+  SEGTraceWithBB(SEGTraceWithBB const &trace1) = default;
+  SEGTraceWithBB(SEGTraceWithBB &&trace1) = default;
+  SEGTraceWithBB &operator=(SEGTraceWithBB const &trace1) = default;
+  SEGTraceWithBB &operator=(SEGTraceWithBB &&trace1) = default;
 
   bool operator==(const SEGTraceWithBB &trace1) const {
     return trace == trace1.trace && bbs == trace1.bbs;
@@ -126,6 +182,58 @@ struct SEGTraceWithBB {
   }
 };
 
+// a trace emitted by intra slicing, its objects kept in the TracePool of the
+// slicing state. Only the handle and blocks are held until the trace is
+// enhanced, which reads the objects back into a SEGTraceWithBB.
+struct PooledSEGTrace {
+  TracePool::Handle handle;
+  vector<BasicBlock *> bbs;
+
+  // set if the trace is already cut from its input node at startIdx to its
+  // output node at endIdx, -1 otherwise
+  int startIdx = -1;
+  int endIdx = -1;
+
+  PooledSEGTrace(TracePool::Handle handle, vector<BasicBlock *> bbs,
+                 int startIdx = -1, int endIdx = -1)
+      : handle(handle), bbs(std::move(bbs)), startIdx(startIdx),
+        endIdx(endIdx){};
+
+  // equal traces share a handle; like SEGTraceWithBB, bbs are not compared
+  bool operator<(const PooledSEGTrace &trace1) const {
+    return handle < trace1.handle;
+  }
+};
+
+// orders traces by their objects with seg_patch_cmp, i.e. independent of
+// where the objects were allocated
+struct seg_trace_cmp {
+  bool operator()(const vector<SEGObject *> &A,
+                  const vector<SEGObject *> &B) const {
+    return lexicographical_compare(A.begin(), A.end(), B.begin(), B.end(),
+                                   seg_patch_cmp());
+  }
+
+  bool operator()(const SEGTraceWithBB &A, const SEGTraceWithBB &B) const {
+    return (*this)(A.trace, B.trace);
+  }
+};
+
+// orders input or output nodes by the SEG objects they use, then by type
+struct io_node_cmp {
+  template <typename IONode>
+  bool operator()(const IONode *A, const IONode *B) const {
+    seg_patch_cmp cmp;
+    if (A->usedNode != B->usedNode) {
+      return cmp(A->usedNode, B->usedNode);
+    }
+    if (A->usedSite != B->usedSite) {
+      return cmp(A->usedSite, B->usedSite);
+    }
+    return A->type < B->type;
+  }
+};
+
 struct EnhancedSEGTrace {
   SEGTraceWithBB trace;
   ConditionNode *conditions;
@@ -134,6 +242,9 @@ struct EnhancedSEGTrace {
   InputNode *input_node;
   OutputNode *output_node;
 
+  // unique per run, set once the trace is interned by internTrace
+  unsigned id = 0;
+
   // just to use set
   bool operator<(const EnhancedSEGTrace &trace1) const {
     return trace < trace1.trace;
@@ -148,9 +259,8 @@ struct EnhancedSEGTrace {
 
   EnhancedSEGTrace(){};
 
-  EnhancedSEGTrace(vector<SEGObject *> inter, vector<BasicBlock *> bbs) {
-    trace = SEGTraceWithBB(inter, bbs);
-  };
+  EnhancedSEGTrace(vector<SEGObject *> inter, vector<BasicBlock *> bbs)
+      : trace(std::move(inter), std::move(bbs)){};
 
   EnhancedSEGTrace(EnhancedSEGTrace const &trace1) {
     trace = trace1.trace;
@@ -163,7 +273,93 @@ struct EnhancedSEGTrace {
   EnhancedSEGTrace(SEGTraceWithBB &segTrace) : trace(segTrace){};
 };
 
+// orders interned traces by id, i.e. by the order they were collected in, so
+// iterating over traces does not depend on where they were allocated
+struct enhanced_trace_cmp {
+  bool operator()(const EnhancedSEGTrace *A, const EnhancedSEGTrace *B) const {
+    return A->id < B->id;
+  }
+};
+
+typedef set<EnhancedSEGTrace *, enhanced_trace_cmp> EnhancedTraceSet;
+typedef map<EnhancedSEGTrace *, EnhancedSEGTrace *, enhanced_trace_cmp>
+    EnhancedTraceMap;
+
+// The control-dependence paths between two basic blocks, shared as a DAG.
+// Each path stands for the conjunction of its branch literals; a terminal
+// node also holds the empty path, i.e. the unconditional one.
+struct CDGuardNode {
+  bool terminal = false;
+  vector<pair<pair<BasicBlock *, CDType>, CDGuardNode *>> succs;
+
+  // no path goes through this node
+  bool isDead() const { return !terminal && succs.empty(); }
+};
+
 // Data Flow + Control Flow + Flow Order
+// value-flow paths inside one function, from an entry node to where the
+// inter-procedural slicing either stops or crosses into a caller or callee
+struct InterFlowSummary {
+  // the segments are found depth-first and share their prefixes, so they are
+  // kept as a prefix tree: each step is an object with the index of the step
+  // before it, or -1, and a segment is the index of its last step
+  vector<pair<SEGObject *, int>> steps;
+  vector<int> segmentEnds;
+  // whether the last node of the segment crosses the function boundary,
+  // otherwise the trace ends with the segment
+  vector<bool> crossesBoundary;
+
+  size_t size() const { return segmentEnds.size(); }
+
+  void addSegment(const vector<SEGObject *> &segment, bool crosses);
+
+  // append segment i to trace, returns the number of objects appended
+  size_t appendSegment(size_t i, vector<SEGObject *> &trace) const;
+
+private:
+  // steps of the segment added last, reused by the next one for the prefix
+  // they share
+  vector<int> lastPath;
+};
+
+// memo state of intra slicing. A state only holds entries for the SEGs it has
+// sliced, so states of disjoint SEGs can be filled in parallel and merged.
+struct IntraSlicingState {
+  // shared storage of intra value-flow paths
+  ValueFlowPathDAG pathDAG;
+  // keyed by node and the IO kinds the rest of the trace already offers
+  map<pair<SEGNodeBase *, IOKindMask>, PathDAGNode *> backwardVisited;
+  map<pair<SEGNodeBase *, IOKindMask>, PathDAGNode *> forwardVisited;
+
+  // input/output kinds of SEG nodes and of all nodes reachable from them
+  map<SEGNodeBase *, IOKindMask> localIOMask;
+  map<SEGNodeBase *, IOKindMask> backwardIOMask;
+  map<SEGNodeBase *, IOKindMask> forwardIOMask;
+
+  // traces already joined at a criterion; the emitted PooledSEGTrace refer
+  // to them by handle
+  TracePool visitedTraces;
+
+  int collect_concat_time = 0;
+  int collect_forward_time = 0;
+  int collect_backward_time = 0;
+
+  int count_obtain_backward_cache = 0;
+  int count_obtain_forward_cache = 0;
+  int count_pruned_criteria = 0;
+
+  explicit IntraSlicingState(unsigned dagTag = 0) : pathDAG(dagTag) {}
+
+  // take over all entries of other, which must not share SEGs with this;
+  // traceRemap receives the handle here of each trace handle of other
+  void merge(IntraSlicingState &other, vector<TracePool::Handle> &traceRemap);
+
+  // copy the memoized paths and masks of other for the nodes of graph, so a
+  // task slicing graph reuses earlier slicing. Visited traces are not copied,
+  // a task may emit them again and they fold into one when merged.
+  void seed(IntraSlicingState &other, const SymbolicExprGraph *graph);
+};
+
 class EnhancedSEGWrapper {
   SymbolicExprGraphBuilder *SEGBuilder;
 
@@ -175,9 +371,16 @@ class EnhancedSEGWrapper {
 
   map<SEGOperandNode *, pair<int, int>> nodeFlowOrder;
 
+  // SCCs of the call graph, reachability queries run on their DAG;
+  // caller2CalleeMap and callee2CallerMap keep every call, recursive ones
+  // included, and context enumeration cuts the cycles itself
+  CallGraphSCC callGraphSCC;
   map<Function *, set<Function *>> caller2CalleeMap;
   map<Function *, set<Function *>> callee2CallerMap;
 
+  // transitive callees over callGraphSCC, for isTransitiveCallee
+  CallReachability callReachability;
+
   map<Function *, set<vector<Function *>>> caller2AllCallers;
   map<Function *, set<vector<Function *>>> caller2AllCallees;
 
@@ -189,22 +392,30 @@ class EnhancedSEGWrapper {
   map<vector<pair<BasicBlock *, CDType>>, SMTSolver::SMTResultType>
       feasibilityBBPaths;
 
+  // branch literals of checkPathsFeasibility and their SMT encoding
+  map<pair<BasicBlock *, CDType>, ConditionNode *> bbLiterals;
+  map<pair<BasicBlock *, CDType>, SMTExpr> bbLiteralExprs;
+
+  // minimal sets of branch literals that cannot hold together, kept for the
+  // whole patch; a path containing any of them is infeasible
+  vector<vector<pair<BasicBlock *, CDType>>> infeasibleCores;
+  map<pair<BasicBlock *, CDType>, vector<unsigned>> literal2InfeasibleCores;
+
+  // symbolic guards of -symbolic-path-condition, per (start, end) pair
+  deque<CDGuardNode> cdGuardNodes;
+  map<pair<BasicBlock *, BasicBlock *>, CDGuardNode *> cdGuardMemo;
+  map<pair<BasicBlock *, BasicBlock *>, CDGuardNode *> startEndBBsToGuard;
+
   map<pair<Instruction *, Instruction *>, bool> reachabilityMap;
 
   DenseMap<CBCallGraphNode *, DenseMap<CBCallGraphNode *, set<SEGCallSite *>>>
       func2AllCallsites;
-  DenseMap<pair<Function *, Function *>,
-           set<pair<Function *, pair<SEGCallSite *, SEGCallSite *>>>>
-      commonCaller2CS;
-  DenseMap<CBCallGraphNode *, int> dfn;
-  DenseMap<CBCallGraphNode *, int> low;
-  int token;
-  stack<CBCallGraphNode *> tarjanStack;
-  set<CBCallGraphNode *> isInStack;
-  DenseMap<CBCallGraphNode *, set<CBCallGraphNode *>> SCCs;
-  DenseMap<CBCallGraphNode *, DenseMap<CBCallGraphNode *, set<SEGCallSite *>>>
+  // transitive callers of a function with the call sites leading to it,
+  // sorted by caller so that common callers are found by a merge
+  typedef vector<pair<Function *, vector<Instruction *>>> CallerSites;
+  map<Function *, CallerSites> func2CallerSites;
+  DenseMap<unsigned, DenseMap<CBCallGraphNode *, set<SEGCallSite *>>>
       SCC2CallerCS;
-  DenseMap<CBCallGraphNode *, CBCallGraphNode *> node2SCCRoot;
 
   set<pair<ConditionNode *, ConditionNode *>> cacheReducedAB;
   set<pair<ConditionNode *, ConditionNode *>> cacheConflictAB;
@@ -212,37 +423,49 @@ class EnhancedSEGWrapper {
 
   map<Value *, bool> whetherICMPIO;
 
-  set<vector<SEGObject *>> visitedTraces;
-
   void computeCallGraph();
 
   void computeIndirectCall();
 
   int collect_traces_time = 0;
   int collect_condition_time = 0;
-  int collect_concat_time = 0;
-  int collect_forward_time = 0;
-  int collect_backward_time = 0;
 
   int collect_inter_forward_time = 0;
   int collect_inter_backward_time = 0;
 
-  int count_obtain_backward_cache = 0;
-  int count_obtain_forward_cache = 0;
-
   int collect_bb_path = 0;
   int collect_whole_smt = 0;
   int check_feasibile_time = 0;
   int check_whether_io = 0;
   int collect_trace_smt = 0;
+  int count_core_pruned_paths = 0;
+
+  // every ConditionNode of this analysis
+  ConditionArena conditionArena;
+
+  // every interned EnhancedSEGTrace of this analysis, bucketed by hash
+  vector<unique_ptr<EnhancedSEGTrace>> traceStore;
+  unordered_map<size_t, SmallVector<EnhancedSEGTrace *, 1>> traceBuckets;
 
 public:
   Module *M;
   SymbolicExprGraphSolver *SEGSolver;
-  map<SEGNodeBase *, set<vector<SEGObject *>>> backwardIntraVisited;
-  map<SEGNodeBase *, set<vector<SEGObject *>>> forwardIntraVisited;
-  map<SEGNodeBase *, set<vector<SEGObject *>>> cond2ValueFlowsIntra;
+  // memo state of all sequential intra slicing and of merged parallel tasks
+  IntraSlicingState intraSlicing;
+  // states merged into intraSlicing, kept alive as they own DAG nodes
+  vector<unique_ptr<IntraSlicingState>> mergedSlicing;
+  map<SEGNodeBase *, PathDAGNode *> cond2ValueFlowsIntra;
   map<SEGNodeBase *, set<vector<SEGObject *>>> cond2ValueFlowsInter;
+  // SMT encodings shared by all queries of a run: conditions by interned
+  // id, their data dependence by (interned id, inter), the opcode constraint
+  // of each icmp and the dependence traces of each operand by (node, inter)
+  map<unsigned, SMTExpr> condExprs;
+  map<pair<unsigned, bool>, SMTExpr> condDepExprs;
+  map<SEGNodeBase *, SMTExpr> icmpExprs;
+  map<pair<SEGNodeBase *, bool>, SMTExpr> depFlowExprs;
+  // per entry node, shared by all call chains going through its function
+  map<SEGNodeBase *, InterFlowSummary> backwardInterSummaries;
+  map<SEGNodeBase *, InterFlowSummary> forwardInterSummaries;
 
   EnhancedSEGWrapper(Module *pM, SymbolicExprGraphBuilder *pSEGBuilder,
                      SymbolicExprGraphSolver *pSEGSolver,
@@ -264,28 +487,47 @@ public:
 
   string getCallSourceFile(Function *F);
 
+  // the formula of condNode, encoded once per distinct condition
+  SMTExpr condNode2SMTExpr(ConditionNode *condNode);
+
   SMTExpr condNode2SMTExprInter(ConditionNode *condNode);
 
   SMTExpr condNode2SMTExprIntra(ConditionNode *condNode);
 
+  // cond2ValueFlows must be views of cond2ValueFlowsInter/Intra, the
+  // encodings of their traces are cached per node. cacheable is cleared if
+  // an operand has no flows yet, so the result may differ by a later query
   SMTExpr condDataDepToExpr(
       ConditionNode *curNode,
-      map<SEGNodeBase *, set<vector<SEGObject *>>> &cond2ValueFlows);
+      map<SEGNodeBase *, set<vector<SEGObject *>>> &cond2ValueFlows,
+      bool &cacheable);
+
+  SMTExpr condDataDepToExpr(ConditionNode *curNode,
+                            map<SEGNodeBase *, PathDAGNode *> &cond2ValueFlows,
+                            bool &cacheable);
+
+  SMTExpr condDataDepToExpr(
+      ConditionNode *curNode, bool inter,
+      const function<bool(SEGNodeBase *)> &hasDepFlows,
+      const function<void(SEGNodeBase *, SMTExprVec &)> &collectDepExprs,
+      bool &cacheable);
+
+  SMTExpr depTraceToExpr(const vector<SEGObject *> &depTrace);
 
   void value2EnhancedSEGNode(set<Value *> &values, set<SEGNodeBase *> &nodes);
 
   void condNode2FlowInter(
       set<SEGNodeBase *> condNodes,
       map<SEGNodeBase *, set<vector<SEGObject *>>> &localCond2ValueFlows);
-  void condNode2FlowIntra(
-      set<SEGNodeBase *> condNodes,
-      map<SEGNodeBase *, set<vector<SEGObject *>>> &localCond2ValueFlows);
+  void
+  condNode2FlowIntra(set<SEGNodeBase *> condNodes,
+                     map<SEGNodeBase *, PathDAGNode *> &localCond2ValueFlows);
 
-  void obtainIntraEnhancedSlicing(set<SEGTraceWithBB> intraSEGTraces,
-                                  set<EnhancedSEGTrace *> &intraTraces);
+  void obtainIntraEnhancedSlicing(const set<PooledSEGTrace> &intraSEGTraces,
+                                  EnhancedTraceSet &intraTraces);
 
   void obtainInterSlicing(EnhancedSEGTrace *intraTrace,
-                          set<EnhancedSEGTrace *> &interTraces);
+                          EnhancedTraceSet &interTraces);
 
   void collectRelatedBBs(vector<SEGObject *> &trace, int index,
                          vector<BasicBlock *> &curbbOnTraces,
@@ -305,25 +547,99 @@ public:
 
   void collectConditions(EnhancedSEGTrace *trace);
 
+  vector<BasicBlock *> obtainBBsOnTrace(EnhancedSEGTrace *trace);
+
   void
   collectBBsToEntry(EnhancedSEGTrace *trace,
                     set<vector<pair<BasicBlock *, CDType>>> &totalCFGPaths);
 
+  // guard the trace by the conjunction of the guards between its basic
+  // blocks, without enumerating the paths
+  void collectConditionsOnCDGuard(EnhancedSEGTrace *trace);
+
+  CDGuardNode *getCDGuard(BasicBlock *startBB, BasicBlock *endBB);
+
+  // inProgress maps the dependents on the current path to the depth they
+  // were entered at. cutDepth is lowered to the depth of the shallowest
+  // dependent a cycle was cut at; a guard is only memoized if all its cuts
+  // are within its own search, as otherwise it depends on the path to it.
+  CDGuardNode *
+  computeCDGuard(BasicBlock *startBB, BasicBlock *endBB,
+                 map<pair<BasicBlock *, CDType>, unsigned> &inProgress,
+                 unsigned &cutDepth);
+
+  CDGuardNode *paths2CDGuard(set<vector<pair<BasicBlock *, CDType>>> &paths);
+
+  // the OR over the paths from guard that pass a literal of guardedTrace,
+  // nullptr if none does; literalFree is set if some path passes none. memo
+  // holds both for the guard nodes already converted for guardedTrace,
+  // which the DAG shares.
+  ConditionNode *
+  cdGuard2IOCondition(CDGuardNode *guard, vector<SEGObject *> &guardedTrace,
+                      map<CDGuardNode *, pair<ConditionNode *, bool>> &memo,
+                      bool &literalFree);
+
   bool isConditionMerge(ConditionNode *curCond, ConditionNode *otherCond);
 
   bool isConditionConflict(ConditionNode *curCond, ConditionNode *otherCond);
 
   bool isConditionAReduceB(ConditionNode *curCond, ConditionNode *otherCond);
 
-  void intraValueFlow(SEGNodeBase *criterion, set<SEGTraceWithBB> &intraTraces);
+  // goalDirected prunes traces that cannot connect an input to an output,
+  // only for criteria whose traces seed no further criteria
+  void intraValueFlow(SEGNodeBase *criterion, set<PooledSEGTrace> &intraTraces,
+                      bool goalDirected = false);
+
+  // slice with a task-local state; only touches the SEG of criterion and
+  // state, so tasks on distinct SEGs may run concurrently
+  void intraValueFlow(SEGNodeBase *criterion, set<PooledSEGTrace> &intraTraces,
+                      IntraSlicingState &state, bool goalDirected = false);
+
+  // traces emitted with state are moved to intraSlicing by traceRemap
+  void mergeIntraSlicing(unique_ptr<IntraSlicingState> state,
+                         vector<TracePool::Handle> &traceRemap);
+
+  // give each duplicated constant incoming of phiNode a node of its own, so
+  // every incoming block keeps a distinct value flow. This adds nodes to the
+  // SEG of phiNode and is a no-op once done.
+  void normalizePhiIncomings(SEGPhiNode *phiNode);
+
+  // normalizePhiIncomings for all phi nodes of SEG; must not run while the SEG
+  // is being sliced
+  void normalizePhiIncomings(SymbolicExprGraph *SEG);
+
+  // meet-in-the-middle at the criterion: join the backward halves starting at
+  // an input with the sink-ended forward prefixes whose output kinds match
+  // and emit only the connecting sub-traces
+  void joinIntraPathsAtCriterion(IntraSlicingState &state,
+                                 PathDAGNode *backwardPaths,
+                                 PathDAGNode *forwardPaths,
+                                 set<PooledSEGTrace> &intraTraces);
 
   bool checkifICMPIO(ICmpInst *iCmpInst, vector<SEGObject *> &guardedTrace);
 
-  void intraValueFlowBackward(SEGNodeBase *node, vector<SEGObject *> &curTrace,
-                              set<vector<SEGObject *>> &backwards);
+  // return the DAG of paths from node, or nullptr if node closes a def-use
+  // cycle on the current trace. Paths that cannot complete an input/output
+  // pair together with context are pruned.
+  PathDAGNode *intraValueFlowBackward(IntraSlicingState &state,
+                                      SEGNodeBase *node,
+                                      set<SEGNodeBase *> &onTrace,
+                                      IOKindMask context = IO_MASK_ALL);
+
+  PathDAGNode *intraValueFlowForward(IntraSlicingState &state,
+                                     SEGNodeBase *node,
+                                     set<SEGNodeBase *> &onTrace,
+                                     IOKindMask context = IO_MASK_ALL);
+
+  IOKindMask getLocalIOMask(IntraSlicingState &state, SEGNodeBase *node);
 
-  void intraValueFlowForward(SEGNodeBase *node, vector<SEGObject *> &curTrace,
-                             set<vector<SEGObject *>> &forwards);
+  IOKindMask getIOReachMask(IntraSlicingState &state, SEGNodeBase *node,
+                            bool backward);
+
+  void nextIntraNodes(SEGNodeBase *node, bool backward,
+                      vector<SEGNodeBase *> &nextNodes);
+
+  bool isIOMaskMatched(IOKindMask mask);
 
   void interValueFlowBackward(SEGNodeBase *node, vector<Function *> &callTrace,
                               vector<SEGObject *> &curTrace,
@@ -333,17 +649,30 @@ public:
                              vector<SEGObject *> &curTrace,
                              set<vector<SEGObject *>> &forwardInters);
 
-  void findCallSite(Function *Caller, Function *Callee,
-                    vector<SEGCallSite *> &callSites);
+  const InterFlowSummary &getInterFlowSummary(SEGNodeBase *node,
+                                              bool backward);
+
+  void summarizeBackward(SEGNodeBase *node, vector<SEGObject *> &segment,
+                         InterFlowSummary &summary);
 
-  static void removeCallGraphCycle(map<Function *, set<Function *>> &graph,
-                                   map<Function *, set<Function *>> &tree);
+  void summarizeForward(SEGNodeBase *node, vector<SEGObject *> &segment,
+                        InterFlowSummary &summary);
+
+  // continue the slicing in the caller or callee of the last node of curTrace
+  void crossBackwardBoundary(vector<Function *> &callTrace,
+                             vector<SEGObject *> &curTrace,
+                             set<vector<SEGObject *>> &backwardInters);
 
-  void funcCallLowerTracer(Function *func, vector<Function *> &curTrace,
-                           set<vector<Function *>> &traces);
+  void crossForwardBoundary(vector<Function *> &callTrace,
+                            vector<SEGObject *> &curTrace,
+                            set<vector<SEGObject *>> &forwardInters);
+
+  void findCallSite(Function *Caller, Function *Callee,
+                    vector<SEGCallSite *> &callSites);
 
-  void funcCallUpperTracer(Function *func, vector<Function *> &curTrace,
-                           set<vector<Function *>> &traces);
+  // call chains from the entries of the call graph down to func, yielded
+  // lazily within the configured depth and budget
+  CallContextIterator callerContexts(Function *func);
 
   bool needForward(SEGNodeBase *node);
 
@@ -353,31 +682,57 @@ public:
 
   bool checkCurPathFeasibility(vector<pair<BasicBlock *, CDType>> path);
 
+  // check the paths on a trie of their common prefixes with incremental
+  // push/pop, filling feasibilityBBPaths
+  void
+  checkPathsFeasibility(const set<vector<pair<BasicBlock *, CDType>>> &paths);
+
+  // whether the prefix literals plus bbInfo contain a known infeasible core
+  bool containsInfeasibleCore(
+      const map<pair<BasicBlock *, CDType>, unsigned> &prefixLiterals,
+      pair<BasicBlock *, CDType> bbInfo);
+
+  // bbInfo made the prefix unsat, record a minimal core of the conflict;
+  // prefix and bbInfo are asserted on one solver level each, the core is
+  // minimized without them and they are asserted again afterwards
+  void learnInfeasibleCore(const vector<pair<BasicBlock *, CDType>> &prefix,
+                           pair<BasicBlock *, CDType> bbInfo);
+
+  // the branch literal of bbInfo, nullptr if it is not a comparison
+  ConditionNode *bbInfo2Condition(pair<BasicBlock *, CDType> bbInfo);
+
+  // nullptr if the branch does not compare an input or output
+  ConditionNode *bbInfo2IOCondition(pair<BasicBlock *, CDType> bbInfo,
+                                    vector<SEGObject *> &guardedTrace);
+
   ConditionNode *path2IOCondition(vector<pair<BasicBlock *, CDType>> path,
                                   vector<SEGObject *> &guardedTrace);
 
-  void canFindInput(vector<SEGObject *> trace, set<InputNode *> &inputNodes,
-                    bool intra = false);
+  void canFindInput(const vector<SEGObject *> &trace,
+                    set<InputNode *> &inputNodes, bool intra = false);
 
-  void canFindOutput(vector<SEGObject *> trace, set<OutputNode *> &outputNodes,
-                     bool isBenign, bool intra = false);
+  void canFindOutput(const vector<SEGObject *> &trace,
+                     set<OutputNode *> &outputNodes, bool isBenign,
+                     bool intra = false);
 
   bool ifInOutputMatch(InputNode *start, OutputNode *end);
 
-  void Tarjan(CBCallGraphNode *node);
+  bool ifInOutputTypeMatch(InputType start, OutputType end);
+
+  // the SCC of a function on a recursion through other functions, -1 if the
+  // function is not on such a recursion
+  int getRecursiveSCC(CBCallGraphNode *node);
 
   bool check_reachability_inter(Instruction *src_inst, Instruction *dst_inst);
 
-  void find_common_caller(
-      Function *func1, Function *func2,
-      set<pair<Function *, pair<SEGCallSite *, SEGCallSite *>>> &func2cs);
+  const CallerSites &getCallerSites(Function *func);
 
   void find_all_callers_bfs(
       CBCallGraphNode *node,
       DenseMap<CBCallGraphNode *, set<SEGCallSite *>> &caller2cs);
 
   void
-  updateTraceOrder(map<SEGNodeBase *, set<EnhancedSEGTrace *>> &groupedTraces);
+  updateTraceOrder(map<SEGNodeBase *, EnhancedTraceSet> &groupedTraces);
 
   void findLastIcmp(BasicBlock *bb, set<ICmpInst *> &icmpInsts);
 
@@ -387,10 +742,29 @@ public:
 
   bool isTwoEnhancedTraceEq(EnhancedSEGTrace *trace1, EnhancedSEGTrace *trace2);
 
+  // the interned trace equal to trace by isTwoEnhancedTraceEq; takes
+  // ownership of trace and deletes it if an equal one was interned before
+  EnhancedSEGTrace *internTrace(EnhancedSEGTrace *trace);
+
+  // drop the traces and statistics of the previous patch, conditions
+  // and output orders of interned traces are rewritten by the spec
+  // inference, only the module-level caches are shared across patches
+  void resetPatchState();
+
   bool isTwoIONodeEqual(EnhancedSEGTrace *trace1, EnhancedSEGTrace *trace2);
 
   bool isTwoConditionEqual(ConditionNode *cond1, ConditionNode *cond2);
 
+  template <typename... Args> ConditionNode *newCondition(Args &&...args) {
+    return conditionArena.create(this, std::forward<Args>(args)...);
+  }
+
+  ConditionNode *internCondition(ConditionNode *node) {
+    return conditionArena.intern(node);
+  }
+
+  ConditionArena &getConditionArena() { return conditionArena; }
+
   void dumpEnhancedTraceCond(const EnhancedSEGTrace *trace);
 };
 
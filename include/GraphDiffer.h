@@ -2,47 +2,12 @@
 #define CLEARBLUE_GRAPHDIFFER_H
 
 #include "EnhancedSEG.h"
+#include "PatchContext.h"
 #include "UtilsHelper.h"
 
 using namespace llvm;
 using namespace std;
 
-struct seg_patch_cmp {
-  LLVMValueIndexer *instance;
-  seg_patch_cmp() : instance(LLVMValueIndexer::get()) {}
-
-  bool operator()(const SEGObject *A, const SEGObject *B) const {
-    if (!A || !B) {
-      // Handle null pointers explicitly
-      return A < B;
-    }
-    StringRef funcSEGA = "";
-    StringRef funcSEGB = "";
-    if (A && A->getParentGraph() && A->getParentGraph()->getBaseFunc() &&
-        A->getParentGraph()->getBaseFunc()->hasName()) {
-      funcSEGA = A->getParentGraph()->getBaseFunc()->getName();
-    }
-    if (B && B->getParentGraph() && B->getParentGraph()->getBaseFunc() &&
-        B->getParentGraph()->getBaseFunc()->hasName()) {
-      funcSEGB = B->getParentGraph()->getBaseFunc()->getName();
-    }
-
-    if (funcSEGA != funcSEGB) {
-      return funcSEGA < funcSEGB;
-    } else {
-      int indexSEGA = A ? A->getSEGIndex() : -1;
-      int indexSEGB = B ? B->getSEGIndex() : -1;
-      if (indexSEGA != indexSEGB || (indexSEGA == -1 && indexSEGB == -1)) {
-        return indexSEGA < indexSEGB;
-      } else {
-        int indexA = A ? A->getObjIndex() : -1;
-        int indexB = B ? B->getObjIndex() : -1;
-        return indexA < indexB;
-      }
-    }
-  }
-};
-
 class GraphDiffer {
 
   set<SEGNodeBase *> addedSEGNodes;
@@ -51,12 +16,12 @@ class GraphDiffer {
   map<SEGObject *, SEGObject *, seg_patch_cmp> matchedNodesBefore;
   map<SEGObject *, SEGObject *, seg_patch_cmp> matchedNodesAfter;
 
-  set<EnhancedSEGTrace *> beforeIntraTraces;
-  set<EnhancedSEGTrace *> afterIntraTraces;
+  EnhancedTraceSet beforeIntraTraces;
+  EnhancedTraceSet afterIntraTraces;
 
-  set<EnhancedSEGTrace *> addedIntraTraces;
-  set<EnhancedSEGTrace *> removedIntraTraces;
-  map<EnhancedSEGTrace *, EnhancedSEGTrace *> unchangedIntraTraces;
+  EnhancedTraceSet addedIntraTraces;
+  EnhancedTraceSet removedIntraTraces;
+  EnhancedTraceMap unchangedIntraTraces;
 
   map<ConditionNode *, set<ConditionNode *>> matchedConditions;
   map<ConditionNode *, set<ConditionNode *>> matchedConditionSMTs;
@@ -65,9 +30,18 @@ class GraphDiffer {
       condPairFeasibility;
 
   int matchedConditionsNum = 0;
+  // condition pairs proven equal by their truth tables without the solver
+  int fingerprintMatchedNum = 0;
 
   void computePeerFuncs(string fileName);
 
+  // invariants shared by all traces that may match the trace, see
+  // groupByFingerprint
+  vector<int> traceFingerprint(EnhancedSEGTrace *trace);
+
+  map<vector<int>, vector<EnhancedSEGTrace *>>
+  groupByFingerprint(const EnhancedTraceSet &traces);
+
   bool isTwoEnhancedTraceMatch(EnhancedSEGTrace *trace1,
                                EnhancedSEGTrace *trace2);
 
@@ -88,6 +62,10 @@ class GraphDiffer {
 
   bool isTwoConditionMatchedSMT(ConditionNode *cond1, ConditionNode *cond2);
 
+  bool isTwoConditionFingerprintEqual(
+      ConditionNode *cond1, ConditionNode *cond2,
+      map<SEGNodeBase *, SEGNodeBase *> &matchedNodesInCond21);
+
   void findHasSubTree(ConditionNode *cond1, ConditionNode *cond2,
                       map<ConditionNode *, ConditionNode *> &matchedSubTree,
                       map<ConditionNode *, ConditionNode *> &subMatchedSubTree);
@@ -107,17 +85,28 @@ class GraphDiffer {
   set<SEGNodeBase *> processedBeforeNodes, processedAfterNodes;
   set<const SymbolicExprGraph *> beforeGraphs, afterGraphs;
 
-  void obtainIntraSlicingStage1(set<SEGTraceWithBB> &intraSEGTracesBefore,
-                                set<SEGTraceWithBB> &intraSEGTracesAfter);
+  // number of parallel slicing tasks so far, tags the path DAG of each task
+  unsigned numSlicingTasks = 0;
+
+  // slice each (criterion, isAfter) into the before or after traces, with one
+  // parallel task per SEG if more than one slicing thread is configured;
+  // finalStage lets goal-directed slicing prune, as the traces seed nothing
+  void sliceIntraCriteria(const vector<pair<SEGNodeBase *, bool>> &criteria,
+                          set<PooledSEGTrace> &intraSEGTracesBefore,
+                          set<PooledSEGTrace> &intraSEGTracesAfter,
+                          bool finalStage);
+
+  void obtainIntraSlicingStage1(set<PooledSEGTrace> &intraSEGTracesBefore,
+                                set<PooledSEGTrace> &intraSEGTracesAfter);
 
-  void obtainIntraSlicingStage2(set<SEGTraceWithBB> &intraSEGTracesBefore,
-                                set<SEGTraceWithBB> &intraSEGTracesAfter);
+  void obtainIntraSlicingStage2(set<PooledSEGTrace> &intraSEGTracesBefore,
+                                set<PooledSEGTrace> &intraSEGTracesAfter);
 
-  void obtainIntraSlicingStage3(set<SEGTraceWithBB> &intraSEGTracesBefore,
-                                set<SEGTraceWithBB> &intraSEGTracesAfter);
+  void obtainIntraSlicingStage3(set<PooledSEGTrace> &intraSEGTracesBefore,
+                                set<PooledSEGTrace> &intraSEGTracesAfter);
 
-  void classifyInterEnhancedTraces(set<EnhancedSEGTrace *> &beforeInterTraces,
-                                   set<EnhancedSEGTrace *> &afterInterTraces);
+  void classifyInterEnhancedTraces(EnhancedTraceSet &beforeInterTraces,
+                                   EnhancedTraceSet &afterInterTraces);
 
   void diffABIntraTraces();
 
@@ -127,18 +116,19 @@ public:
   EnhancedSEGWrapper *SEGWrapper;
 
   SymbolicExprGraphSolver *SEGSolver;
+  PatchContext &ctx;
 
   // (S-, _)
-  set<EnhancedSEGTrace *> addedInterTraces;
+  EnhancedTraceSet addedInterTraces;
   // (_, S+)
-  set<EnhancedSEGTrace *> removedInterTraces;
+  EnhancedTraceSet removedInterTraces;
   // (S-, S+)_cond
-  map<EnhancedSEGTrace *, EnhancedSEGTrace *> changedCondInterTraces;
+  EnhancedTraceMap changedCondInterTraces;
   // (S-, S+)_ord
-  map<EnhancedSEGTrace *, EnhancedSEGTrace *> changedOrderInterTraces;
+  EnhancedTraceMap changedOrderInterTraces;
 
   GraphDiffer(EnhancedSEGWrapper *SEGWrapper,
-              SymbolicExprGraphSolver *pSEGSolver);
+              SymbolicExprGraphSolver *pSEGSolver, PatchContext &ctx);
 
   void loadPeerFuncLines(string peerLine);
 
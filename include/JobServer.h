@@ -0,0 +1,38 @@
+#ifndef CLEARBLUE_JOBSERVER_H
+#define CLEARBLUE_JOBSERVER_H
+
+#include <string>
+
+using namespace std;
+
+// Line-based job channel of a resident analysis. Jobs are read one per line
+// from stdin, or from the clients of a local Unix socket, one client after
+// another, and each reply line goes back to where its job came from.
+class JobServer {
+public:
+  // an empty socketPath serves stdin and stdout
+  explicit JobServer(string socketPath);
+  ~JobServer();
+  JobServer(const JobServer &) = delete;
+  JobServer &operator=(const JobServer &) = delete;
+
+  // false if the socket could not be set up
+  bool isReady() const { return socketPath.empty() || listenFd >= 0; }
+
+  // block until the next non-empty job line, false once no more jobs come
+  bool next(string &job);
+
+  void reply(const string &line);
+
+private:
+  string socketPath;
+  int listenFd = -1;
+  int clientFd = -1;
+  // bytes read from the client past the last returned line
+  string pending;
+
+  // the next line of the current client, false once it disconnected
+  bool readClientLine(string &line);
+};
+
+#endif // CLEARBLUE_JOBSERVER_H
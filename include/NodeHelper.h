@@ -3,6 +3,7 @@
 
 #include "Analysis/Bitcode/DebugInfoAnalysis.h"
 #include "IR/ConstantsContext.h"
+#include "PatchContext.h"
 #include "UtilsHelper.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Instruction.h"
@@ -17,11 +18,14 @@
 using namespace std;
 using namespace llvm;
 
-bool isPatchSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2);
+bool isPatchSEGNodeMatched(PatchContext &ctx, SEGNodeBase *node1,
+                           SEGNodeBase *node2);
 
-bool isPatchSEGSiteMatched(SEGSiteBase *site1, SEGSiteBase *site2);
+bool isPatchSEGSiteMatched(PatchContext &ctx, SEGSiteBase *site1,
+                           SEGSiteBase *site2);
 
-bool isDriverSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2);
+bool isDriverSEGNodeMatched(PatchContext &ctx, SEGNodeBase *node1,
+                            SEGNodeBase *node2);
 bool isDriverSEGSiteMatched(SEGNodeBase *node1, SEGNodeBase *node2,
                             SEGSiteBase *site1, SEGSiteBase *site2);
 
@@ -0,0 +1,28 @@
+#ifndef CLEARBLUE_PATCHCONTEXT_H
+#define CLEARBLUE_PATCHCONTEXT_H
+
+#include "Transform/ValueComparator.h"
+#include "llvm/IR/Function.h"
+#include <map>
+#include <set>
+#include <string>
+
+using namespace std;
+using namespace llvm;
+
+// The changed functions and lines of one patch and the IRs matched between
+// its pre- and post-patch code. Every analysis of a patch reads and writes
+// its own context, so patches of one module do not see each other's state.
+struct PatchContext {
+  set<Function *> changedFuncs;
+
+  map<Value *, Value *, llvm_cmp> matchedIRsBefore;
+  map<Value *, Value *, llvm_cmp> matchedIRsAfter;
+
+  set<BasicBlock *> unMatchedBBs;
+
+  map<string, map<int, int>> changedMapping;
+  map<string, map<int, int>> unChangedMapping;
+};
+
+#endif // CLEARBLUE_PATCHCONTEXT_H
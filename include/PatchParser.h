@@ -8,11 +8,14 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "Analysis/Bitcode/DebugInfoAnalysis.h"
 #include "IR/ConstantsContext.h"
+#include "PatchContext.h"
 #include "Transform/ValueComparator.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Instruction.h"
@@ -37,6 +40,10 @@ struct ChangedLine {
     line = stoi(str.split(":").second.str());
   }
 
+  ChangedLine(string sourceFile, unsigned line, bool is_add)
+      : sourceFile(std::move(sourceFile)), line(line), func(nullptr),
+        is_add(is_add) {}
+
   friend raw_ostream &operator<<(raw_ostream &out, const ChangedLine &item) {
     out << item.sourceFile << ":" << item.line;
     return out;
@@ -52,6 +59,18 @@ class PatchParser {
   vector<ChangedLine> addedLines;
   vector<ChangedLine> removedLines;
 
+  // lines of addedLines/removedLines by source file
+  unordered_map<string, unordered_set<int>> addedLineSet;
+  unordered_map<string, unordered_set<int>> removedLineSet;
+
+  // set if the patch is a unified diff rather than a list of changed lines.
+  // lineOffsets maps a pre-patch line to the offset of its post-patch line,
+  // which holds until the next key; replacedLines pairs the removed lines of
+  // a hunk with the added lines replacing them
+  bool isUnifiedDiff = false;
+  map<string, map<int, int>> lineOffsets;
+  map<string, map<int, int>> replacedLines;
+
   // cache of functions to the source line scopes
   map<Function *, pair<int, int>> funcLineScope;
   // cache of basic blocks to the source line scopes
@@ -59,21 +78,45 @@ class PatchParser {
 
   map<Function *, string> funcSourceFile;
 
+  // line scopes of the functions of one side of the patch in one source
+  // file, sorted by first line; maxEnd[i] is the largest last line of
+  // scopes[0..i], so a lookup stops at the first prefix ending before it
+  struct FuncIntervals {
+    vector<pair<pair<int, int>, Function *>> scopes;
+    vector<int> maxEnd;
+  };
+  // keyed by source file and whether the functions are after the patch
+  map<pair<string, bool>, FuncIntervals> funcIntervals;
+
+  // instructions of each function by source line, as getLineNumInsts
+  // returns them
+  map<Function *, map<int, vector<Instruction *>>> funcLineInsts;
+
   Module *M;
   DebugInfoAnalysis *DIA;
+  PatchContext &ctx;
+
+  size_t alignedIRNum = 0;
 
   unsigned int guessInstructionLineNum(Instruction *inst);
 
   set<Function *> findEnclosedFunc(string srcFile, int line, bool isAdded);
   void getLineNumInsts(Function *func, int line, vector<Instruction *> &inst);
+  void collectBlockLines(BasicBlock &bb,
+                         vector<pair<Instruction *, int>> &inst2Line);
 
   void cacheFuncBBScope();
+  void alignFuncIRs(Function *beforeFunc, Function *afterFunc);
+  bool isAlignedIRConsistent(Instruction *beforeIR, Instruction *afterIR);
+  bool isIROnChangedLine(Instruction *inst);
   void matchBBByLine();
   void matchUnChangedIRs();
   void matchAndDiffChangedIRs();
   void computeBeforeAfterLineMap();
+  void computeUnifiedDiffLineMap();
 
   void parsePatchFile(string patchFile);
+  void addChangedLine(ChangedLine changedLine);
 
   bool isLineAdded(const string &srcfile, int lineNum);
   bool isLineRemoved(const string &srffile, int lineNum);
@@ -82,7 +125,8 @@ public:
   set<Value *> addedValues;
   set<Value *> removedValues;
 
-  PatchParser(Module *M, DebugInfoAnalysis *pDIA, string patchFile);
+  PatchParser(Module *M, DebugInfoAnalysis *pDIA, PatchContext &ctx,
+              string patchFile);
   void parseIRChanges();
 };
 
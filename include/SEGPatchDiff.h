@@ -30,6 +30,7 @@ class SEGPathDiff : public CBPluginPass {
 private:
   vector<shared_ptr<Vulnerability>> customizedCheckers;
 
+  PatchContext *patchContext = nullptr;
   PatchParser *patchParser = nullptr;
   GraphDiffer *graphParser = nullptr;
   EnhancedSEGWrapper *SEGWrapper = nullptr;
@@ -46,6 +47,26 @@ private:
   ExternalMemorySpec *MemSpec = nullptr;
   ExternalIOSpec *IOSpec = nullptr;
 
+  // phases 1-3 of spec inference for one patch, against the analyses
+  // shared by all patches of the module
+  void inferPatchSpec(Module &M, const string &patchFile,
+                      const string &outputFile);
+
+  // append the checkers of a spec file to checkers
+  void loadDetectionCheckers(const string &specFile,
+                             vector<shared_ptr<Vulnerability>> &checkers);
+
+  // one "candidate <checker> <source> -> <sink>" line for each source and
+  // sink of a checker where the sink lies in the function of the source or in
+  // one of its transitive callees. These are not bug reports: value flows and
+  // path feasibility are left to the checker engine, which runs after -serve.
+  void matchDetectionCheckers(Module &M,
+                              const vector<shared_ptr<Vulnerability>> &checkers,
+                              vector<string> &candidates);
+
+  // run jobs against the loaded module until told to stop
+  void serve(Module &M);
+
 public:
   void getAnalysisUsage(AnalysisUsage &AU) override;
 
@@ -21,6 +21,9 @@ using namespace std;
 void obtainSensitive(const vector<SEGObject *> &segTrace,
                      set<OutputNode *> &outputs);
 
+// kinds of sensitive operations a node is used in, without creating outputs
+void obtainSensitiveTypes(SEGNodeBase *node, set<OutputType> &types);
+
 OutputNode *isDivideByZeroSite(SEGNodeBase *node, SEGSiteBase *site);
 OutputNode *isNullPtrDerefSite(SEGNodeBase *node, SEGSiteBase *site);
 OutputNode *isOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site);
@@ -0,0 +1,62 @@
+#ifndef CLEARBLUE_TRACEPOOL_H
+#define CLEARBLUE_TRACEPOOL_H
+
+#include "IR/SEG/SymbolicExprGraph.h"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+// Deduplicating store of value-flow traces. Each SEG object gets a dense
+// 32-bit id per pool, and a trace is kept as the ids of its objects appended
+// to one contiguous buffer, instead of as a vector of pointers of its own.
+// Pools filled by parallel slicing tasks merge without any shared state.
+//
+// A stored trace is immutable and referred to by its handle, which stays
+// valid until the pool is reset; get gives its objects back to the code
+// working on pointers.
+class TracePool {
+public:
+  typedef uint32_t Handle;
+
+  TracePool() = default;
+  TracePool(const TracePool &) = delete;
+  TracePool &operator=(const TracePool &) = delete;
+  TracePool(TracePool &&) = default;
+  TracePool &operator=(TracePool &&) = default;
+
+  // the handle of trace, and false if an equal trace was inserted before
+  pair<Handle, bool> insert(const vector<SEGObject *> &trace);
+
+  // insert all traces of other; remap, if given, receives the handle here
+  // of each handle of other
+  void merge(const TracePool &other, vector<Handle> *remap = nullptr);
+
+  // the objects of the trace of handle
+  vector<SEGObject *> get(Handle handle) const;
+
+  size_t size() const { return spans.size(); }
+
+private:
+  // [offset, offset + length) of buffer
+  typedef pair<uint32_t, uint32_t> Span;
+
+  vector<uint32_t> buffer;
+  vector<Span> spans;
+  unordered_map<size_t, SmallVector<Handle, 1>> buckets;
+
+  DenseMap<SEGObject *, uint32_t> objectIds;
+  vector<SEGObject *> objects;
+
+  uint32_t getObjectId(SEGObject *object);
+
+  // the handle of the encoded trace at the end of buffer, which is dropped
+  // again if an equal trace was inserted before
+  pair<Handle, bool> commit(uint32_t offset);
+};
+
+#endif // CLEARBLUE_TRACEPOOL_H
@@ -0,0 +1,93 @@
+#ifndef CLEARBLUE_VALUEFLOWPATHDAG_H
+#define CLEARBLUE_VALUEFLOWPATHDAG_H
+
+#include "IR/SEG/SymbolicExprGraph.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+// A node of the value-flow path DAG. It stands for the set of paths that
+// start at `head` and either stop at head (if terminal) or continue with any
+// path of one of the successors. The head of the empty path is nullptr.
+struct PathDAGNode {
+  SEGObject *head;
+  bool terminal;
+  vector<PathDAGNode *> succs;
+
+  // unique among all DAGs, the high half is the tag of the owning DAG
+  uint64_t id;
+  size_t hash;
+
+  // lazily computed number of paths, saturated at UINT64_MAX
+  uint64_t numPaths = 0;
+  bool numPathsComputed = false;
+
+  PathDAGNode(SEGObject *head, bool terminal, vector<PathDAGNode *> succs,
+              uint64_t id, size_t hash)
+      : head(head), terminal(terminal), succs(std::move(succs)), id(id),
+        hash(hash){};
+
+  bool isEmptyPath() const { return !head && terminal && succs.empty(); }
+
+  // no path goes through this node
+  bool isDead() const { return !terminal && succs.empty(); }
+};
+
+// Hash-consed storage of intra-procedural value-flow paths. Paths sharing a
+// suffix share the DAG nodes of that suffix, so the size of the DAG is linear
+// in the size of the SEG regardless of how many paths it represents.
+// DAGs with distinct tags may share nodes, e.g. after merging the DAGs built
+// by parallel slicing tasks.
+class ValueFlowPathDAG {
+  uint64_t tag;
+  deque<PathDAGNode> nodes;
+  unordered_map<size_t, vector<PathDAGNode *>> buckets;
+  map<const PathDAGNode *, map<unsigned, uint64_t>> lengthHistograms;
+
+  PathDAGNode *emptyPath = nullptr;
+
+  bool forEachPath(PathDAGNode *node, vector<SEGObject *> &curPath,
+                   const function<bool(const vector<SEGObject *> &)> &visitor);
+
+  bool
+  forEachPrefix(PathDAGNode *node, vector<SEGObject *> &curPath,
+                const function<bool(SEGObject *)> &isEnd,
+                const function<bool(const vector<SEGObject *> &)> &visitor);
+
+public:
+  explicit ValueFlowPathDAG(unsigned tag = 0);
+
+  // the DAG node holding only the empty path
+  PathDAGNode *getEmptyPath() { return emptyPath; }
+
+  PathDAGNode *getOrInsert(SEGObject *head, bool terminal,
+                           vector<PathDAGNode *> succs);
+
+  uint64_t countPaths(PathDAGNode *node);
+
+  // number of paths of each length
+  const map<unsigned, uint64_t> &lengthHistogram(PathDAGNode *node);
+
+  // the last objects of all non-empty paths, without enumerating the paths
+  void collectPathEnds(PathDAGNode *node, set<SEGObject *> &ends);
+
+  // enumerate paths in a deterministic order; stop once visitor returns false
+  bool forEachPath(PathDAGNode *node,
+                   const function<bool(const vector<SEGObject *> &)> &visitor);
+
+  // enumerate the prefixes of all paths that end at an object accepted by
+  // isEnd, each distinct prefix once; stop once visitor returns false
+  bool
+  forEachPrefix(PathDAGNode *node, const function<bool(SEGObject *)> &isEnd,
+                const function<bool(const vector<SEGObject *> &)> &visitor);
+
+  size_t size() const { return nodes.size(); }
+};
+
+#endif // CLEARBLUE_VALUEFLOWPATHDAG_H
@@ -0,0 +1,69 @@
+#include "CallContext.h"
+#include <algorithm>
+
+CallContextIterator::CallContextIterator(Function *func,
+                                         const CallEdges &edges,
+                                         function<bool(Function *)> isEnd,
+                                         bool upward, unsigned kLimit,
+                                         unsigned budget)
+    : edges(edges), isEnd(std::move(isEnd)), upward(upward), kLimit(kLimit),
+      budget(budget) {
+  if (func) {
+    enter(func);
+  }
+}
+
+bool CallContextIterator::isOnChain(Function *func) const {
+  return find(curChain.begin(), curChain.end(), func) != curChain.end();
+}
+
+void CallContextIterator::enter(Function *func) {
+  curChain.push_back(func);
+
+  Frame frame;
+  auto it = edges.find(func);
+  bool hasNext = false;
+  if (it != edges.end()) {
+    frame.cur = it->second.begin();
+    frame.end = it->second.end();
+    // a recursive call does not extend the chain
+    hasNext = any_of(frame.cur, frame.end,
+                     [&](Function *nextFunc) { return !isOnChain(nextFunc); });
+  }
+  frame.isLeaf = !hasNext || (isEnd && isEnd(func)) ||
+                 (kLimit && curChain.size() >= kLimit);
+  frame.yielded = false;
+  if (frame.isLeaf) {
+    frame.cur = frame.end;
+  }
+  frames.push_back(frame);
+}
+
+bool CallContextIterator::next(vector<Function *> &context) {
+  while (!frames.empty()) {
+    auto &frame = frames.back();
+    if (frame.isLeaf && !frame.yielded) {
+      if (budget && numYielded >= budget) {
+        budgetHit = true;
+        return false;
+      }
+      frame.yielded = true;
+      numYielded += 1;
+      context = curChain;
+      if (upward) {
+        reverse(context.begin(), context.end());
+      }
+      return true;
+    }
+    if (frame.cur != frame.end) {
+      auto nextFunc = *frame.cur++;
+      if (!isOnChain(nextFunc)) {
+        enter(nextFunc);
+      }
+      continue;
+    }
+    curChain.pop_back();
+    frames.pop_back();
+  }
+  return false;
+}
@@ -0,0 +1,117 @@
+#include "CallGraphSCC.h"
+#include <algorithm>
+
+void CallGraphSCC::build(const CallEdges &caller2Callee) {
+  func2SCC.clear();
+  members.clear();
+  succs.clear();
+  recursive.clear();
+
+  DenseMap<Function *, unsigned> func2Id;
+  vector<Function *> funcs;
+  auto getOrInsertId = [&](Function *func) {
+    auto it = func2Id.find(func);
+    if (it != func2Id.end()) {
+      return it->second;
+    }
+    unsigned id = funcs.size();
+    func2Id[func] = id;
+    funcs.push_back(func);
+    return id;
+  };
+  for (auto &[caller, callees] : caller2Callee) {
+    getOrInsertId(caller);
+    for (auto callee : callees) {
+      getOrInsertId(callee);
+    }
+  }
+  vector<vector<unsigned>> adj(funcs.size());
+  for (auto &[caller, callees] : caller2Callee) {
+    for (auto callee : callees) {
+      adj[func2Id[caller]].push_back(func2Id[callee]);
+    }
+  }
+
+  const unsigned unvisited = ~0u;
+  vector<unsigned> index(funcs.size(), unvisited);
+  vector<unsigned> low(funcs.size(), 0);
+  vector<unsigned> comp(funcs.size(), 0);
+  vector<bool> onStack(funcs.size(), false);
+  vector<unsigned> sccStack;
+  // explicit DFS stack of (function, next successor to visit)
+  vector<pair<unsigned, unsigned>> dfsStack;
+  unsigned counter = 0;
+
+  auto visit = [&](unsigned id) {
+    index[id] = low[id] = counter++;
+    sccStack.push_back(id);
+    onStack[id] = true;
+    dfsStack.push_back({id, 0});
+  };
+
+  for (unsigned root = 0; root < funcs.size(); root++) {
+    if (index[root] != unvisited) {
+      continue;
+    }
+    visit(root);
+    while (!dfsStack.empty()) {
+      unsigned cur = dfsStack.back().first;
+      unsigned &nextSucc = dfsStack.back().second;
+      if (nextSucc < adj[cur].size()) {
+        unsigned succ = adj[cur][nextSucc++];
+        if (index[succ] == unvisited) {
+          visit(succ);
+        } else if (onStack[succ]) {
+          low[cur] = min(low[cur], index[succ]);
+        }
+        continue;
+      }
+
+      dfsStack.pop_back();
+      if (!dfsStack.empty()) {
+        unsigned parent = dfsStack.back().first;
+        low[parent] = min(low[parent], low[cur]);
+      }
+      if (low[cur] != index[cur]) {
+        continue;
+      }
+
+      // cur is the root of an SCC, all its callees got an SCC already
+      unsigned scc = members.size();
+      members.emplace_back();
+      unsigned member;
+      do {
+        member = sccStack.back();
+        sccStack.pop_back();
+        onStack[member] = false;
+        comp[member] = scc;
+        members[scc].push_back(funcs[member]);
+        func2SCC[funcs[member]] = scc;
+      } while (member != cur);
+    }
+  }
+
+  succs.resize(members.size());
+  recursive.assign(members.size(), false);
+  for (unsigned id = 0; id < funcs.size(); id++) {
+    for (auto succ : adj[id]) {
+      if (comp[id] == comp[succ]) {
+        recursive[comp[id]] = true;
+      } else {
+        succs[comp[id]].push_back(comp[succ]);
+      }
+    }
+  }
+  for (auto &sccSuccs : succs) {
+    sort(sccSuccs.begin(), sccSuccs.end());
+    sccSuccs.erase(unique(sccSuccs.begin(), sccSuccs.end()), sccSuccs.end());
+  }
+}
+
+int CallGraphSCC::getSCC(Function *func) const {
+  auto it = func2SCC.find(func);
+  if (it == func2SCC.end()) {
+    return -1;
+  }
+  return it->second;
+}
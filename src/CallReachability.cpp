@@ -0,0 +1,31 @@
+#include "CallReachability.h"
+
+void CallReachability::build(const CallGraphSCC &callGraphSCC) {
+  SCCs = &callGraphSCC;
+  reachable.assign(SCCs->size(), BitVector());
+
+  // callee SCCs have smaller ids, so they are complete when used
+  for (unsigned scc = 0; scc < SCCs->size(); scc++) {
+    auto &sccReach = reachable[scc];
+    sccReach.resize(SCCs->size());
+    for (auto succ : SCCs->getSuccs(scc)) {
+      sccReach.set(succ);
+      sccReach |= reachable[succ];
+    }
+  }
+}
+
+bool CallReachability::reaches(Function *caller, Function *callee) const {
+  if (!SCCs) {
+    return false;
+  }
+  int callerSCC = SCCs->getSCC(caller);
+  int calleeSCC = SCCs->getSCC(callee);
+  if (callerSCC < 0 || calleeSCC < 0) {
+    return false;
+  }
+  if (callerSCC == calleeSCC) {
+    return SCCs->isRecursive(callerSCC);
+  }
+  return reachable[callerSCC].test(calleeSCC);
+}
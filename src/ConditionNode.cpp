@@ -1,6 +1,19 @@
 
 #include "ConditionNode.h"
 #include "EnhancedSEG.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/CommandLine.h"
+
+static cl::opt<unsigned> MaxMinimizeAtoms(
+    "max-minimize-atoms",
+    cl::desc("Minimize conditions over at most this many distinct atoms into "
+             "prime implicants, larger ones keep the structural "
+             "simplification. Capped at 16."),
+    cl::init(10), cl::Hidden);
+
+// truth tables have 2^atoms bits and implicants are unsigned masks, so the
+// minimizer never goes beyond this many atoms
+static const unsigned MinimizeAtomsLimit = 16;
 
 ConditionNode *ConditionNode::processNode(ConditionNode *node) {
   bool changed;
@@ -58,11 +71,11 @@ ConditionNode *ConditionNode::distributeANDoverOR(ConditionNode *node,
   if (orNode == nullptr || orNode->type != NODE_OR)
     return node;
 
-  auto newORNode = new ConditionNode(SEGWrapper, NODE_OR);
+  auto newORNode = SEGWrapper->newCondition(NODE_OR);
 
   // Distribute AND over each child of OR
   for (ConditionNode *orChild : orNode->children) {
-    auto newAndNode = new ConditionNode(SEGWrapper, NODE_AND);
+    auto newAndNode = SEGWrapper->newCondition(NODE_AND);
     // Add all other siblings of OR to this new AND node
     for (size_t j = 0; j < node->children.size(); ++j) {
       if (j != index) {
@@ -101,14 +114,14 @@ ConditionNode *ConditionNode::distributeORoverAND(ConditionNode *node,
     return node;
 
   // Create a new AND node which will replace the original OR node
-  auto newANDNode = new ConditionNode(SEGWrapper, NODE_AND);
+  auto newANDNode = SEGWrapper->newCondition(NODE_AND);
 
   // Iterate over each child of the AND node
   // andNode is (B and C)
   for (auto andChild : andNode->children) {
     // andChild is B
     // Create a new OR node for each child of the AND node
-    auto newORNode = new ConditionNode(SEGWrapper, NODE_OR);
+    auto newORNode = SEGWrapper->newCondition(NODE_OR);
 
     // Add the current child of AND to the new OR node
     newORNode->addChild(andChild);
@@ -165,21 +178,43 @@ void ConditionNode::simplify() {
 }
 
 bool isConstNode(ConditionNode *node) { return node->type == NODE_CONST; }
+// an OR without any operand never holds, as in toSMTExpr
+bool isFalseNode(ConditionNode *node) {
+  return node->type == NODE_OR && node->children.empty();
+}
 bool isInvalidNode(ConditionNode *node) {
   return node->children.empty() &&
-         (node->type == NODE_AND || node->type == NODE_OR ||
-          node->type == NODE_NOT);
+         (node->type == NODE_AND || node->type == NODE_NOT);
 }
 
 void ConditionNode::simplifyConst() {
+  if (isFalseNode(this)) {
+    return;
+  }
   for (ConditionNode *child : children) {
     child->simplifyConst();
   }
+  bool hasFalse = any_of(children.begin(), children.end(), isFalseNode);
+  if (hasFalse && type == NODE_AND) {
+    children.clear();
+    type = NODE_OR;
+    return;
+  }
+  if (hasFalse && type == NODE_NOT) {
+    this->clear();
+    return;
+  }
+  children.erase(remove_if(children.begin(), children.end(), isFalseNode),
+                 children.end());
   children.erase(remove_if(children.begin(), children.end(), isConstNode),
                  children.end());
   children.erase(remove_if(children.begin(), children.end(), isInvalidNode),
                  children.end());
-  if (isInvalidNode(this)) {
+  // an OR left with its false operands only stays false
+  if (type == NODE_OR && children.empty() && hasFalse) {
+    return;
+  }
+  if (isInvalidNode(this) || (type == NODE_OR && children.empty())) {
     this->clear();
   }
 }
@@ -279,7 +314,8 @@ void ConditionNode::simplifyAnd() {
   } else if (simplifiedChildren.empty()) {
     this->clear();
   } else {
-    this->children = simplifiedChildren;
+    this->children.assign(simplifiedChildren.begin(),
+                          simplifiedChildren.end());
   }
 
   //  DEBUG_WITH_TYPE("condition",  dbgs() << "\nAfter And Simplify\n");
@@ -351,7 +387,8 @@ void ConditionNode::simplifyOr() {
   } else if (simplifiedChildren.empty()) {
     this->clear();
   } else {
-    this->children = simplifiedChildren;
+    this->children.assign(simplifiedChildren.begin(),
+                          simplifiedChildren.end());
   }
   //  DEBUG_WITH_TYPE("condition",  dbgs() << "\nAfter Or Simplify\n");
   //  DEBUG_WITH_TYPE("condition",  dbgs() << this->dump();
@@ -363,8 +400,7 @@ bool customEqual(ConditionNode *a, ConditionNode *b) {
   return a->isEqual(b);
 }
 
-bool isSubVector(const vector<ConditionNode *> &a,
-                 const vector<ConditionNode *> &b) {
+bool isSubVector(ArrayRef<ConditionNode *> a, ArrayRef<ConditionNode *> b) {
   // Early exit if 'a' is longer than 'b'
   if (a.size() > b.size())
     return false;
@@ -472,6 +508,14 @@ bool ConditionNode::isEqual(ConditionNode *other) {
   if (other == nullptr)
     return false;
 
+  if (SEGWrapper->internCondition(this) ==
+      SEGWrapper->internCondition(other)) {
+    return true;
+  }
+  return isMergeEqual(other);
+}
+
+bool ConditionNode::isMergeEqual(ConditionNode *other) {
   if (SEGWrapper->isConditionMerge(this, other)) {
     return true;
   }
@@ -485,12 +529,51 @@ bool ConditionNode::isEqual(ConditionNode *other) {
   if (children.size() != other->children.size())
     return false;
   for (size_t i = 0; i < children.size(); ++i) {
-    if (!children[i]->isEqual(other->children[i]))
+    if (!children[i]->isMergeEqual(other->children[i]))
       return false;
   }
   return true;
 }
 
+ConditionNode *ConditionArena::intern(ConditionNode *node) {
+  if (node->id) {
+    return node;
+  }
+
+  ConditionChildren children;
+  for (auto child : node->children) {
+    children.push_back(intern(child));
+  }
+  // AND and OR are commutative, their operands have a canonical order
+  if (node->type == NODE_AND || node->type == NODE_OR) {
+    sort(children.begin(), children.end(),
+         [](const ConditionNode *a, const ConditionNode *b) {
+           return a->id < b->id;
+         });
+  }
+
+  size_t hash = hash_combine(std::hash<int>()(node->type),
+                             std::hash<SEGNodeBase *>()(node->value));
+  for (auto child : children) {
+    hash = hash_combine(hash, child->id);
+  }
+
+  auto &bucket = buckets[hash];
+  for (auto candidate : bucket) {
+    if (candidate->type == node->type && candidate->value == node->value &&
+        candidate->children == children) {
+      return candidate;
+    }
+  }
+
+  auto canonical = create(node->SEGWrapper, node->type, node->value);
+  canonical->children = children;
+  canonical->hash = hash;
+  canonical->id = ++numInterned;
+  bucket.push_back(canonical);
+  return canonical;
+}
+
 void ConditionNode::addUnique(vector<ConditionNode *> &list,
                               ConditionNode *node) {
   for (ConditionNode *item : list) {
@@ -536,7 +619,7 @@ ConditionNode *ConditionTree::parseFromString(string dumped_str,
     else
       continue; // Handle unknown types or add error handling
 
-    auto node = new ConditionNode(SEGWrapper, node_type);
+    auto node = SEGWrapper->newCondition(node_type);
 
     if (node_type == NODE_VAR) {
       string value_str = node_type_str.substr(node_type_str.find("%"),
@@ -568,78 +651,290 @@ ConditionNode *ConditionTree::parseFromString(string dumped_str,
   return root;
 }
 
-string generateUniqueFilename(const string &content, const string &prefix) {
-  auto now = chrono::system_clock::now().time_since_epoch();
-  auto now_ms = chrono::duration_cast<chrono::milliseconds>(now).count();
+bool ConditionTree::evaluate(ConditionNode *node,
+                             const map<SEGNodeBase *, TruthTable> &atomTables,
+                             TruthTable &table) {
+  bool present = false;
+  switch (node->type) {
+  case NODE_VAR:
+    if (node->value && atomTables.count(node->value)) {
+      table = atomTables.at(node->value);
+      present = true;
+    }
+    break;
+  case NODE_NOT:
+    if (!node->children.empty() &&
+        evaluate(node->children[0], atomTables, table)) {
+      for (auto &word : table) {
+        word = ~word;
+      }
+      present = true;
+    }
+    break;
+  case NODE_AND:
+  case NODE_OR:
+    if (node->children.empty()) {
+      // as in toSMTExpr: an empty OR never holds, an empty AND always does
+      size_t words = atomTables.empty() ? 1 : atomTables.begin()->second.size();
+      table.assign(words, node->type == NODE_AND ? ~0ULL : 0);
+      present = true;
+      break;
+    }
+    for (auto child : node->children) {
+      TruthTable childTable;
+      if (!evaluate(child, atomTables, childTable)) {
+        continue;
+      }
+      if (!present) {
+        table = childTable;
+        present = true;
+        continue;
+      }
+      for (size_t i = 0; i < table.size(); i++) {
+        table[i] = node->type == NODE_AND ? table[i] & childTable[i]
+                                          : table[i] | childTable[i];
+      }
+    }
+    break;
+  case NODE_CONST:
+    break;
+  }
+  return present;
+}
 
-  hash<string> hasher;
-  auto content_hash = hasher(content + to_string(now_ms));
+namespace {
+// Two-level minimization of a condition whose atoms are its NODE_VAR values,
+// each atom being an independent boolean. Truth tables hold one bit per
+// assignment, 64 assignments per word.
+class ConditionMinimizer {
+  typedef ConditionTree::TruthTable TruthTable;
+
+  // an implicant covers the assignments m with (m & care) == value
+  typedef pair<unsigned, unsigned> Implicant;
+
+  EnhancedSEGWrapper *SEGWrapper;
+  vector<SEGNodeBase *> atoms;
+  map<SEGNodeBase *, unsigned> atom2Index;
+  unsigned numBits = 0;
+
+  void collectAtoms(ConditionNode *node) {
+    if (node->type == NODE_VAR && node->value &&
+        atom2Index.insert({node->value, atoms.size()}).second) {
+      atoms.push_back(node->value);
+    }
+    for (auto child : node->children) {
+      collectAtoms(child);
+    }
+  }
 
-  stringstream ss;
-  ss << prefix << "_" << hex << content_hash;
-  return ss.str();
-}
+  TruthTable atomTable(unsigned index) const {
+    TruthTable table(max(1u, numBits / 64), 0);
+    for (unsigned m = 0; m < numBits; m++) {
+      if ((m >> index) & 1) {
+        table[m / 64] |= 1ULL << (m % 64);
+      }
+    }
+    return table;
+  }
 
-string createArgFile(const string &args) {
-  string filename = generateUniqueFilename(args, "/tmp/");
-  ofstream out(filename);
-  if (!out) {
-    throw runtime_error("Failed to create the argument file.");
+  // Quine-McCluskey: merge implicants differing in one cared bit until no
+  // merge is left, the implicants never merged are prime
+  vector<Implicant> primeImplicants(const vector<unsigned> &minterms) {
+    unsigned fullCare = numBits - 1;
+    set<Implicant> current;
+    for (auto m : minterms) {
+      current.insert({m, fullCare});
+    }
+    vector<Implicant> primes;
+    while (!current.empty()) {
+      set<Implicant> merged, next;
+      for (auto &[value, care] : current) {
+        for (unsigned bit = 0; bit < atoms.size(); bit++) {
+          unsigned bitMask = 1u << bit;
+          if (!(care & bitMask) || (value & bitMask)) {
+            continue;
+          }
+          Implicant partner = {value | bitMask, care};
+          if (current.count(partner)) {
+            next.insert({value, care & ~bitMask});
+            merged.insert({value, care});
+            merged.insert(partner);
+          }
+        }
+      }
+      for (auto &implicant : current) {
+        if (!merged.count(implicant)) {
+          primes.push_back(implicant);
+        }
+      }
+      current = next;
+    }
+    return primes;
   }
-  out << args;
-  out.close();
-  return filename;
-}
 
-string execCommand(const string &command) {
-  array<char, 128> buffer{};
-  string result;
-  unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
-  if (!pipe) {
-    throw runtime_error("popen() failed!");
+  static bool covers(const Implicant &implicant, unsigned minterm) {
+    return (minterm & implicant.second) == implicant.first;
   }
-  while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-    result += buffer.data();
+
+  // essential primes first, then greedily the prime covering the most
+  vector<Implicant> selectCover(const vector<Implicant> &primes,
+                                const vector<unsigned> &minterms) {
+    vector<Implicant> cover;
+    set<unsigned> uncovered(minterms.begin(), minterms.end());
+    auto take = [&](const Implicant &prime) {
+      cover.push_back(prime);
+      for (auto m : minterms) {
+        if (covers(prime, m)) {
+          uncovered.erase(m);
+        }
+      }
+    };
+    for (auto m : minterms) {
+      if (!uncovered.count(m)) {
+        continue;
+      }
+      const Implicant *only = nullptr;
+      unsigned numCovering = 0;
+      for (auto &prime : primes) {
+        if (covers(prime, m)) {
+          only = &prime;
+          numCovering += 1;
+        }
+      }
+      if (numCovering == 1) {
+        take(*only);
+      }
+    }
+    while (!uncovered.empty()) {
+      const Implicant *best = nullptr;
+      unsigned bestCount = 0;
+      for (auto &prime : primes) {
+        unsigned count = 0;
+        for (auto m : uncovered) {
+          count += covers(prime, m);
+        }
+        if (count > bestCount) {
+          best = &prime;
+          bestCount = count;
+        }
+      }
+      take(*best);
+    }
+    return cover;
   }
-  return result;
-}
 
-string readFileContents(string filePath) {
-  filePath.erase(filePath.end() - 1);
-  ifstream file(filePath);
-  if (!file.is_open()) {
-    throw runtime_error("Could not open file: " + filePath);
+  ConditionNode *implicant2Node(const Implicant &implicant) {
+    auto andNode = SEGWrapper->newCondition(NODE_AND);
+    for (unsigned bit = 0; bit < atoms.size(); bit++) {
+      if (!((implicant.second >> bit) & 1)) {
+        continue;
+      }
+      auto varNode = SEGWrapper->newCondition(atoms[bit]);
+      if ((implicant.first >> bit) & 1) {
+        andNode->addChild(varNode);
+      } else {
+        auto notNode = SEGWrapper->newCondition(NODE_NOT);
+        notNode->addChild(varNode);
+        andNode->addChild(notNode);
+      }
+    }
+    if (andNode->children.size() == 1) {
+      return andNode->children[0];
+    }
+    return andNode;
   }
 
-  stringstream buffer;
-  buffer << file.rdbuf();
-  file.close();
-  return buffer.str();
+public:
+  explicit ConditionMinimizer(EnhancedSEGWrapper *SEGWrapper)
+      : SEGWrapper(SEGWrapper) {}
+
+  // false if node has too many atoms to be minimized
+  bool minimize(ConditionNode *node, unsigned maxAtoms,
+                ConditionNode *&result) {
+    collectAtoms(node);
+    if (atoms.size() > min(maxAtoms, MinimizeAtomsLimit)) {
+      return false;
+    }
+    numBits = 1u << atoms.size();
+
+    map<SEGNodeBase *, TruthTable> atomTables;
+    for (unsigned index = 0; index < atoms.size(); index++) {
+      atomTables[atoms[index]] = atomTable(index);
+    }
+    TruthTable table;
+    if (!ConditionTree::evaluate(node, atomTables, table)) {
+      // nothing constrains the condition
+      result = SEGWrapper->newCondition(NODE_CONST);
+      return true;
+    }
+
+    vector<unsigned> minterms;
+    for (unsigned m = 0; m < numBits; m++) {
+      if ((table[m / 64] >> (m % 64)) & 1) {
+        minterms.push_back(m);
+      }
+    }
+    if (minterms.empty()) {
+      result = nullptr;
+      return true;
+    }
+    if (minterms.size() == numBits) {
+      result = SEGWrapper->newCondition(NODE_CONST);
+      return true;
+    }
+
+    auto cover = selectCover(primeImplicants(minterms), minterms);
+    if (cover.size() == 1) {
+      result = implicant2Node(cover[0]);
+      return true;
+    }
+    result = SEGWrapper->newCondition(NODE_OR);
+    for (auto &implicant : cover) {
+      result->addChild(implicant2Node(implicant));
+    }
+    return true;
+  }
+};
+} // namespace
+
+ConditionNode *ConditionArena::clone(ConditionNode *node) {
+  auto copy = create(node->SEGWrapper, node->type, node->value);
+  for (auto child : node->children) {
+    copy->addChild(clone(child));
+  }
+  return copy;
 }
 
 ConditionNode *ConditionTree::simplifyCondition(EnhancedSEGWrapper *SEGWrapper,
                                                 ConditionNode *node) {
-  set<SEGNodeBase *> allSEGNode = node->obtainNodes();
-
-  string command =
-      "python3 /Users/harperchen/PycharmProjects/pythonProject9/main.py "
-      "simplify " +
-      createArgFile(node->dump());
-  string outputExpr = readFileContents(execCommand(command));
-  return parseFromString(outputExpr, SEGWrapper, allSEGNode);
+  // structurally equal conditions share one simplification
+  auto &arena = SEGWrapper->getConditionArena();
+  auto nodeId = SEGWrapper->internCondition(node)->id;
+  auto it = arena.simplifiedById.find(nodeId);
+  if (it != arena.simplifiedById.end()) {
+    return it->second ? arena.clone(it->second) : nullptr;
+  }
+
+  ConditionNode *result = nullptr;
+  ConditionMinimizer minimizer(SEGWrapper);
+  if (!minimizer.minimize(node, MaxMinimizeAtoms, result)) {
+    result = arena.clone(node);
+    result->simplify();
+  }
+  arena.simplifiedById[nodeId] =
+      result ? SEGWrapper->internCondition(result) : nullptr;
+  return result;
 }
 
 ConditionNode *ConditionTree::diffCondition(ConditionNode *node1,
                                             ConditionNode *node2) {
-  set<SEGNodeBase *> allSEGNode1 = node1->obtainNodes();
-  set<SEGNodeBase *> allSEGNode2 = node2->obtainNodes();
-
-  string command =
-      "python3 /Users/harperchen/PycharmProjects/pythonProject9/main.py diff " +
-      createArgFile(node1->dump()) + " " + createArgFile(node2->dump());
-  string outputExpr = readFileContents(execCommand(command));
-
-  //  ConditionNode *diffNode = parseFromString(outputExpr, );
+  auto SEGWrapper = node2->SEGWrapper;
+  auto diffNode = SEGWrapper->newCondition(NODE_AND);
+  auto notNode = SEGWrapper->newCondition(NODE_NOT);
+  notNode->addChild(node1);
+  diffNode->addChild(notNode);
+  diffNode->addChild(node2);
+  return simplifyCondition(SEGWrapper, diffNode);
 }
 
 void ConditionNode::eliminateCond(SEGNodeBase *node) {
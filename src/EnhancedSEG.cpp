@@ -2,9 +2,73 @@
 #include "ConditionNode.h"
 #include "ValueHelper.h"
 #include <IR/ConstantsContext.h>
+#include <llvm/ADT/Hashing.h>
 #include <algorithm>
+#include <climits>
 #include <regex>
 
+static cl::opt<bool, false> GoalDirectedSlicing(
+    "goal-directed-slicing",
+    cl::desc("Only expand SEG nodes that can connect an input to an output "
+             "when slicing the last stage of intra criteria."),
+    cl::init(true), cl::Hidden);
+
+static cl::opt<bool, false> BidirectionalSlicing(
+    "bidirectional-slicing",
+    cl::desc("Join source-ended backward paths and sink-ended forward paths "
+             "at the criterion, keeping only the connecting sub-traces."),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<bool, false> SymbolicPathCondition(
+    "symbolic-path-condition",
+    cl::desc("Guard traces by memoized dynamic programming over the CDG "
+             "instead of enumerating and checking every CDG path. Paths "
+             "without literals are skipped as in the default mode, but "
+             "infeasible paths are not filtered out."),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> CallContextDepth(
+    "call-context-depth",
+    cl::desc("Keep at most this many functions per call context of inter "
+             "slicing, 0 for unlimited."),
+    cl::init(0), cl::Hidden);
+
+static cl::opt<unsigned> CallContextBudget(
+    "call-context-budget",
+    cl::desc("Slice along at most this many call contexts per criterion of "
+             "inter slicing, 0 for unlimited."),
+    cl::init(0), cl::Hidden);
+
+// trace ids are handed out in the order traces are interned, so traces and
+// their input/output nodes are visited in a stable order, not by address
+template <typename Trace>
+static vector<const Trace *> sortTraces(const set<Trace> &traces) {
+  vector<const Trace *> sorted;
+  for (auto &trace : traces) {
+    sorted.push_back(&trace);
+  }
+  sort(sorted.begin(), sorted.end(), [](const Trace *A, const Trace *B) {
+    return seg_trace_cmp()(*A, *B);
+  });
+  return sorted;
+}
+
+template <typename IONode>
+static vector<IONode *> sortIONodes(const set<IONode *> &nodes) {
+  vector<IONode *> sorted(nodes.begin(), nodes.end());
+  stable_sort(sorted.begin(), sorted.end(), io_node_cmp());
+  return sorted;
+}
+
+// position of the first occurrence of each object on the trace, so that
+// sub-traces can be cut without scanning the trace per input/output pair
+static void indexTraceObjects(const vector<SEGObject *> &trace,
+                              map<SEGObject *, int> &positions) {
+  for (int i = 0; i < trace.size(); i++) {
+    positions.insert({trace[i], i});
+  }
+}
+
 EnhancedSEGWrapper::EnhancedSEGWrapper(
     Module *pM, SymbolicExprGraphBuilder *pSEGBuilder,
     SymbolicExprGraphSolver *pSEGSolver, DebugInfoAnalysis *pDIA,
@@ -95,9 +159,21 @@ void EnhancedSEGWrapper::value2EnhancedSEGNode(set<Value *> &values,
 }
 
 void EnhancedSEGWrapper::obtainIntraEnhancedSlicing(
-    set<SEGTraceWithBB> intraSEGTraces, set<EnhancedSEGTrace *> &intraTraces) {
-  for (auto segTrace : intraSEGTraces) {
-
+    const set<PooledSEGTrace> &intraSEGTraces, EnhancedTraceSet &intraTraces) {
+  // read the objects back from the pool, handles follow the slicing order and
+  // would not give a stable order of the traces
+  vector<pair<SEGTraceWithBB, const PooledSEGTrace *>> segTraces;
+  for (auto &pooledTrace : intraSEGTraces) {
+    segTraces.push_back(
+        {SEGTraceWithBB(intraSlicing.visitedTraces.get(pooledTrace.handle),
+                        pooledTrace.bbs),
+         &pooledTrace});
+  }
+  sort(segTraces.begin(), segTraces.end(), [](const auto &A, const auto &B) {
+    return seg_trace_cmp()(A.first, B.first);
+  });
+
+  for (auto &[segTrace, pooledTrace] : segTraces) {
     set<InputNode *> inputNodes;
     canFindInput(segTrace.trace, inputNodes, true);
 
@@ -106,19 +182,39 @@ void EnhancedSEGWrapper::obtainIntraEnhancedSlicing(
     if (inputNodes.empty() || outputNodes.empty()) {
       continue;
     }
-    for (auto inputNode : inputNodes) {
-      for (auto outputNode : outputNodes) {
+
+    bool isCut = pooledTrace->startIdx >= 0 && pooledTrace->endIdx >= 0;
+    map<SEGObject *, int> positions;
+    if (!isCut) {
+      indexTraceObjects(segTrace.trace, positions);
+    }
+    auto sortedOutputs = sortIONodes(outputNodes);
+    for (auto inputNode : sortIONodes(inputNodes)) {
+      for (auto outputNode : sortedOutputs) {
         if (!inputNode || !outputNode ||
             !ifInOutputMatch(inputNode, outputNode)) {
           continue;
         }
 
-        long start_idx = find(segTrace.trace.begin(), segTrace.trace.end(),
-                              inputNode->usedNode) -
-                         segTrace.trace.begin();
-        long end_idx = find(segTrace.trace.begin(), segTrace.trace.end(),
-                            outputNode->usedNode) -
-                       segTrace.trace.begin();
+        long start_idx, end_idx;
+        if (isCut) {
+          // inputs and outputs in the middle belong to shorter sub-traces,
+          // which the bidirectional search emits on their own
+          if (inputNode->usedNode != segTrace.trace[pooledTrace->startIdx] ||
+              outputNode->usedNode != segTrace.trace[pooledTrace->endIdx]) {
+            continue;
+          }
+          start_idx = pooledTrace->startIdx;
+          end_idx = pooledTrace->endIdx;
+        } else {
+          auto startIt = positions.find(inputNode->usedNode);
+          auto endIt = positions.find(outputNode->usedNode);
+          if (startIt == positions.end() || endIt == positions.end()) {
+            continue;
+          }
+          start_idx = startIt->second;
+          end_idx = endIt->second;
+        }
         vector<SEGObject *> sub_trace(segTrace.trace.begin() + start_idx,
                                       segTrace.trace.begin() + end_idx + 1);
 
@@ -138,16 +234,7 @@ void EnhancedSEGWrapper::obtainIntraEnhancedSlicing(
               chrono::duration_cast<std::chrono::microseconds>(stop - start);
           collect_condition_time += duration.count();
 
-          bool found_exist = false;
-          for (auto cur_item : intraTraces) {
-            if (isTwoEnhancedTraceEq(enhancedTrace, cur_item)) {
-              found_exist = true;
-              break;
-            }
-          }
-          if (!found_exist) {
-            intraTraces.insert(enhancedTrace);
-          }
+          intraTraces.insert(internTrace(enhancedTrace));
         }
       }
     }
@@ -175,6 +262,61 @@ bool EnhancedSEGWrapper::isTwoEnhancedTraceEq(EnhancedSEGTrace *trace1,
   return true;
 }
 
+EnhancedSEGTrace *EnhancedSEGWrapper::internTrace(EnhancedSEGTrace *trace) {
+  if (trace->id) {
+    return trace;
+  }
+  // conditions may still be simplified in place, so they are compared but
+  // not hashed
+  size_t hash = std::hash<SEGObject *>()(trace->input_node->usedNode);
+  hash = hash_combine(hash,
+                      std::hash<SEGObject *>()(trace->output_node->usedNode));
+  for (auto node : trace->trace.trace) {
+    hash = hash_combine(hash, std::hash<SEGObject *>()(node));
+  }
+  for (auto bb : trace->trace.bbs) {
+    hash = hash_combine(hash, std::hash<BasicBlock *>()(bb));
+  }
+
+  auto &bucket = traceBuckets[hash];
+  for (auto candidate : bucket) {
+    if (isTwoEnhancedTraceEq(trace, candidate)) {
+      delete trace;
+      return candidate;
+    }
+  }
+  trace->id = traceStore.size() + 1;
+  traceStore.emplace_back(trace);
+  bucket.push_back(trace);
+  return trace;
+}
+
+void EnhancedSEGWrapper::resetPatchState() {
+  // visited traces filter what is already emitted, keeping them would hide
+  // the traces of the next patch; merged states already gave theirs away
+  intraSlicing.visitedTraces = TracePool();
+  intraSlicing.collect_concat_time = 0;
+  intraSlicing.collect_forward_time = 0;
+  intraSlicing.collect_backward_time = 0;
+  intraSlicing.count_obtain_backward_cache = 0;
+  intraSlicing.count_obtain_forward_cache = 0;
+  intraSlicing.count_pruned_criteria = 0;
+
+  traceBuckets.clear();
+  traceStore.clear();
+
+  collect_traces_time = 0;
+  collect_condition_time = 0;
+  collect_inter_forward_time = 0;
+  collect_inter_backward_time = 0;
+  collect_bb_path = 0;
+  collect_whole_smt = 0;
+  check_feasibile_time = 0;
+  check_whether_io = 0;
+  collect_trace_smt = 0;
+  count_core_pruned_paths = 0;
+}
+
 bool EnhancedSEGWrapper::isTwoIONodeEqual(EnhancedSEGTrace *trace1,
                                           EnhancedSEGTrace *trace2) {
   if (trace1->input_node->usedNode != trace2->input_node->usedNode) {
@@ -194,39 +336,9 @@ bool EnhancedSEGWrapper::isTwoIONodeEqual(EnhancedSEGTrace *trace1,
 
 bool EnhancedSEGWrapper::isTwoConditionEqual(ConditionNode *cond1,
                                              ConditionNode *cond2) {
-  if (cond1->type != cond2->type)
-    return false;
-  if ((cond1->value == nullptr) ^ (cond2->value == nullptr))
-    return false;
-
-  if (cond1->value != nullptr && cond2->value != nullptr) {
-    if (cond1->value == cond2->value) {
-      return true;
-    } else {
-      return false;
-    }
-  }
-  if (cond1->children.size() != cond2->children.size())
-    return false;
-
-  set<ConditionNode *> matchedCondNodes;
-  for (auto i : cond1->children) {
-    bool find_match = false;
-    for (auto j : cond2->children) {
-      if (matchedCondNodes.find(j) != matchedCondNodes.end()) {
-        continue;
-      }
-      if (isTwoConditionEqual(i, j)) {
-        matchedCondNodes.insert(j);
-        find_match = true;
-        break;
-      }
-    }
-    if (!find_match) {
-      return false;
-    }
-  }
-  return true;
+  // interning orders the operands of AND/OR, so this also matches
+  // conditions whose operands are permuted
+  return internCondition(cond1) == internCondition(cond2);
 }
 
 // collect related BBs on seg trace
@@ -426,16 +538,21 @@ std::vector<T> concatenate(const std::vector<T> &v1, const std::vector<T> &v2) {
   return result;
 }
 
-void EnhancedSEGWrapper::collectBBsToEntry(
-    EnhancedSEGTrace *trace,
-    set<vector<pair<BasicBlock *, CDType>>> &totalCFGPaths) {
-
+vector<BasicBlock *>
+EnhancedSEGWrapper::obtainBBsOnTrace(EnhancedSEGTrace *trace) {
   auto bbOnTraces = trace->trace.bbs;
   if (trace->output_node->usedNode->getParentBasicBlock() ==
       trace->output_node->usedSite->getParentBasicBlock()) {
     bbOnTraces.push_back(trace->output_node->usedSite->getParentBasicBlock());
   }
+  return bbOnTraces;
+}
 
+void EnhancedSEGWrapper::collectBBsToEntry(
+    EnhancedSEGTrace *trace,
+    set<vector<pair<BasicBlock *, CDType>>> &totalCFGPaths) {
+
+  auto bbOnTraces = obtainBBsOnTrace(trace);
   if (bbOnTraces.empty()) {
     return;
   }
@@ -530,6 +647,231 @@ void EnhancedSEGWrapper::collectBBsToEntry(
   DEBUG_WITH_TYPE("condition", dbgs() << "======Finished\n");
 }
 
+CDGuardNode *EnhancedSEGWrapper::computeCDGuard(
+    BasicBlock *startBB, BasicBlock *endBB,
+    map<pair<BasicBlock *, CDType>, unsigned> &inProgress,
+    unsigned &cutDepth) {
+  auto startEndBB = make_pair(startBB, endBB);
+  auto it = cdGuardMemo.find(startEndBB);
+  if (it != cdGuardMemo.end()) {
+    return it->second;
+  }
+
+  cdGuardNodes.emplace_back();
+  auto guard = &cdGuardNodes.back();
+  if (startBB == endBB) {
+    guard->terminal = true;
+    cdGuardMemo[startEndBB] = guard;
+    return guard;
+  }
+
+  // same dependents as collectPathToEntryOnCDG, but each (start, dependent)
+  // pair is solved once and shared by all the paths going through it
+  ControlDependenceGraph &CDG = *(*CDGs)[startBB->getParent()];
+  kvec<kpair<CDType, BasicBlock *>> CDeps;
+  int NumDeps = CDG.get_dependents(endBB, CDeps);
+
+  unsigned depth = inProgress.size();
+  unsigned localCutDepth = UINT_MAX;
+  for (int Index = 0; Index < NumDeps; ++Index) {
+    BasicBlock *CDBB = CDeps[Index].second;
+    auto type = CDeps[Index].first;
+
+    if (!CDBB) {
+      continue;
+    }
+    if (!CRA->isBBReachable(startBB, CDBB) && startBB != CDBB) {
+      continue;
+    }
+    // a dependence cycle does not extend the path
+    auto cycleIt = inProgress.find({CDBB, type});
+    if (cycleIt != inProgress.end()) {
+      localCutDepth = min(localCutDepth, cycleIt->second);
+      continue;
+    }
+    inProgress[{CDBB, type}] = depth;
+    auto succ = computeCDGuard(startBB, CDBB, inProgress, localCutDepth);
+    inProgress.erase({CDBB, type});
+    guard->succs.push_back({{CDBB, type}, succ});
+  }
+
+  // paths end where no dependent is left
+  guard->terminal = guard->succs.empty();
+  if (localCutDepth >= depth) {
+    cdGuardMemo[startEndBB] = guard;
+  }
+  cutDepth = min(cutDepth, localCutDepth);
+  return guard;
+}
+
+CDGuardNode *EnhancedSEGWrapper::paths2CDGuard(
+    set<vector<pair<BasicBlock *, CDType>>> &paths) {
+  cdGuardNodes.emplace_back();
+  auto root = &cdGuardNodes.back();
+  for (const auto &path : paths) {
+    auto curNode = root;
+    for (auto bbInfo : path) {
+      auto it = find_if(curNode->succs.begin(), curNode->succs.end(),
+                        [&](const pair<pair<BasicBlock *, CDType>,
+                                       CDGuardNode *> &succ) {
+                          return succ.first == bbInfo;
+                        });
+      if (it != curNode->succs.end()) {
+        curNode = it->second;
+        continue;
+      }
+      cdGuardNodes.emplace_back();
+      curNode->succs.push_back({bbInfo, &cdGuardNodes.back()});
+      curNode = &cdGuardNodes.back();
+    }
+    curNode->terminal = true;
+  }
+  return root;
+}
+
+CDGuardNode *EnhancedSEGWrapper::getCDGuard(BasicBlock *startBB,
+                                            BasicBlock *endBB) {
+  auto startEndBB = make_pair(startBB, endBB);
+  auto it = startEndBBsToGuard.find(startEndBB);
+  if (it != startEndBBsToGuard.end()) {
+    return it->second;
+  }
+
+  map<pair<BasicBlock *, CDType>, unsigned> inProgress;
+  unsigned cutDepth = UINT_MAX;
+  auto guard = computeCDGuard(startBB, endBB, inProgress, cutDepth);
+  if (startBB != endBB && guard->succs.empty()) {
+    // no dependent at all, fall back to the CFG like collectBBsToEntry
+    set<vector<pair<BasicBlock *, CDType>>> cfgPaths;
+    set<pair<BasicBlock *, CDType>> visitedBBs;
+    vector<pair<BasicBlock *, CDType>> curPath;
+    collectPathToEntryOnCFG(startBB, endBB, visitedBBs, curPath, cfgPaths);
+    guard = paths2CDGuard(cfgPaths);
+  }
+  startEndBBsToGuard[startEndBB] = guard;
+  return guard;
+}
+
+ConditionNode *EnhancedSEGWrapper::cdGuard2IOCondition(
+    CDGuardNode *guard, vector<SEGObject *> &guardedTrace,
+    map<CDGuardNode *, pair<ConditionNode *, bool>> &memo, bool &literalFree) {
+  if (guard->terminal) {
+    literalFree = true;
+    return nullptr;
+  }
+  auto memoIt = memo.find(guard);
+  if (memoIt != memo.end()) {
+    literalFree = memoIt->second.second;
+    return memoIt->second.first;
+  }
+  // as in path2IOCondition, a path without any literal adds no condition,
+  // rather than making the guard unconditional
+  literalFree = false;
+  auto orNode = newCondition(NODE_OR);
+  for (auto &[bbInfo, succ] : guard->succs) {
+    auto literal = bbInfo2IOCondition(bbInfo, guardedTrace);
+    bool restLiteralFree = false;
+    auto rest =
+        cdGuard2IOCondition(succ, guardedTrace, memo, restLiteralFree);
+    if (!literal) {
+      literalFree |= restLiteralFree;
+      if (rest) {
+        orNode->addChild(rest);
+      }
+    } else if (restLiteralFree) {
+      // the literal alone covers the paths with and without further ones
+      orNode->addChild(literal);
+    } else if (rest) {
+      auto andNode = newCondition(NODE_AND);
+      andNode->addChild(literal);
+      andNode->addChild(rest);
+      orNode->addChild(andNode);
+    }
+  }
+  ConditionNode *result = nullptr;
+  if (orNode->children.size() == 1) {
+    result = orNode->children[0];
+  } else if (!orNode->children.empty()) {
+    result = orNode;
+  }
+  memo[guard] = {result, literalFree};
+  return result;
+}
+
+void EnhancedSEGWrapper::collectConditionsOnCDGuard(
+    EnhancedSEGTrace *enhanced_trace) {
+  auto vf_start = chrono::high_resolution_clock::now();
+  auto bbOnTraces = obtainBBsOnTrace(enhanced_trace);
+  vector<CDGuardNode *> segmentGuards;
+  if (!bbOnTraces.empty()) {
+    BasicBlock *startBB = bbOnTraces.front();
+    for (auto bb : bbOnTraces) {
+      if (startBB == bb) {
+        continue;
+      }
+      segmentGuards.push_back(getCDGuard(startBB, bb));
+      startBB = bb;
+    }
+  }
+  auto vf_stop = chrono::high_resolution_clock::now();
+  auto vf_duration =
+      chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
+  collect_bb_path += vf_duration.count();
+
+  vf_start = chrono::high_resolution_clock::now();
+  // an OR without any path is false, no path through one of the segments
+  // leaves nothing to multiply
+  enhanced_trace->conditions = newCondition(NODE_OR);
+  bool hasDeadSegment =
+      any_of(segmentGuards.begin(), segmentGuards.end(),
+             [](CDGuardNode *guard) { return guard->isDead(); });
+  if (!hasDeadSegment) {
+    map<CDGuardNode *, pair<ConditionNode *, bool>> guardConditions;
+    vector<pair<ConditionNode *, bool>> segments;
+    bool allLiteralFree = true;
+    for (auto guard : segmentGuards) {
+      bool literalFree = false;
+      auto segmentNode = cdGuard2IOCondition(
+          guard, enhanced_trace->trace.trace, guardConditions, literalFree);
+      segments.push_back({segmentNode, literalFree});
+      allLiteralFree &= literalFree;
+    }
+    bool hasPath = all_of(segments.begin(), segments.end(),
+                          [](const pair<ConditionNode *, bool> &segment) {
+                            return segment.first || segment.second;
+                          });
+    // without a path through one of the segments the condition stays false
+    if (hasPath && !allLiteralFree) {
+      // every path passes a literal, a segment with literal-free paths
+      // constrains nothing
+      auto pathNode = newCondition(NODE_AND);
+      for (auto &[segmentNode, literalFree] : segments) {
+        if (!literalFree) {
+          pathNode->addChild(segmentNode);
+        }
+      }
+      enhanced_trace->conditions->addChild(pathNode);
+    } else if (hasPath) {
+      // the only path without literals is skipped, as in the default mode:
+      // the others pass a literal in at least one segment
+      for (auto &[segmentNode, literalFree] : segments) {
+        if (segmentNode) {
+          enhanced_trace->conditions->addChild(segmentNode);
+        }
+      }
+      if (enhanced_trace->conditions->children.empty()) {
+        enhanced_trace->conditions->clear();
+      }
+    }
+  }
+  vf_stop = chrono::high_resolution_clock::now();
+  vf_duration =
+      chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
+  collect_whole_smt += vf_duration.count();
+  DEBUG_WITH_TYPE("time", dbgs() << "Time for collect guard condition: "
+                                 << collect_whole_smt / 1000 << "ms\n");
+}
+
 void EnhancedSEGWrapper::dumpEnhancedTraceCond(const EnhancedSEGTrace *trace) {
   dbgs() << "[Input Node]: " << *trace->input_node->usedNode << "\n";
   if (trace->input_node->usedSite) {
@@ -554,6 +896,11 @@ void EnhancedSEGWrapper::collectConditions(EnhancedSEGTrace *enhanced_trace) {
       "condition",
       dbgs() << "\n======Start Collect Condition for Trace======\n");
 
+  if (SymbolicPathCondition) {
+    collectConditionsOnCDGuard(enhanced_trace);
+    return;
+  }
+
   auto vf_start = chrono::high_resolution_clock::now();
   // collect related basic blocks along the def-use chain
   set<vector<pair<BasicBlock *, CDType>>> totalCFGPaths;
@@ -567,11 +914,14 @@ void EnhancedSEGWrapper::collectConditions(EnhancedSEGTrace *enhanced_trace) {
 
   vf_start = chrono::high_resolution_clock::now();
   // convert the BB path to condition node
-  enhanced_trace->conditions = new ConditionNode(this, NODE_OR);
+  enhanced_trace->conditions = newCondition(NODE_OR);
+  checkPathsFeasibility(totalCFGPaths);
+  bool hasFeasiblePath = totalCFGPaths.empty();
   for (const auto &path : totalCFGPaths) {
     if (!checkCurPathFeasibility(path)) {
       continue;
     }
+    hasFeasiblePath = true;
     auto pathNode = path2IOCondition(path, enhanced_trace->trace.trace);
     if (!pathNode) {
       continue;
@@ -580,6 +930,11 @@ void EnhancedSEGWrapper::collectConditions(EnhancedSEGTrace *enhanced_trace) {
       enhanced_trace->conditions->addChild(pathNode);
     }
   }
+  // the empty OR is false, kept only if no path is feasible; paths without
+  // a literal leave the trace unconstrained
+  if (hasFeasiblePath && enhanced_trace->conditions->children.empty()) {
+    enhanced_trace->conditions->clear();
+  }
   vf_stop = chrono::high_resolution_clock::now();
   vf_duration =
       chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
@@ -590,146 +945,277 @@ void EnhancedSEGWrapper::collectConditions(EnhancedSEGTrace *enhanced_trace) {
 
 bool EnhancedSEGWrapper::checkCurPathFeasibility(
     vector<pair<BasicBlock *, CDType>> path) {
-  if (feasibilityBBPaths.find(path) != feasibilityBBPaths.end()) {
-    return feasibilityBBPaths[path] != SMTSolver::SMTRT_Unsat;
+  if (feasibilityBBPaths.find(path) == feasibilityBBPaths.end()) {
+    checkPathsFeasibility({path});
   }
-  auto vf_start = chrono::high_resolution_clock::now();
-  auto pathNode = new ConditionNode(this, NODE_AND);
-  for (auto bbInfo : path) {
-    TerminatorInst *CDTerminator = bbInfo.first->getTerminator();
-    if (auto *brInst = dyn_cast<BranchInst>(CDTerminator)) {
-      if (auto *icmpInst = dyn_cast<ICmpInst>(brInst->getCondition())) {
-        auto curNode = new ConditionNode(
-            this, SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
-                      ->findNode(icmpInst));
-        if (bbInfo.second == ControlDependenceGraph::DepFalse) {
-          auto notNode = new ConditionNode(this, NODE_NOT);
-          notNode->addChild(curNode);
-          pathNode->addChild(notNode);
-        } else {
-          pathNode->addChild(curNode);
-        }
-      } else if (auto *biInst =
-                     dyn_cast<BinaryOperator>(brInst->getCondition())) {
-        DEBUG_WITH_TYPE("condition", dbgs() << "Binary Operator Instruction "
-                                            << *biInst << "\n");
-        vector<BinaryOperator *> worklist;
-        vector<BinaryOperator::BinaryOps> opcodelist;
-        ConditionNode *lastCondNode = nullptr;
-        worklist.push_back(biInst);
-
-        while (!worklist.empty()) {
-          BinaryOperator *curBiInst = worklist.front();
-          worklist.erase(worklist.begin());
-          for (int i = 0; i < curBiInst->getNumOperands(); i++) {
-            if (auto *newBiInst =
-                    dyn_cast<BinaryOperator>(curBiInst->getOperand(i))) {
-              worklist.push_back(newBiInst);
-              opcodelist.push_back(biInst->getOpcode());
-            } else if (auto *newIcmpInst =
-                           dyn_cast<ICmpInst>(curBiInst->getOperand(i))) {
-              lastCondNode = new ConditionNode(
-                  this,
-                  SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
-                      ->findNode(icmpInst));
-            }
-          }
-        }
-      } else if (auto *callInst = dyn_cast<CallInst>(brInst->getCondition())) {
-        if (callInst->getCalledFunction()->getName().equals(
-                "llvm.is.constant.i64")) {
-          continue;
-        }
+  return feasibilityBBPaths[path] != SMTSolver::SMTRT_Unsat;
+}
+
+ConditionNode *
+EnhancedSEGWrapper::bbInfo2Condition(pair<BasicBlock *, CDType> bbInfo) {
+  auto it = bbLiterals.find(bbInfo);
+  if (it != bbLiterals.end()) {
+    return it->second;
+  }
+
+  ConditionNode *literal = nullptr;
+  TerminatorInst *CDTerminator = bbInfo.first->getTerminator();
+  if (auto *brInst = dyn_cast<BranchInst>(CDTerminator)) {
+    if (auto *icmpInst = dyn_cast<ICmpInst>(brInst->getCondition())) {
+      auto curNode = newCondition(
+          SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
+              ->findNode(icmpInst));
+      if (bbInfo.second == ControlDependenceGraph::DepFalse) {
+        literal = newCondition(NODE_NOT);
+        literal->addChild(curNode);
       } else {
-        dbgs() << "!!!Unhandled Conditions " << *brInst->getCondition() << "\n";
+        literal = curNode;
       }
-    } else {
-      dbgs() << "!!!Unhandled Terminators " << *CDTerminator << "\n";
+    } else if (auto *biInst =
+                   dyn_cast<BinaryOperator>(brInst->getCondition())) {
+      DEBUG_WITH_TYPE("condition", dbgs() << "Binary Operator Instruction "
+                                          << *biInst << "\n");
+    } else if (!isa<CallInst>(brInst->getCondition())) {
+      dbgs() << "!!!Unhandled Conditions " << *brInst->getCondition() << "\n";
     }
+  } else {
+    dbgs() << "!!!Unhandled Terminators " << *CDTerminator << "\n";
   }
-  // pruning infeasible paths
-  auto smtDataExpr = condNode2SMTExprIntra(pathNode);
-  SEGSolver->push();
-  SEGSolver->add(smtDataExpr && pathNode->toSMTExpr(SEGSolver));
-  auto checkRet = SEGSolver->check();
-  SEGSolver->pop();
 
-  feasibilityBBPaths.insert({path, checkRet});
-  if (checkRet == SMTSolver::SMTRT_Unsat) {
-    DEBUG_WITH_TYPE("condition", dbgs() << "Infeasible BB Path:\n");
-    for (auto bb : path) {
-      DEBUG_WITH_TYPE("condition",
-                      dbgs() << bb.first->getName() << " " << bb.second << " ");
+  if (literal) {
+    // the branch together with the data dependence of its operands
+    auto literalExpr =
+        condNode2SMTExprIntra(literal) && condNode2SMTExpr(literal);
+    bbLiteralExprs.insert({bbInfo, literalExpr});
+  }
+  bbLiterals[bbInfo] = literal;
+  return literal;
+}
+
+bool EnhancedSEGWrapper::containsInfeasibleCore(
+    const map<pair<BasicBlock *, CDType>, unsigned> &prefixLiterals,
+    pair<BasicBlock *, CDType> bbInfo) {
+  auto it = literal2InfeasibleCores.find(bbInfo);
+  if (it == literal2InfeasibleCores.end()) {
+    return false;
+  }
+  for (auto coreId : it->second) {
+    const auto &core = infeasibleCores[coreId];
+    bool covered = all_of(core.begin(), core.end(), [&](const auto &literal) {
+      return literal == bbInfo || prefixLiterals.count(literal);
+    });
+    if (covered) {
+      count_core_pruned_paths += 1;
+      DEBUG_WITH_TYPE("time", dbgs() << "BB paths pruned by infeasible cores: "
+                                     << count_core_pruned_paths << "\n");
+      return true;
     }
-    DEBUG_WITH_TYPE("condition", dbgs() << "\n\n");
   }
+  return false;
+}
+
+void EnhancedSEGWrapper::learnInfeasibleCore(
+    const vector<pair<BasicBlock *, CDType>> &prefix,
+    pair<BasicBlock *, CDType> bbInfo) {
+  // leave the asserted prefix first, otherwise every check below is unsat
+  // and the core degenerates to bbInfo alone
+  for (int i = 0; i <= prefix.size(); i++) {
+    SEGSolver->pop();
+  }
+
+  // deletion-based minimization: drop every literal whose removal keeps the
+  // conjunction unsat, bbInfo itself made the prefix unsat so it stays
+  vector<pair<BasicBlock *, CDType>> core;
+  for (auto &literal : prefix) {
+    if (literal != bbInfo &&
+        find(core.begin(), core.end(), literal) == core.end()) {
+      core.push_back(literal);
+    }
+  }
+  for (int i = core.size() - 1; i >= 0; i--) {
+    SEGSolver->push();
+    SEGSolver->add(bbLiteralExprs.find(bbInfo)->second);
+    for (int j = 0; j < core.size(); j++) {
+      if (j != i) {
+        SEGSolver->add(bbLiteralExprs.find(core[j])->second);
+      }
+    }
+    auto checkRet = SEGSolver->check();
+    SEGSolver->pop();
+    if (checkRet == SMTSolver::SMTRT_Unsat) {
+      core.erase(core.begin() + i);
+    }
+  }
+  core.push_back(bbInfo);
+  sort(core.begin(), core.end());
+
+  for (auto &literal : prefix) {
+    SEGSolver->push();
+    SEGSolver->add(bbLiteralExprs.find(literal)->second);
+  }
+  SEGSolver->push();
+  SEGSolver->add(bbLiteralExprs.find(bbInfo)->second);
+
+  unsigned coreId = infeasibleCores.size();
+  for (auto &literal : core) {
+    literal2InfeasibleCores[literal].push_back(coreId);
+  }
+  infeasibleCores.push_back(core);
+
+  DEBUG_WITH_TYPE("condition", dbgs() << "Infeasible BB Core:\n");
+  for (auto bb : core) {
+    DEBUG_WITH_TYPE("condition",
+                    dbgs() << bb.first->getName() << " " << bb.second << " ");
+  }
+  DEBUG_WITH_TYPE("condition", dbgs() << "\n\n");
+}
+
+namespace {
+// candidate BB paths sharing their prefixes
+struct BBPathTrieNode {
+  map<pair<BasicBlock *, CDType>, unique_ptr<BBPathTrieNode>> children;
+  const vector<pair<BasicBlock *, CDType>> *path = nullptr;
+};
+} // namespace
+
+void EnhancedSEGWrapper::checkPathsFeasibility(
+    const set<vector<pair<BasicBlock *, CDType>>> &paths) {
+  auto vf_start = chrono::high_resolution_clock::now();
+
+  BBPathTrieNode root;
+  for (const auto &path : paths) {
+    if (feasibilityBBPaths.find(path) != feasibilityBBPaths.end()) {
+      continue;
+    }
+    auto curNode = &root;
+    for (auto bbInfo : path) {
+      auto &child = curNode->children[bbInfo];
+      if (!child) {
+        child.reset(new BBPathTrieNode());
+      }
+      curNode = child.get();
+    }
+    curNode->path = &path;
+  }
+
+  // assert the literals of a prefix once; an unsat prefix prunes all the
+  // paths below it without further checks
+  map<pair<BasicBlock *, CDType>, unsigned> prefixLiterals;
+  vector<pair<BasicBlock *, CDType>> prefix;
+  function<void(BBPathTrieNode *, SMTSolver::SMTResultType)> walk =
+      [&](BBPathTrieNode *node, SMTSolver::SMTResultType prefixRet) {
+        if (node->path) {
+          feasibilityBBPaths.insert({*node->path, prefixRet});
+          if (prefixRet == SMTSolver::SMTRT_Unsat) {
+            DEBUG_WITH_TYPE("condition", dbgs() << "Infeasible BB Path:\n");
+            for (auto bb : *node->path) {
+              DEBUG_WITH_TYPE("condition", dbgs() << bb.first->getName() << " "
+                                                  << bb.second << " ");
+            }
+            DEBUG_WITH_TYPE("condition", dbgs() << "\n\n");
+          }
+        }
+        for (auto &[bbInfo, child] : node->children) {
+          if (prefixRet == SMTSolver::SMTRT_Unsat ||
+              !bbInfo2Condition(bbInfo)) {
+            walk(child.get(), prefixRet);
+            continue;
+          }
+          if (containsInfeasibleCore(prefixLiterals, bbInfo)) {
+            walk(child.get(), SMTSolver::SMTRT_Unsat);
+            continue;
+          }
+          SEGSolver->push();
+          SEGSolver->add(bbLiteralExprs.find(bbInfo)->second);
+          auto checkRet = SEGSolver->check();
+          if (checkRet == SMTSolver::SMTRT_Unsat) {
+            learnInfeasibleCore(prefix, bbInfo);
+          }
+          prefixLiterals[bbInfo] += 1;
+          prefix.push_back(bbInfo);
+          walk(child.get(), checkRet);
+          prefix.pop_back();
+          if (--prefixLiterals[bbInfo] == 0) {
+            prefixLiterals.erase(bbInfo);
+          }
+          SEGSolver->pop();
+        }
+      };
+  walk(&root, SMTSolver::SMTRT_Sat);
+
   auto vf_stop = chrono::high_resolution_clock::now();
   auto vf_duration =
       chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
   check_feasibile_time += vf_duration.count();
-  return checkRet != SMTSolver::SMTRT_Unsat;
 }
 
 ConditionNode *
-EnhancedSEGWrapper::path2IOCondition(vector<pair<BasicBlock *, CDType>> path,
-                                     vector<SEGObject *> &guardedTrace) {
-  auto pathNode = new ConditionNode(this, NODE_AND);
-  auto vf_start = chrono::high_resolution_clock::now();
-
-  for (auto bbInfo : path) {
-    TerminatorInst *CDTerminator = bbInfo.first->getTerminator();
-    if (auto *brInst = dyn_cast<BranchInst>(CDTerminator)) {
-      if (auto *icmpInst = dyn_cast<ICmpInst>(brInst->getCondition())) {
-        if (!checkifICMPIO(icmpInst, guardedTrace)) {
-          continue;
-        }
-        auto curNode = new ConditionNode(
-            this, SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
-                      ->findNode(icmpInst));
-        if (bbInfo.second == ControlDependenceGraph::DepFalse) {
-          auto notNode = new ConditionNode(this, NODE_NOT);
-          notNode->addChild(curNode);
-          pathNode->addChild(notNode);
-        } else {
-          pathNode->addChild(curNode);
-        }
-      } else if (auto *biInst =
-                     dyn_cast<BinaryOperator>(brInst->getCondition())) {
-        vector<BinaryOperator *> worklist;
-        vector<BinaryOperator::BinaryOps> opcodelist;
-        ConditionNode *lastCondNode = nullptr;
-        worklist.push_back(biInst);
-
-        while (!worklist.empty()) {
-          BinaryOperator *curBiInst = worklist.front();
-          worklist.erase(worklist.begin());
-          for (int i = 0; i < curBiInst->getNumOperands(); i++) {
-            if (auto *newBiInst =
-                    dyn_cast<BinaryOperator>(curBiInst->getOperand(i))) {
-              worklist.push_back(newBiInst);
-              opcodelist.push_back(biInst->getOpcode());
-            } else if (auto *newIcmpInst =
-                           dyn_cast<ICmpInst>(curBiInst->getOperand(i))) {
-              if (!checkifICMPIO(newIcmpInst, guardedTrace)) {
-                continue;
-              }
-              lastCondNode = new ConditionNode(
-                  this,
-                  SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
-                      ->findNode(icmpInst));
+EnhancedSEGWrapper::bbInfo2IOCondition(pair<BasicBlock *, CDType> bbInfo,
+                                       vector<SEGObject *> &guardedTrace) {
+  TerminatorInst *CDTerminator = bbInfo.first->getTerminator();
+  if (auto *brInst = dyn_cast<BranchInst>(CDTerminator)) {
+    if (auto *icmpInst = dyn_cast<ICmpInst>(brInst->getCondition())) {
+      if (!checkifICMPIO(icmpInst, guardedTrace)) {
+        return nullptr;
+      }
+      auto curNode = newCondition(
+          SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
+              ->findNode(icmpInst));
+      if (bbInfo.second == ControlDependenceGraph::DepFalse) {
+        auto notNode = newCondition(NODE_NOT);
+        notNode->addChild(curNode);
+        return notNode;
+      }
+      return curNode;
+    } else if (auto *biInst =
+                   dyn_cast<BinaryOperator>(brInst->getCondition())) {
+      vector<BinaryOperator *> worklist;
+      vector<BinaryOperator::BinaryOps> opcodelist;
+      ConditionNode *lastCondNode = nullptr;
+      worklist.push_back(biInst);
+
+      while (!worklist.empty()) {
+        BinaryOperator *curBiInst = worklist.front();
+        worklist.erase(worklist.begin());
+        for (int i = 0; i < curBiInst->getNumOperands(); i++) {
+          if (auto *newBiInst =
+                  dyn_cast<BinaryOperator>(curBiInst->getOperand(i))) {
+            worklist.push_back(newBiInst);
+            opcodelist.push_back(biInst->getOpcode());
+          } else if (auto *newIcmpInst =
+                         dyn_cast<ICmpInst>(curBiInst->getOperand(i))) {
+            if (!checkifICMPIO(newIcmpInst, guardedTrace)) {
+              continue;
             }
+            lastCondNode = newCondition(
+                SEGBuilder->getSymbolicExprGraph(bbInfo.first->getParent())
+                    ->findNode(icmpInst));
           }
         }
-      } else if (auto *callInst = dyn_cast<CallInst>(brInst->getCondition())) {
-        if (callInst->getCalledFunction()->getName().equals(
-                "llvm.is.constant.i64")) {
-          continue;
-        }
-      } else {
-        dbgs() << "!!!Unhandled Conditions " << *brInst->getCondition() << "\n";
+      }
+    } else if (auto *callInst = dyn_cast<CallInst>(brInst->getCondition())) {
+      if (callInst->getCalledFunction()->getName().equals(
+              "llvm.is.constant.i64")) {
+        return nullptr;
       }
     } else {
-      dbgs() << "!!!Unhandled Terminators " << *CDTerminator << "\n";
+      dbgs() << "!!!Unhandled Conditions " << *brInst->getCondition() << "\n";
+    }
+  } else {
+    dbgs() << "!!!Unhandled Terminators " << *CDTerminator << "\n";
+  }
+  return nullptr;
+}
+
+ConditionNode *
+EnhancedSEGWrapper::path2IOCondition(vector<pair<BasicBlock *, CDType>> path,
+                                     vector<SEGObject *> &guardedTrace) {
+  auto pathNode = newCondition(NODE_AND);
+  auto vf_start = chrono::high_resolution_clock::now();
+
+  for (auto bbInfo : path) {
+    if (auto curNode = bbInfo2IOCondition(bbInfo, guardedTrace)) {
+      pathNode->addChild(curNode);
     }
   }
   auto vf_stop = chrono::high_resolution_clock::now();
@@ -797,7 +1283,7 @@ bool EnhancedSEGWrapper::checkifICMPIO(ICmpInst *iCmpInst,
   return invalidCondNode.size() != icmpNodes.size();
 }
 
-void EnhancedSEGWrapper::canFindInput(vector<SEGObject *> trace,
+void EnhancedSEGWrapper::canFindInput(const vector<SEGObject *> &trace,
                                       set<InputNode *> &inputNodes,
                                       bool intra) {
   if (trace.empty()) {
@@ -1001,51 +1487,125 @@ void EnhancedSEGWrapper::canFindInput(vector<SEGObject *> trace,
   }
 }
 
+SMTExpr EnhancedSEGWrapper::condNode2SMTExpr(ConditionNode *condNode) {
+  auto condId = internCondition(condNode)->id;
+  auto it = condExprs.find(condId);
+  if (it != condExprs.end()) {
+    return it->second;
+  }
+  auto condExpr = condNode->toSMTExpr(SEGSolver);
+  condExprs.insert({condId, condExpr});
+  return condExpr;
+}
+
 SMTExpr EnhancedSEGWrapper::condNode2SMTExprIntra(ConditionNode *condNode) {
-  map<SEGNodeBase *, set<vector<SEGObject *>>> localCond2ValueFlows;
+  auto key = make_pair(internCondition(condNode)->id, false);
+  auto it = condDepExprs.find(key);
+  if (it != condDepExprs.end()) {
+    return it->second;
+  }
+  map<SEGNodeBase *, PathDAGNode *> localCond2ValueFlows;
   condNode2FlowIntra(condNode->obtainNodes(), localCond2ValueFlows);
-  return condDataDepToExpr(condNode, localCond2ValueFlows);
+  bool cacheable;
+  auto depExpr = condDataDepToExpr(condNode, localCond2ValueFlows, cacheable);
+  if (cacheable) {
+    condDepExprs.insert({key, depExpr});
+  }
+  return depExpr;
+}
+
+SMTExpr
+EnhancedSEGWrapper::depTraceToExpr(const vector<SEGObject *> &depTrace) {
+  SMTExprVec all = SEGSolver->getSMTFactory().createEmptySMTExprVec();
+  vector<SEGNodeBase *> newDepTrace;
+  for (auto node : depTrace) {
+    if (auto *nodeBase = dyn_cast<SEGNodeBase>(node)) {
+      newDepTrace.push_back(nodeBase);
+    }
+  }
+
+  for (int i = newDepTrace.size() - 2; i >= 0; i--) {
+    if (isa<SEGOperandNode>(newDepTrace[i])) {
+      all.push_back(SEGSolver->getOrInsertExpr(newDepTrace[i]) ==
+                    SEGSolver->getOrInsertExpr(newDepTrace[i + 1]));
+    } else if (auto *NOpcode = dyn_cast<SEGOpcodeNode>(newDepTrace[i])) {
+      all.push_back(SEGSolver->encodeOpcodeNode(NOpcode));
+    }
+  }
+  return all.toAndExpr();
+}
+
+SMTExpr EnhancedSEGWrapper::condDataDepToExpr(
+    ConditionNode *curNode,
+    map<SEGNodeBase *, set<vector<SEGObject *>>> &cond2ValueFlows,
+    bool &cacheable) {
+  return condDataDepToExpr(
+      curNode, true,
+      [&](SEGNodeBase *opNode) { return cond2ValueFlows.count(opNode); },
+      [&](SEGNodeBase *opNode, SMTExprVec &traceVec) {
+        for (const auto &depTrace : cond2ValueFlows[opNode]) {
+          traceVec.push_back(depTraceToExpr(depTrace));
+        }
+      },
+      cacheable);
 }
 
 SMTExpr EnhancedSEGWrapper::condDataDepToExpr(
     ConditionNode *curNode,
-    map<SEGNodeBase *, set<vector<SEGObject *>>> &cond2ValueFlows) {
+    map<SEGNodeBase *, PathDAGNode *> &cond2ValueFlows, bool &cacheable) {
+  return condDataDepToExpr(
+      curNode, false,
+      [&](SEGNodeBase *opNode) { return cond2ValueFlows.count(opNode); },
+      [&](SEGNodeBase *opNode, SMTExprVec &traceVec) {
+        intraSlicing.pathDAG.forEachPath(
+            cond2ValueFlows[opNode], [&](const vector<SEGObject *> &depTrace) {
+              traceVec.push_back(depTraceToExpr(depTrace));
+              return true;
+            });
+      },
+      cacheable);
+}
+
+SMTExpr EnhancedSEGWrapper::condDataDepToExpr(
+    ConditionNode *curNode, bool inter,
+    const function<bool(SEGNodeBase *)> &hasDepFlows,
+    const function<void(SEGNodeBase *, SMTExprVec &)> &collectDepExprs,
+    bool &cacheable) {
   SMTExprVec dataDepExpr = SEGSolver->getSMTFactory().createEmptySMTExprVec();
+  cacheable = true;
 
   for (auto segNode : curNode->obtainNodes()) {
     SMTExprVec icmpVec = SEGSolver->getSMTFactory().createEmptySMTExprVec();
     for (auto opNode : segNode->Children.front()->Children) {
+      // the traces of an operand without flows are encoded per query, as
+      // the operand may get its flows by a later query
+      auto key = make_pair(opNode, inter);
+      auto it = depFlowExprs.find(key);
+      if (it != depFlowExprs.end()) {
+        icmpVec.push_back(it->second);
+        continue;
+      }
       SMTExprVec traceVec = SEGSolver->getSMTFactory().createEmptySMTExprVec();
-
-      for (const auto &depTrace : cond2ValueFlows[opNode]) {
-        SMTExprVec all = SEGSolver->getSMTFactory().createEmptySMTExprVec();
-        vector<SEGNodeBase *> newDepTrace;
-        for (auto node : depTrace) {
-          if (auto *nodeBase = dyn_cast<SEGNodeBase>(node)) {
-            newDepTrace.push_back(nodeBase);
-          }
-        }
-
-        for (int i = newDepTrace.size() - 2; i >= 0; i--) {
-          if (isa<SEGOperandNode>(newDepTrace[i])) {
-            all.push_back(SEGSolver->getOrInsertExpr(newDepTrace[i]) ==
-                          SEGSolver->getOrInsertExpr(newDepTrace[i + 1]));
-          } else if (auto *NOpcode = dyn_cast<SEGOpcodeNode>(newDepTrace[i])) {
-            all.push_back(SEGSolver->encodeOpcodeNode(NOpcode));
-          }
-        }
-
-        SMTExpr bugConst = all.toAndExpr();
-        traceVec.push_back(bugConst);
+      collectDepExprs(opNode, traceVec);
+      auto flowExpr = traceVec.toOrExpr();
+      if (hasDepFlows(opNode)) {
+        depFlowExprs.insert({key, flowExpr});
+      } else {
+        cacheable = false;
       }
-      icmpVec.push_back(traceVec.toOrExpr());
+      icmpVec.push_back(flowExpr);
     }
 
-    auto *icmpOpNode = dyn_cast<SEGOpcodeNode>(segNode->Children.front());
-    dataDepExpr.push_back(icmpVec.toAndExpr() &&
-                          SEGSolver->encodeOpcodeNode(icmpOpNode) &&
-                          SEGSolver->getOrInsertExpr(icmpOpNode) ==
-                              SEGSolver->getOrInsertExpr(segNode));
+    auto it = icmpExprs.find(segNode);
+    if (it == icmpExprs.end()) {
+      auto *icmpOpNode = dyn_cast<SEGOpcodeNode>(segNode->Children.front());
+      it = icmpExprs
+               .insert({segNode, SEGSolver->encodeOpcodeNode(icmpOpNode) &&
+                                     SEGSolver->getOrInsertExpr(icmpOpNode) ==
+                                         SEGSolver->getOrInsertExpr(segNode)})
+               .first;
+    }
+    dataDepExpr.push_back(icmpVec.toAndExpr() && it->second);
   }
   return dataDepExpr.toAndExpr();
 }
@@ -1065,13 +1625,11 @@ void EnhancedSEGWrapper::condNode2FlowInter(
     vector<SEGObject *> curTrace;
     set<vector<SEGObject *>> backwardTraces;
 
-    vector<Function *> curCallTrace;
     auto curFunc = node->getParentGraph()->getBaseFunc();
 
-    set<vector<Function *>> callTraces;
-    funcCallUpperTracer(curFunc, curCallTrace, callTraces);
-
-    for (auto callTrace : callTraces) {
+    auto callContexts = callerContexts(curFunc);
+    vector<Function *> callTrace;
+    while (callContexts.next(callTrace)) {
       auto vf_start = chrono::high_resolution_clock::now();
       interValueFlowBackward(node, callTrace, curTrace, backwardTraces);
       auto vf_stop = chrono::high_resolution_clock::now();
@@ -1086,7 +1644,7 @@ void EnhancedSEGWrapper::condNode2FlowInter(
 
 void EnhancedSEGWrapper::condNode2FlowIntra(
     set<SEGNodeBase *> condNodes,
-    map<SEGNodeBase *, set<vector<SEGObject *>>> &localCond2ValueFlows) {
+    map<SEGNodeBase *, PathDAGNode *> &localCond2ValueFlows) {
 
   for (auto node : condNodes) { // and relation
     if (!isa<ICmpInst>(node->getLLVMDbgValue())) {
@@ -1097,30 +1655,40 @@ void EnhancedSEGWrapper::condNode2FlowIntra(
       localCond2ValueFlows.insert({node, cond2ValueFlowsIntra[node]});
       continue;
     }
-    vector<SEGObject *> curTrace;
-    set<vector<SEGObject *>> backwardTraces;
+    set<SEGNodeBase *> onTrace;
 
     DEBUG_WITH_TYPE("time", dbgs() << "Backward for node: " << *node << "\n");
     auto vf_start = chrono::high_resolution_clock::now();
-    intraValueFlowBackward(node, curTrace, backwardTraces);
+    auto backwardPaths = intraValueFlowBackward(intraSlicing, node, onTrace);
     auto vf_stop = chrono::high_resolution_clock::now();
     auto vf_duration =
         chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
     collect_traces_time += vf_duration.count();
     DEBUG_WITH_TYPE("time", dbgs() << "Time for slicing at 547: "
                                    << collect_traces_time / 1000 << "ms\n");
-    DEBUG_WITH_TYPE(
-        "time", dbgs() << "Hit cache: " << count_obtain_backward_cache << "\n");
-    cond2ValueFlowsIntra.insert({node, backwardTraces});
-    localCond2ValueFlows.insert({node, backwardTraces});
+    DEBUG_WITH_TYPE("time", dbgs() << "Hit cache: "
+                                   << intraSlicing.count_obtain_backward_cache
+                                   << "\n");
+    cond2ValueFlowsIntra.insert({node, backwardPaths});
+    localCond2ValueFlows.insert({node, backwardPaths});
   }
 }
 
 SMTExpr EnhancedSEGWrapper::condNode2SMTExprInter(ConditionNode *condNode) {
+  auto key = make_pair(internCondition(condNode)->id, true);
+  auto it = condDepExprs.find(key);
+  if (it != condDepExprs.end()) {
+    return it->second;
+  }
   map<SEGNodeBase *, set<vector<SEGObject *>>> localCond2ValueFlows;
 
   condNode2FlowInter(condNode->obtainNodes(), localCond2ValueFlows);
-  return condDataDepToExpr(condNode, localCond2ValueFlows);
+  bool cacheable;
+  auto depExpr = condDataDepToExpr(condNode, localCond2ValueFlows, cacheable);
+  if (cacheable) {
+    condDepExprs.insert({key, depExpr});
+  }
+  return depExpr;
 }
 
 // here, we consider the case where p = q, p = not q, p => q or q => p
@@ -1206,7 +1774,7 @@ bool EnhancedSEGWrapper::isConditionAReduceB(ConditionNode *curCond,
   SEGSolver->add(smtDataExpr1);
   SEGSolver->add(smtDataExpr2);
   SEGSolver->add(
-      !(!curCond->toSMTExpr(SEGSolver) || otherCond->toSMTExpr(SEGSolver)));
+      !(!condNode2SMTExpr(curCond) || condNode2SMTExpr(otherCond)));
   //  DEBUG_WITH_TYPE("condition",  dbgs() << "Xor SMT String For Merge\n" <<
   //  SEGSolver->to_smt2() << "\n");
   auto checkRet = SEGSolver->check();
@@ -1390,8 +1958,7 @@ bool EnhancedSEGWrapper::isConditionConflict(ConditionNode *curCond,
 
   SEGSolver->push();
   SEGSolver->add(smtDataExpr1 && smtDataExpr2 &&
-                 curCond->toSMTExpr(SEGSolver) &&
-                 otherCond->toSMTExpr(SEGSolver));
+                 condNode2SMTExpr(curCond) && condNode2SMTExpr(otherCond));
   auto checkRet = SEGSolver->check();
   SEGSolver->pop();
   if (checkRet == SMTSolver::SMTRT_Unsat) {
@@ -1549,8 +2116,7 @@ bool EnhancedSEGWrapper::isConditionMerge(ConditionNode *curCond,
   SEGSolver->push();
   SEGSolver->add(smtDataExpr1);
   SEGSolver->add(smtDataExpr2);
-  SEGSolver->add(curCond->toSMTExpr(SEGSolver) ^
-                 otherCond->toSMTExpr(SEGSolver));
+  SEGSolver->add(condNode2SMTExpr(curCond) ^ condNode2SMTExpr(otherCond));
   //  DEBUG_WITH_TYPE("condition",  dbgs() << "Xor SMT String For Merge\n" <<
   //  SEGSolver->to_smt2() << "\n");
   auto checkRet = SEGSolver->check();
@@ -1566,253 +2132,403 @@ bool EnhancedSEGWrapper::isConditionMerge(ConditionNode *curCond,
   return false;
 }
 
+void EnhancedSEGWrapper::intraValueFlow(SEGNodeBase *criterion,
+                                        set<PooledSEGTrace> &intraTraces,
+                                        bool goalDirected) {
+  intraValueFlow(criterion, intraTraces, intraSlicing, goalDirected);
+}
+
 // the resulted intra slicing may be duplicated
 void EnhancedSEGWrapper::intraValueFlow(SEGNodeBase *criterion,
-                                        set<SEGTraceWithBB> &intraTraces) {
-  vector<SEGObject *> curTrace;
-  set<vector<SEGObject *>> forwardTraces, backwardTraces;
+                                        set<PooledSEGTrace> &intraTraces,
+                                        IntraSlicingState &state,
+                                        bool goalDirected) {
+  set<SEGNodeBase *> onTrace;
+
+  // each side is only expanded towards kinds that, together with whatever
+  // the other side may offer, can form an input/output pair
+  IOKindMask backwardContext = IO_MASK_ALL, forwardContext = IO_MASK_ALL;
+  if (goalDirected && GoalDirectedSlicing.getValue()) {
+    backwardContext = getIOReachMask(state, criterion, false);
+    forwardContext = getIOReachMask(state, criterion, true);
+    if (!isIOMaskMatched(backwardContext | forwardContext)) {
+      state.count_pruned_criteria += 1;
+      DEBUG_WITH_TYPE("time", dbgs() << "Pruned criteria: "
+                                     << state.count_pruned_criteria << "\n");
+      return;
+    }
+  }
 
   auto vf_start = chrono::high_resolution_clock::now();
-  intraValueFlowBackward(criterion, curTrace, backwardTraces);
+  auto backwardPaths =
+      intraValueFlowBackward(state, criterion, onTrace, backwardContext);
   auto vf_stop = chrono::high_resolution_clock::now();
   auto vf_duration =
       chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
-  collect_backward_time += vf_duration.count();
+  state.collect_backward_time += vf_duration.count();
 
   vf_start = chrono::high_resolution_clock::now();
-  intraValueFlowForward(criterion, curTrace, forwardTraces);
+  auto forwardPaths =
+      intraValueFlowForward(state, criterion, onTrace, forwardContext);
   vf_stop = chrono::high_resolution_clock::now();
   vf_duration =
       chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
-  collect_forward_time += vf_duration.count();
+  state.collect_forward_time += vf_duration.count();
 
   vf_start = chrono::high_resolution_clock::now();
-  //   dbgs() << "After intra, backward num: " << backwardTraces.size() << " "
-  //   << *criterion << "\n"; dbgs() << "After intra, forward num: " <<
-  //   forwardTraces.size() << " " << *criterion << "\n";
-  for (auto forward : forwardTraces) {
-    for (auto backward : backwardTraces) {
-      reverse(backward.begin(), backward.end());
-      vector<SEGObject *> biward(backward);
-      if (forward.empty()) {
-        continue;
-      }
-      biward.insert(biward.end(), forward.begin() + 1, forward.end());
-      if (biward.empty()) {
-        continue;
-      }
-      if (visitedTraces.count(biward)) {
-        continue;
-      }
-      visitedTraces.insert(biward);
-      vector<BasicBlock *> curbbOnTraces;
-      vector<vector<BasicBlock *>> bbOnTracesPaths;
-      collectRelatedBBs(biward, 0, curbbOnTraces, bbOnTracesPaths);
-      for (auto relatedBBs : bbOnTracesPaths) {
-        SEGTraceWithBB newtrace(biward, relatedBBs);
-        intraTraces.insert(newtrace);
-      }
+  // paths are only materialized here, one concatenated trace at a time
+  auto concatWithForward = [&](const vector<SEGObject *> &forward) {
+    if (forward.empty()) {
+      return true;
     }
+    state.pathDAG.forEachPath(
+        backwardPaths, [&](const vector<SEGObject *> &backward) {
+          vector<SEGObject *> biward(backward.rbegin(), backward.rend());
+          biward.insert(biward.end(), forward.begin() + 1, forward.end());
+          if (biward.empty()) {
+            return true;
+          }
+          auto [handle, inserted] = state.visitedTraces.insert(biward);
+          if (!inserted) {
+            return true;
+          }
+          vector<BasicBlock *> curbbOnTraces;
+          vector<vector<BasicBlock *>> bbOnTracesPaths;
+          collectRelatedBBs(biward, 0, curbbOnTraces, bbOnTracesPaths);
+          for (auto &relatedBBs : bbOnTracesPaths) {
+            intraTraces.emplace(handle, std::move(relatedBBs));
+          }
+          return true;
+        });
+    return true;
+  };
+  if (BidirectionalSlicing.getValue()) {
+    joinIntraPathsAtCriterion(state, backwardPaths, forwardPaths, intraTraces);
+  } else {
+    state.pathDAG.forEachPath(forwardPaths, concatWithForward);
   }
   vf_stop = chrono::high_resolution_clock::now();
   vf_duration =
       chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
-  collect_concat_time += vf_duration.count();
+  state.collect_concat_time += vf_duration.count();
 
   DEBUG_WITH_TYPE("time", dbgs() << "\nTime for forward slicing: "
-                                 << collect_backward_time / 1000 << "ms\n");
+                                 << state.collect_backward_time / 1000
+                                 << "ms\n");
   DEBUG_WITH_TYPE("time", dbgs() << "Time for backward slicing: "
-                                 << collect_forward_time / 1000 << "ms\n");
+                                 << state.collect_forward_time / 1000
+                                 << "ms\n");
   DEBUG_WITH_TYPE("time", dbgs() << "Time for concat slicing: "
-                                 << collect_concat_time / 1000 << "ms\n");
-  DEBUG_WITH_TYPE("time", dbgs() << "Forward trace: " << forwardTraces.size()
-                                 << ", Bacward trace: " << backwardTraces.size()
+                                 << state.collect_concat_time / 1000
+                                 << "ms\n");
+  DEBUG_WITH_TYPE("time", dbgs() << "Forward trace: "
+                                 << state.pathDAG.countPaths(forwardPaths)
+                                 << ", Bacward trace: "
+                                 << state.pathDAG.countPaths(backwardPaths)
+                                 << ", DAG nodes: " << state.pathDAG.size()
                                  << "\n");
 }
 
-void EnhancedSEGWrapper::intraValueFlowBackward(
-    SEGNodeBase *node, vector<SEGObject *> &curTrace,
-    set<vector<SEGObject *>> &backwards) {
-  if (find(curTrace.begin(), curTrace.end(), node) != curTrace.end()) {
-    // cycle def-use
+void EnhancedSEGWrapper::joinIntraPathsAtCriterion(
+    IntraSlicingState &state, PathDAGNode *backwardPaths,
+    PathDAGNode *forwardPaths, set<PooledSEGTrace> &intraTraces) {
+  // sources side: backward paths reversed and cut at each of their inputs,
+  // each half runs from the input it starts at to the criterion; halves are
+  // indexed by the input kinds of that first node
+  set<vector<SEGObject *>> seenHalves;
+  map<IOKindMask, vector<vector<SEGObject *>>> sourceHalves;
+  state.pathDAG.forEachPath(
+      backwardPaths, [&](const vector<SEGObject *> &backward) {
+        for (int i = backward.size() - 1; i >= 0; i--) {
+          auto *node = dyn_cast<SEGNodeBase>(backward[i]);
+          if (!node) {
+            continue;
+          }
+          IOKindMask inputs = getLocalIOMask(state, node) & IO_MASK_INPUTS;
+          if (!inputs) {
+            continue;
+          }
+          vector<SEGObject *> half(backward.rend() - i - 1, backward.rend());
+          if (seenHalves.insert(half).second) {
+            sourceHalves[inputs].push_back(std::move(half));
+          }
+        }
+        return true;
+      });
+  if (sourceHalves.empty()) {
     return;
   }
-  if (backwardIntraVisited.count(node)) {
-    for (auto cachePath : backwardIntraVisited[node]) {
-      count_obtain_backward_cache += 1;
-      vector<SEGObject *> newPath(curTrace);
-      newPath.insert(newPath.end(), cachePath.begin(), cachePath.end());
-      backwards.insert(newPath);
+
+  // sinks side: every forward prefix that stops at a node with an output
+  auto isSink = [&](SEGObject *obj) {
+    auto *node = dyn_cast<SEGNodeBase>(obj);
+    return node && (getLocalIOMask(state, node) & IO_MASK_OUTPUTS);
+  };
+  state.pathDAG.forEachPrefix(
+      forwardPaths, isSink, [&](const vector<SEGObject *> &forward) {
+        IOKindMask outputs =
+            getLocalIOMask(state, (SEGNodeBase *)forward.back()) &
+            IO_MASK_OUTPUTS;
+        for (auto &[inputs, halves] : sourceHalves) {
+          if (!isIOMaskMatched(inputs | outputs)) {
+            continue;
+          }
+          for (auto &sourceHalf : halves) {
+            vector<SEGObject *> subTrace = sourceHalf;
+            subTrace.insert(subTrace.end(), forward.begin() + 1,
+                            forward.end());
+            auto [handle, inserted] = state.visitedTraces.insert(subTrace);
+            if (!inserted) {
+              continue;
+            }
+            vector<BasicBlock *> curbbOnTraces;
+            vector<vector<BasicBlock *>> bbOnTracesPaths;
+            collectRelatedBBs(subTrace, 0, curbbOnTraces, bbOnTracesPaths);
+            for (auto &relatedBBs : bbOnTracesPaths) {
+              intraTraces.emplace(handle, std::move(relatedBBs), 0,
+                                  subTrace.size() - 1);
+            }
+          }
+        }
+        return true;
+      });
+}
+
+void IntraSlicingState::merge(IntraSlicingState &other,
+                              vector<TracePool::Handle> &traceRemap) {
+  backwardVisited.insert(other.backwardVisited.begin(),
+                         other.backwardVisited.end());
+  forwardVisited.insert(other.forwardVisited.begin(),
+                        other.forwardVisited.end());
+  localIOMask.insert(other.localIOMask.begin(), other.localIOMask.end());
+  backwardIOMask.insert(other.backwardIOMask.begin(),
+                        other.backwardIOMask.end());
+  forwardIOMask.insert(other.forwardIOMask.begin(), other.forwardIOMask.end());
+  visitedTraces.merge(other.visitedTraces, &traceRemap);
+
+  collect_concat_time += other.collect_concat_time;
+  collect_forward_time += other.collect_forward_time;
+  collect_backward_time += other.collect_backward_time;
+  count_obtain_backward_cache += other.count_obtain_backward_cache;
+  count_obtain_forward_cache += other.count_obtain_forward_cache;
+  count_pruned_criteria += other.count_pruned_criteria;
+}
+
+void IntraSlicingState::seed(IntraSlicingState &other,
+                             const SymbolicExprGraph *graph) {
+  // path counts are filled in lazily, so they are computed here while the
+  // shared DAG nodes are still touched by one thread only
+  for (auto &[key, paths] : other.backwardVisited) {
+    if (key.first->getParentGraph() == graph) {
+      pathDAG.countPaths(paths);
+      backwardVisited.insert({key, paths});
     }
-    return;
   }
-
-  set<vector<SEGObject *>> localPaths;
-  if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
-    backwards.insert(curTrace);
-    vector<SEGObject *> emptyTrace;
-    localPaths.insert(emptyTrace);
-    backwardIntraVisited[node] = localPaths;
-    return;
+  for (auto &[key, paths] : other.forwardVisited) {
+    if (key.first->getParentGraph() == graph) {
+      pathDAG.countPaths(paths);
+      forwardVisited.insert({key, paths});
+    }
   }
-
-  curTrace.push_back(node);
-  if (node->getNumChildren() == 0) {
-    localPaths.insert({node});
-    backwards.insert(curTrace);
-    backwardIntraVisited[node] = localPaths;
-    curTrace.pop_back();
-    return;
+  for (auto &[node, mask] : other.localIOMask) {
+    if (node->getParentGraph() == graph) {
+      localIOMask.insert({node, mask});
+    }
   }
+  for (auto &[node, mask] : other.backwardIOMask) {
+    if (node->getParentGraph() == graph) {
+      backwardIOMask.insert({node, mask});
+    }
+  }
+  for (auto &[node, mask] : other.forwardIOMask) {
+    if (node->getParentGraph() == graph) {
+      forwardIOMask.insert({node, mask});
+    }
+  }
+}
+
+void EnhancedSEGWrapper::mergeIntraSlicing(
+    unique_ptr<IntraSlicingState> state,
+    vector<TracePool::Handle> &traceRemap) {
+  // the merged entries still point into the DAG of state, but its traces are
+  // copied and no longer needed
+  intraSlicing.merge(*state, traceRemap);
+  state->visitedTraces = TracePool();
+  mergedSlicing.push_back(std::move(state));
+}
 
-  // fix Phi Node
+void EnhancedSEGWrapper::normalizePhiIncomings(SEGPhiNode *phiNode) {
   set<SEGNodeBase *> inComingValNoDup;
-  if (auto *phiNode = dyn_cast<SEGPhiNode>(node)) {
-    for (int i = 0; i < phiNode->size(); i++) {
-      auto cur_incoming = phiNode->getIncomeNode(i)->ValNode;
-      if (inComingValNoDup.count(cur_incoming)) {
-        if (isa<ConstantInt>(cur_incoming->getLLVMDbgValue())) {
-          auto newConstNode = new SEGSimpleOperandNode(
-              cur_incoming,
-              SEGBuilder->getSymbolicExprGraph(
-                  phiNode->getIncomeNode(i)->BB->getParent()),
-              false);
-          for (int j = 0; j < phiNode->getNumChildren(); j++) {
-            if (phiNode->getChild(j) == cur_incoming) {
-              phiNode->Children[j] = newConstNode;
-              break;
-            }
+  for (int i = 0; i < phiNode->size(); i++) {
+    auto cur_incoming = phiNode->getIncomeNode(i)->ValNode;
+    if (inComingValNoDup.count(cur_incoming)) {
+      if (isa<ConstantInt>(cur_incoming->getLLVMDbgValue())) {
+        auto newConstNode = new SEGSimpleOperandNode(
+            cur_incoming,
+            SEGBuilder->getSymbolicExprGraph(
+                phiNode->getIncomeNode(i)->BB->getParent()),
+            false);
+        for (int j = 0; j < phiNode->getNumChildren(); j++) {
+          if (phiNode->getChild(j) == cur_incoming) {
+            phiNode->Children[j] = newConstNode;
+            break;
           }
-          phiNode->getIncomeNode(i)->ValNode = newConstNode;
-          inComingValNoDup.insert(newConstNode);
         }
-      } else {
-        inComingValNoDup.insert(cur_incoming);
+        phiNode->getIncomeNode(i)->ValNode = newConstNode;
+        inComingValNoDup.insert(newConstNode);
       }
+    } else {
+      inComingValNoDup.insert(cur_incoming);
     }
   }
+}
 
-  set<SEGNodeBase *> nodeDup;
-  for (unsigned int i = 0; i < node->getNumChildren(); i++) {
-    auto childNode = node->getChild(i);
-    nodeDup.insert(childNode);
-    // we do not track value flow from const as operand
-    if (isa<SEGOpcodeNode>(node)) {
-      if (childNode->getLLVMDbgValue()) {
-        if (isa<ConstantPointerNull>(childNode->getLLVMDbgValue()) ||
-            isa<ConstantInt>(childNode->getLLVMDbgValue())) {
-          continue;
-        }
-      }
-    }
-    intraValueFlowBackward(childNode, curTrace, backwards);
-    if (backwardIntraVisited.count(childNode)) {
-      for (auto cachePath : backwardIntraVisited[childNode]) {
-        vector<SEGObject *> newPath = {node};
-        newPath.insert(newPath.end(), cachePath.begin(), cachePath.end());
-        localPaths.insert(newPath);
-      }
+void EnhancedSEGWrapper::normalizePhiIncomings(SymbolicExprGraph *SEG) {
+  // collect first, normalizing adds nodes to SEG
+  vector<SEGPhiNode *> phiNodes;
+  for (auto it = SEG->value_node_begin(); it != SEG->value_node_end(); it++) {
+    if (auto *phiNode = dyn_cast<SEGPhiNode>(it->second)) {
+      phiNodes.push_back(phiNode);
     }
   }
-
-  backwardIntraVisited[node] = localPaths;
-  curTrace.pop_back();
+  for (auto phiNode : phiNodes) {
+    normalizePhiIncomings(phiNode);
+  }
 }
 
-void EnhancedSEGWrapper::intraValueFlowForward(
-    SEGNodeBase *node, vector<SEGObject *> &curTrace,
-    set<vector<SEGObject *>> &forwards) {
-
-  if (find(curTrace.begin(), curTrace.end(), node) != curTrace.end()) {
+PathDAGNode *EnhancedSEGWrapper::intraValueFlowBackward(
+    IntraSlicingState &state, SEGNodeBase *node, set<SEGNodeBase *> &onTrace,
+    IOKindMask context) {
+  if (onTrace.count(node)) {
     // cycle def-use
-    return;
+    return nullptr;
+  }
+  if (isIOMaskMatched(context)) {
+    context = IO_MASK_ALL;
+  }
+  auto cacheIt = state.backwardVisited.find({node, context});
+  if (cacheIt != state.backwardVisited.end()) {
+    state.count_obtain_backward_cache += 1;
+    return cacheIt->second;
+  }
+
+  if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
+    return state.backwardVisited[{node, context}] =
+               state.pathDAG.getEmptyPath();
   }
 
-  if (forwardIntraVisited.count(node)) {
-    for (auto cachePath : forwardIntraVisited[node]) {
-      count_obtain_forward_cache += 1;
-      vector<SEGObject *> newPath(curTrace);
-      newPath.insert(newPath.end(), cachePath.begin(), cachePath.end());
-      //      dbgs() << "\nVisit cache at 1547: " << *node << "\n";
-      //      dbgs() << "cache path: \n";
-      //      dumpVector(cachePath);
-      //      dbgs() << "final path: \n";
-      //      dumpVector(newPath);
-      forwards.insert(newPath);
+  // a path is only kept if it can still yield a matched input/output pair
+  IOKindMask curContext = context | getLocalIOMask(state, node);
+  bool canStop = isIOMaskMatched(curContext);
+
+  if (node->getNumChildren() == 0) {
+    return state.backwardVisited[{node, context}] =
+               state.pathDAG.getOrInsert(node, canStop, {});
+  }
+
+  if (auto *phiNode = dyn_cast<SEGPhiNode>(node)) {
+    normalizePhiIncomings(phiNode);
+  }
+
+  vector<SEGNodeBase *> childNodes;
+  // we do not track value flow from const as operand
+  nextIntraNodes(node, true, childNodes);
+
+  onTrace.insert(node);
+  // an excopy child ends the path at current node
+  bool terminal = false;
+  vector<PathDAGNode *> succs;
+  for (auto childNode : childNodes) {
+    if (!canStop &&
+        !isIOMaskMatched(curContext |
+                         getIOReachMask(state, childNode, true))) {
+      continue;
+    }
+    auto childPaths =
+        intraValueFlowBackward(state, childNode, onTrace, curContext);
+    if (!childPaths || childPaths->isDead()) {
+      continue;
+    }
+    if (childPaths->isEmptyPath()) {
+      terminal = canStop;
+    } else {
+      succs.push_back(childPaths);
     }
-    return;
+  }
+  onTrace.erase(node);
+
+  return state.backwardVisited[{node, context}] =
+             state.pathDAG.getOrInsert(node, terminal, succs);
+}
+
+PathDAGNode *EnhancedSEGWrapper::intraValueFlowForward(
+    IntraSlicingState &state, SEGNodeBase *node, set<SEGNodeBase *> &onTrace,
+    IOKindMask context) {
+  if (onTrace.count(node)) {
+    // cycle def-use
+    return nullptr;
+  }
+  if (isIOMaskMatched(context)) {
+    context = IO_MASK_ALL;
+  }
+  auto cacheIt = state.forwardVisited.find({node, context});
+  if (cacheIt != state.forwardVisited.end()) {
+    state.count_obtain_forward_cache += 1;
+    return cacheIt->second;
   }
 
-  set<vector<SEGObject *>> localPaths;
   if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
-    forwards.insert(curTrace);
-    vector<SEGObject *> emptyTrace;
-    localPaths.insert(emptyTrace);
-    forwardIntraVisited[node] = localPaths;
-    //    dbgs() << "\nCache for node at 1557: " << *node << "\n";
-    //    for (auto x : localPaths) {
-    //      dbgs() << "local path: \n";
-    //      dumpVector(x);
-    //    }
-    return;
+    return state.forwardVisited[{node, context}] =
+               state.pathDAG.getEmptyPath();
   }
 
   if (isa<SEGRegionNode>(node)) {
-    forwards.insert(curTrace);
-    vector<SEGObject *> emptyTrace;
-    localPaths.insert(emptyTrace);
-    forwardIntraVisited[node] = localPaths;
-    //    dbgs() << "\nCache for node at 1569: " << *node << "\n";
-    //    for (auto x : localPaths) {
-    //      dbgs() << "local path: \n";
-    //      dumpVector(x);
-    //    }
-    return;
+    return state.forwardVisited[{node, context}] =
+               state.pathDAG.getEmptyPath();
   }
 
-  curTrace.push_back(node);
+  IOKindMask curContext = context | getLocalIOMask(state, node);
+  bool canStop = isIOMaskMatched(curContext);
+
   if (!node->getNumParents()) {
-    localPaths.insert({node});
-    forwards.insert(curTrace);
-    forwardIntraVisited[node] = localPaths;
-    //    dbgs() << "\nCache for node at 1582: " << *node << "\n";
-    //    for (auto x : localPaths) {
-    //      dbgs() << "local path: \n";
-    //      dumpVector(x);
-    //    }
-    curTrace.pop_back();
-    return;
+    return state.forwardVisited[{node, context}] =
+               state.pathDAG.getOrInsert(node, canStop, {});
   }
 
-  set<SEGNodeBase *> nodeDup;
-  for (auto It = node->parent_begin(); It != node->parent_end(); It++) {
-    auto nextNode = (SEGNodeBase *)*It;
-    nodeDup.insert(nextNode);
-  }
+  vector<SEGNodeBase *> parentNodes;
+  nextIntraNodes(node, false, parentNodes);
+  set<SEGNodeBase *> nodeDup(parentNodes.begin(), parentNodes.end());
 
+  onTrace.insert(node);
+  bool terminal = false;
+  vector<PathDAGNode *> succs;
   for (auto nextNode : nodeDup) {
-    intraValueFlowForward(nextNode, curTrace, forwards);
-    if (forwardIntraVisited.count(nextNode)) {
-      for (auto cachePath : forwardIntraVisited[nextNode]) {
-        vector<SEGObject *> newPath = {node};
-        newPath.insert(newPath.end(), cachePath.begin(), cachePath.end());
-        localPaths.insert(newPath);
-      }
+    if (!canStop &&
+        !isIOMaskMatched(curContext |
+                         getIOReachMask(state, nextNode, false))) {
+      continue;
+    }
+    auto nextPaths =
+        intraValueFlowForward(state, nextNode, onTrace, curContext);
+    if (!nextPaths || nextPaths->isDead()) {
+      continue;
+    }
+    if (nextPaths->isEmptyPath()) {
+      terminal = canStop;
+    } else {
+      succs.push_back(nextPaths);
     }
   }
-  forwardIntraVisited[node] = localPaths;
-  //  dbgs() << "\nCache for node at 1607: " << *node << "\n";
-  //  for (auto x : localPaths) {
-  //    dbgs() << "local path: \n";
-  //    dumpVector(x);
-  //  }
-  curTrace.pop_back();
+  onTrace.erase(node);
+
+  return state.forwardVisited[{node, context}] =
+             state.pathDAG.getOrInsert(node, terminal, succs);
 }
 
 // extend intra slicing to inter slicing
 // TODO: check the stop critrion
 void EnhancedSEGWrapper::obtainInterSlicing(
-    EnhancedSEGTrace *intraTrace, set<EnhancedSEGTrace *> &interTraces) {
+    EnhancedSEGTrace *intraTrace, EnhancedTraceSet &interTraces) {
 
   if (intraTrace->trace.trace.empty()) {
     return;
@@ -1829,13 +2545,14 @@ void EnhancedSEGWrapper::obtainInterSlicing(
   auto curFunc = startNode->getParentGraph()->getBaseFunc();
 
   vector<SEGObject *> curTrace;
-  vector<Function *> curCallTrace;
-  set<vector<Function *>> callTraces;
-  funcCallUpperTracer(curFunc, curCallTrace, callTraces);
-
-  if (startNode && needBackward(startNode)) {
-    // collect inter slicing along each call trace
-    for (auto callTrace : callTraces) {
+  bool isBackward = startNode && needBackward(startNode);
+  bool isForward = endNode && needForward(endNode);
+
+  // collect inter slicing along each call trace
+  auto callContexts = callerContexts(curFunc);
+  vector<Function *> callTrace;
+  while ((isBackward || isForward) && callContexts.next(callTrace)) {
+    if (isBackward) {
       auto vf_start = chrono::high_resolution_clock::now();
       interValueFlowBackward(startNode, callTrace, curTrace, backwardTraces);
       auto vf_stop = chrono::high_resolution_clock::now();
@@ -1843,11 +2560,7 @@ void EnhancedSEGWrapper::obtainInterSlicing(
           chrono::duration_cast<std::chrono::microseconds>(vf_stop - vf_start);
       collect_inter_backward_time += vf_duration.count();
     }
-  }
-
-  if (endNode && needForward(endNode)) {
-    // collect inter slicing along each call trace
-    for (auto callTrace : callTraces) {
+    if (isForward) {
       auto vf_start = chrono::high_resolution_clock::now();
       interValueFlowForward(endNode, callTrace, curTrace, forwardTraces);
       auto vf_stop = chrono::high_resolution_clock::now();
@@ -1856,6 +2569,11 @@ void EnhancedSEGWrapper::obtainInterSlicing(
       collect_inter_forward_time += vf_duration.count();
     }
   }
+  if (callContexts.isBudgetHit()) {
+    DEBUG_WITH_TYPE("time", dbgs() << "Call context budget hit after "
+                                   << callContexts.getNumYielded()
+                                   << " contexts\n");
+  }
 
   DEBUG_WITH_TYPE("time", dbgs()
                               << "Time for inter backward slicing: "
@@ -1867,15 +2585,16 @@ void EnhancedSEGWrapper::obtainInterSlicing(
   // transform intra enhanced trace to inter enhanced trace
   set<vector<SEGObject *>> interSEGTraces;
   if (!backwardTraces.empty() && !forwardTraces.empty()) {
-    for (auto &interBackward : backwardTraces) {
-      for (auto interForward : forwardTraces) {
-        vector<SEGObject *> biward = interBackward;
+    auto sortedForwards = sortTraces(forwardTraces);
+    for (auto interBackward : sortTraces(backwardTraces)) {
+      for (auto interForward : sortedForwards) {
+        vector<SEGObject *> biward = *interBackward;
         reverse(biward.begin(), biward.end());
         biward.insert(biward.end(), intraTrace->trace.trace.begin() + 1,
                       intraTrace->trace.trace.end());
 
-        biward.insert(biward.end(), interForward.begin() + 1,
-                      interForward.end());
+        biward.insert(biward.end(), interForward->begin() + 1,
+                      interForward->end());
 
         // recover condition and order information
         set<InputNode *> inputNodes;
@@ -1887,16 +2606,21 @@ void EnhancedSEGWrapper::obtainInterSlicing(
           continue;
         }
 
-        for (auto input : inputNodes) {
-          for (auto output : outputNodes) {
+        map<SEGObject *, int> positions;
+        indexTraceObjects(biward, positions);
+        auto sortedOutputs = sortIONodes(outputNodes);
+        for (auto input : sortIONodes(inputNodes)) {
+          for (auto output : sortedOutputs) {
             if (!input || !output || !ifInOutputMatch(input, output)) {
               continue;
             }
-            int start_idx =
-                find(biward.begin(), biward.end(), input->usedNode) -
-                biward.begin();
-            int end_idx = find(biward.begin(), biward.end(), output->usedNode) -
-                          biward.begin();
+            auto startIt = positions.find(input->usedNode);
+            auto endIt = positions.find(output->usedNode);
+            if (startIt == positions.end() || endIt == positions.end()) {
+              continue;
+            }
+            int start_idx = startIt->second;
+            int end_idx = endIt->second;
             vector<SEGObject *> sub_trace(biward.begin() + start_idx,
                                           biward.begin() + end_idx + 1);
 
@@ -1907,16 +2631,8 @@ void EnhancedSEGWrapper::obtainInterSlicing(
             trace->input_node = input;
             trace->output_node = output;
 
-            bool found_exist = false;
-            for (auto cur_item : interTraces) {
-              if (isTwoEnhancedTraceEq(trace, cur_item)) {
-                found_exist = true;
-                break;
-              }
-            }
-            if (!found_exist) {
-              interTraces.insert(trace);
-            }
+            trace = internTrace(trace);
+            interTraces.insert(trace);
 
             for (auto node : trace->trace.trace) {
               if (!node) {
@@ -1928,8 +2644,8 @@ void EnhancedSEGWrapper::obtainInterSlicing(
       }
     }
   } else if (!backwardTraces.empty()) {
-    for (auto &interBackward : backwardTraces) {
-      vector<SEGObject *> biward = interBackward;
+    for (auto interBackward : sortTraces(backwardTraces)) {
+      vector<SEGObject *> biward = *interBackward;
       reverse(biward.begin(), biward.end());
       biward.insert(biward.end(), intraTrace->trace.trace.begin() + 1,
                     intraTrace->trace.trace.end());
@@ -1942,15 +2658,20 @@ void EnhancedSEGWrapper::obtainInterSlicing(
         continue;
       }
 
-      for (auto input : inputNodes) {
+      map<SEGObject *, int> positions;
+      indexTraceObjects(biward, positions);
+      for (auto input : sortIONodes(inputNodes)) {
         auto output = intraTrace->output_node;
         if (!input || !output || !ifInOutputMatch(input, output)) {
           continue;
         }
-        int start_idx = find(biward.begin(), biward.end(), input->usedNode) -
-                        biward.begin();
-        int end_idx = find(biward.begin(), biward.end(), output->usedNode) -
-                      biward.begin();
+        auto startIt = positions.find(input->usedNode);
+        auto endIt = positions.find(output->usedNode);
+        if (startIt == positions.end() || endIt == positions.end()) {
+          continue;
+        }
+        int start_idx = startIt->second;
+        int end_idx = endIt->second;
         vector<SEGObject *> sub_trace(biward.begin() + start_idx,
                                       biward.begin() + end_idx + 1);
 
@@ -1960,16 +2681,8 @@ void EnhancedSEGWrapper::obtainInterSlicing(
         trace->conditions = intraTrace->conditions;
         trace->input_node = input;
         trace->output_node = output;
-        bool found_exist = false;
-        for (auto cur_item : interTraces) {
-          if (isTwoEnhancedTraceEq(trace, cur_item)) {
-            found_exist = true;
-            break;
-          }
-        }
-        if (!found_exist) {
-          interTraces.insert(trace);
-        }
+        trace = internTrace(trace);
+        interTraces.insert(trace);
         for (auto node : trace->trace.trace) {
           if (!node) {
             outs() << "Find null node in trace!\n";
@@ -1978,24 +2691,30 @@ void EnhancedSEGWrapper::obtainInterSlicing(
       }
     }
   } else if (!forwardTraces.empty()) {
-    for (auto interForward : forwardTraces) {
+    for (auto interForward : sortTraces(forwardTraces)) {
       vector<SEGObject *> biward = intraTrace->trace.trace;
-      biward.insert(biward.end(), interForward.begin() + 1, interForward.end());
+      biward.insert(biward.end(), interForward->begin() + 1,
+                    interForward->end());
 
       set<OutputNode *> outputNodes;
       canFindOutput(biward, outputNodes, false, false);
       if (outputNodes.empty()) {
         continue;
       }
-      for (auto output : outputNodes) {
+      map<SEGObject *, int> positions;
+      indexTraceObjects(biward, positions);
+      for (auto output : sortIONodes(outputNodes)) {
         auto input = intraTrace->input_node;
         if (!input || !output || !ifInOutputMatch(input, output)) {
           continue;
         }
-        int start_idx = find(biward.begin(), biward.end(), input->usedNode) -
-                        biward.begin();
-        int end_idx = find(biward.begin(), biward.end(), output->usedNode) -
-                      biward.begin();
+        auto startIt = positions.find(input->usedNode);
+        auto endIt = positions.find(output->usedNode);
+        if (startIt == positions.end() || endIt == positions.end()) {
+          continue;
+        }
+        int start_idx = startIt->second;
+        int end_idx = endIt->second;
         vector<SEGObject *> sub_trace(biward.begin() + start_idx,
                                       biward.begin() + end_idx + 1);
 
@@ -2005,16 +2724,8 @@ void EnhancedSEGWrapper::obtainInterSlicing(
         trace->conditions = intraTrace->conditions;
         trace->input_node = input;
         trace->output_node = output;
-        bool found_exist = false;
-        for (auto cur_item : interTraces) {
-          if (isTwoEnhancedTraceEq(trace, cur_item)) {
-            found_exist = true;
-            break;
-          }
-        }
-        if (!found_exist) {
-          interTraces.insert(trace);
-        }
+        trace = internTrace(trace);
+        interTraces.insert(trace);
         for (auto node : trace->trace.trace) {
           if (!node) {
             outs() << "Find null node in trace!\n";
@@ -2023,20 +2734,12 @@ void EnhancedSEGWrapper::obtainInterSlicing(
       }
     }
   } else {
-    bool found_exist = false;
-    for (auto cur_item : interTraces) {
-      if (isTwoEnhancedTraceEq(intraTrace, cur_item)) {
-        found_exist = true;
-        break;
-      }
-    }
-    if (!found_exist) {
-      interTraces.insert(intraTrace);
-    }
+    interTraces.insert(intraTrace);
     return;
   }
 }
 
+// stitch the summary of the function of node into the current call chain
 void EnhancedSEGWrapper::interValueFlowBackward(
     SEGNodeBase *node, vector<Function *> &callTrace,
     vector<SEGObject *> &curTrace, set<vector<SEGObject *>> &backwardInters) {
@@ -2053,39 +2756,120 @@ void EnhancedSEGWrapper::interValueFlowBackward(
     return;
   }
 
-  if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
-    backwardInters.insert(curTrace);
+  const auto &summary = getInterFlowSummary(node, true);
+  set<SEGObject *> onTrace(curTrace.begin(), curTrace.end());
+  for (size_t i = 0; i < summary.size(); i++) {
+    auto begin = curTrace.size();
+    auto length = summary.appendSegment(i, curTrace);
+    // cycle def-use across functions
+    if (none_of(curTrace.begin() + begin, curTrace.end(), [&](SEGObject *obj) {
+          return isa<SEGNodeBase>(obj) && onTrace.count(obj);
+        })) {
+      if (summary.crossesBoundary[i]) {
+        crossBackwardBoundary(callTrace, curTrace, backwardInters);
+      } else {
+        backwardInters.insert(curTrace);
+      }
+    }
+    curTrace.resize(curTrace.size() - length);
+  }
+}
+
+void EnhancedSEGWrapper::interValueFlowForward(
+    SEGNodeBase *node, vector<Function *> &callTrace,
+    vector<SEGObject *> &curTrace, set<vector<SEGObject *>> &forwardInters) {
+  if (!node) {
     return;
   }
 
-  curTrace.push_back(node);
-  bool callerCalleeRelated = false;
+  if (!match_def_use_context(curTrace)) {
+    return;
+  }
 
-  // fix Phi Node
-  set<SEGNodeBase *> inComingValNoDup;
-  if (auto *phiNode = dyn_cast<SEGPhiNode>(node)) {
-    for (int i = 0; i < phiNode->size(); i++) {
-      auto cur_incoming = phiNode->getIncomeNode(i)->ValNode;
-      if (inComingValNoDup.count(cur_incoming)) {
-        if (isa<ConstantInt>(cur_incoming->getLLVMDbgValue())) {
-          auto newConstNode = new SEGSimpleOperandNode(
-              cur_incoming,
-              SEGBuilder->getSymbolicExprGraph(
-                  phiNode->getIncomeNode(i)->BB->getParent()),
-              false);
-          for (int j = 0; j < phiNode->getNumChildren(); j++) {
-            if (phiNode->getChild(i) == cur_incoming) {
-              phiNode->Children[i] = newConstNode;
-              break;
-            }
-          }
-          phiNode->getIncomeNode(i)->ValNode = newConstNode;
-          inComingValNoDup.insert(newConstNode);
-        }
+  if (find(curTrace.begin(), curTrace.end(), node) != curTrace.end()) {
+    // cycle def-use
+    return;
+  }
+
+  const auto &summary = getInterFlowSummary(node, false);
+  set<SEGObject *> onTrace(curTrace.begin(), curTrace.end());
+  for (size_t i = 0; i < summary.size(); i++) {
+    auto begin = curTrace.size();
+    auto length = summary.appendSegment(i, curTrace);
+    if (none_of(curTrace.begin() + begin, curTrace.end(), [&](SEGObject *obj) {
+          return isa<SEGNodeBase>(obj) && onTrace.count(obj);
+        })) {
+      if (summary.crossesBoundary[i]) {
+        crossForwardBoundary(callTrace, curTrace, forwardInters);
       } else {
-        inComingValNoDup.insert(cur_incoming);
+        forwardInters.insert(curTrace);
       }
     }
+    curTrace.resize(curTrace.size() - length);
+  }
+}
+
+void InterFlowSummary::addSegment(const vector<SEGObject *> &segment,
+                                  bool crosses) {
+  size_t shared = 0;
+  while (shared < segment.size() && shared < lastPath.size() &&
+         steps[lastPath[shared]].first == segment[shared]) {
+    shared++;
+  }
+  lastPath.resize(shared);
+  for (size_t i = shared; i < segment.size(); i++) {
+    int prev = lastPath.empty() ? -1 : lastPath.back();
+    lastPath.push_back(steps.size());
+    steps.push_back({segment[i], prev});
+  }
+  segmentEnds.push_back(lastPath.empty() ? -1 : lastPath.back());
+  crossesBoundary.push_back(crosses);
+}
+
+size_t InterFlowSummary::appendSegment(size_t i,
+                                       vector<SEGObject *> &trace) const {
+  size_t begin = trace.size();
+  for (int step = segmentEnds[i]; step >= 0; step = steps[step].second) {
+    trace.push_back(steps[step].first);
+  }
+  reverse(trace.begin() + begin, trace.end());
+  return trace.size() - begin;
+}
+
+const InterFlowSummary &
+EnhancedSEGWrapper::getInterFlowSummary(SEGNodeBase *node, bool backward) {
+  auto &summaries = backward ? backwardInterSummaries : forwardInterSummaries;
+  auto it = summaries.find(node);
+  if (it != summaries.end()) {
+    return it->second;
+  }
+  InterFlowSummary summary;
+  vector<SEGObject *> segment;
+  if (backward) {
+    summarizeBackward(node, segment, summary);
+  } else {
+    summarizeForward(node, segment, summary);
+  }
+  return summaries[node] = std::move(summary);
+}
+
+void EnhancedSEGWrapper::summarizeBackward(SEGNodeBase *node,
+                                           vector<SEGObject *> &segment,
+                                           InterFlowSummary &summary) {
+  if (find(segment.begin(), segment.end(), node) != segment.end()) {
+    // cycle def-use
+    return;
+  }
+
+  if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
+    summary.addSegment(segment, false);
+    return;
+  }
+
+  segment.push_back(node);
+
+  if (auto *phiNode = dyn_cast<SEGPhiNode>(node)) {
+    normalizePhiIncomings(phiNode);
   }
 
   set<SEGNodeBase *> nodeDup;
@@ -2114,28 +2898,98 @@ void EnhancedSEGWrapper::interValueFlowBackward(
       }
     }
     if (auto *ret_node = dyn_cast<SEGCommonReturnNode>(node)) {
-      curTrace.push_back(ret_node->getReturnSite(node->getChild(i)));
+      segment.push_back(ret_node->getReturnSite(node->getChild(i)));
     }
     nodeDup.insert(node->getChild(i));
-    interValueFlowBackward(node->getChild(i), callTrace, curTrace,
-                           backwardInters);
+    summarizeBackward(node->getChild(i), segment, summary);
     if (isa<SEGCommonReturnNode>(node)) {
-      curTrace.pop_back();
+      segment.pop_back();
     }
   }
 
   if (node->getNumChildren() == 0 && !needBackward(node)) {
-    backwardInters.insert(curTrace);
-    curTrace.pop_back();
+    summary.addSegment(segment, false);
+  } else if (isa<SEGPseudoArgumentNode>(node) ||
+             isa<SEGCommonArgumentNode>(node) ||
+             isa<SEGCallSiteCommonOutputNode>(node) ||
+             isa<SEGCallSitePseudoOutputNode>(node)) {
+    // if no child, check if we need to go to another caller/callee func
+    summary.addSegment(segment, true);
+  } else if (node->getNumChildren() == 0) {
+    summary.addSegment(segment, false);
+  }
+  segment.pop_back();
+}
+
+void EnhancedSEGWrapper::summarizeForward(SEGNodeBase *node,
+                                          vector<SEGObject *> &segment,
+                                          InterFlowSummary &summary) {
+  // TODO: finish forward inter slicing
+  if (find(segment.begin(), segment.end(), node) != segment.end()) {
+    // cycle def-use
+    return;
+  }
+
+  // todo: if we keep several paths to the same node?
+  if (node->getLLVMDbgValue()) {
+    auto nodeVal = node->getLLVMDbgValue();
+    if (is_excopy_val(nodeVal)) {
+      summary.addSegment(segment, false);
+      return;
+    }
+  }
+  if (isa<SEGRegionNode>(node)) {
+    summary.addSegment(segment, false);
     return;
   }
-  // if no child, check if we need to go to another caller/callee func
+  segment.push_back(node);
+  set<SEGNodeBase *> nodeDup;
+
+  bool has_parent = false;
+  for (auto it = node->parent_begin(); it != node->parent_end(); it++) {
+    auto nextNode = (SEGNodeBase *)*it;
+    if (nodeDup.find(nextNode) != nodeDup.end()) {
+      continue;
+    }
+    has_parent = true;
+    nodeDup.insert(nextNode);
+    if (auto *ret_node = dyn_cast<SEGCommonReturnNode>(nextNode)) {
+      segment.emplace_back(ret_node->getReturnSite(node));
+    }
+    summarizeForward(nextNode, segment, summary);
+    if (isa<SEGCommonReturnNode>(nextNode)) {
+      segment.pop_back();
+    }
+  }
+
+  bool isCommonInput = false;
+  for (auto it = node->use_site_begin(); it != node->use_site_end(); it++) {
+    if (auto *SEGCS = dyn_cast<SEGCallSite>(*it)) {
+      isCommonInput |= SEGCS->isCommonInput(node);
+    }
+  }
+
+  if (!has_parent && !needForward(node)) {
+    summary.addSegment(segment, false);
+  } else if (isa<SEGCommonReturnNode>(node) ||
+             isa<SEGPseudoReturnNode>(node) ||
+             isa<SEGCallSitePseudoInputNode>(node) || isCommonInput) {
+    summary.addSegment(segment, true);
+  } else if (!has_parent) {
+    summary.addSegment(segment, false);
+  }
+  segment.pop_back();
+}
+
+void EnhancedSEGWrapper::crossBackwardBoundary(
+    vector<Function *> &callTrace, vector<SEGObject *> &curTrace,
+    set<vector<SEGObject *>> &backwardInters) {
+  auto *node = (SEGNodeBase *)curTrace.back();
   if (isa<SEGPseudoArgumentNode>(node)) {
     callTrace.pop_back();
     if (callTrace.empty()) {
       backwardInters.insert(curTrace);
       callTrace.push_back(node->getParentGraph()->getBaseFunc());
-      curTrace.pop_back();
       return;
     }
 
@@ -2159,7 +3013,6 @@ void EnhancedSEGWrapper::interValueFlowBackward(
     if (callTrace.empty()) {
       backwardInters.insert(curTrace);
       callTrace.push_back(node->getParentGraph()->getBaseFunc());
-      curTrace.pop_back();
       return;
     }
     auto caller = callTrace.back();
@@ -2182,13 +3035,11 @@ void EnhancedSEGWrapper::interValueFlowBackward(
     auto callee = CSONode->getCallSite()->getCalledFunction();
     if (!callee) {
       backwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
     auto calleeSEG = SEGBuilder->getSymbolicExprGraph(callee);
     if (!calleeSEG) { // APIs
       backwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
     auto commonRet = calleeSEG->getCommonReturn();
@@ -2201,13 +3052,11 @@ void EnhancedSEGWrapper::interValueFlowBackward(
     auto callee = pseudoNode->getCallee();
     if (!callee) {
       backwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
     auto calleeSEG = SEGBuilder->getSymbolicExprGraph(callee);
     if (!calleeSEG) {
       backwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
     size_t index = pseudoNode->getIndex();
@@ -2215,77 +3064,19 @@ void EnhancedSEGWrapper::interValueFlowBackward(
     callTrace.push_back(callee);
     interValueFlowBackward((SEGNodeBase *)pseudoRet, callTrace, curTrace,
                            backwardInters);
-
     callTrace.pop_back();
-  } else if (node->getNumChildren() == 0) {
-    backwardInters.insert(curTrace);
   }
-  curTrace.pop_back();
 }
 
-void EnhancedSEGWrapper::interValueFlowForward(
-    SEGNodeBase *node, vector<Function *> &callTrace,
-    vector<SEGObject *> &curTrace, set<vector<SEGObject *>> &forwardInters) {
-  // TODO: finish forward inter slicing
-  if (!node) {
-    return;
-  }
-
-  if (!match_def_use_context(curTrace)) {
-    return;
-  }
-
-  if (find(curTrace.begin(), curTrace.end(), node) != curTrace.end()) {
-    // cycle def-use
-    return;
-  }
-
-  // todo: if we keep several paths to the same node?
-  if (node->getLLVMDbgValue()) {
-    auto nodeVal = node->getLLVMDbgValue();
-    if (is_excopy_val(nodeVal)) {
-      forwardInters.insert(curTrace);
-      return;
-    }
-  }
-  if (isa<SEGRegionNode>(node)) {
-    forwardInters.insert(curTrace);
-    return;
-  }
-  curTrace.push_back(node);
-  set<SEGNodeBase *> nodeDup;
-
-  bool has_parent = false;
-  for (auto it = node->parent_begin(); it != node->parent_end(); it++) {
-    auto nextNode = (SEGNodeBase *)*it;
-    if (nodeDup.find(nextNode) != nodeDup.end()) {
-      continue;
-    }
-    has_parent = true;
-    nodeDup.insert(nextNode);
-    if (auto *ret_node = dyn_cast<SEGCommonReturnNode>(nextNode)) {
-      curTrace.emplace_back(ret_node->getReturnSite(node));
-    }
-    interValueFlowForward(nextNode, callTrace, curTrace, forwardInters);
-    if (isa<SEGCommonReturnNode>(nextNode)) {
-      curTrace.pop_back();
-    }
-  }
-
-  if (!has_parent && !needForward(node)) {
-    forwardInters.insert(curTrace);
-    curTrace.pop_back();
-    return;
-  }
-
-  bool isCallerCalleeRelated = false;
+void EnhancedSEGWrapper::crossForwardBoundary(
+    vector<Function *> &callTrace, vector<SEGObject *> &curTrace,
+    set<vector<SEGObject *>> &forwardInters) {
+  auto *node = (SEGNodeBase *)curTrace.back();
   if (isa<SEGCommonReturnNode>(node)) {
-    isCallerCalleeRelated = true;
     callTrace.pop_back();
     if (callTrace.empty()) {
       forwardInters.insert(curTrace);
       callTrace.push_back(node->getParentGraph()->getBaseFunc());
-      curTrace.pop_back();
       return;
     }
 
@@ -2302,12 +3093,10 @@ void EnhancedSEGWrapper::interValueFlowForward(
     }
     callTrace.push_back(callee);
   } else if (isa<SEGPseudoReturnNode>(node)) {
-    isCallerCalleeRelated = true;
     callTrace.pop_back();
     if (callTrace.empty()) {
       forwardInters.insert(curTrace);
       callTrace.push_back(node->getParentGraph()->getBaseFunc());
-      curTrace.pop_back();
       return;
     }
 
@@ -2325,18 +3114,15 @@ void EnhancedSEGWrapper::interValueFlowForward(
     }
     callTrace.push_back(callee);
   } else if (isa<SEGCallSitePseudoInputNode>(node)) {
-    isCallerCalleeRelated = true;
     auto *pseudoInput = dyn_cast<SEGCallSitePseudoInputNode>(node);
     auto callee = pseudoInput->getCallee();
     if (!callee) {
       forwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
     auto calleeSEG = SEGBuilder->getSymbolicExprGraph(callee);
     if (!calleeSEG) {
       forwardInters.insert(curTrace);
-      curTrace.pop_back();
       return;
     }
 
@@ -2354,7 +3140,6 @@ void EnhancedSEGWrapper::interValueFlowForward(
     for (auto it = node->use_site_begin(); it != node->use_site_end(); it++) {
       if (auto *SEGCS = dyn_cast<SEGCallSite>(*it)) {
         if (SEGCS->isCommonInput(node)) {
-          isCallerCalleeRelated = true;
           auto callee = SEGCS->getCalledFunction();
           if (!callee) {
             continue;
@@ -2362,7 +3147,6 @@ void EnhancedSEGWrapper::interValueFlowForward(
           auto calleeSEG = SEGBuilder->getSymbolicExprGraph(callee);
           if (!calleeSEG) {
             forwardInters.insert(curTrace);
-            curTrace.pop_back();
             return;
           }
 
@@ -2383,12 +3167,6 @@ void EnhancedSEGWrapper::interValueFlowForward(
       }
     }
   }
-
-  if (!isCallerCalleeRelated && !has_parent) {
-    forwardInters.insert(curTrace);
-  }
-
-  curTrace.pop_back();
 }
 
 void EnhancedSEGWrapper::findCallSite(Function *Caller, Function *Callee,
@@ -2409,43 +3187,11 @@ void EnhancedSEGWrapper::findCallSite(Function *Caller, Function *Callee,
   }
 }
 
-void EnhancedSEGWrapper::funcCallLowerTracer(Function *func,
-                                             vector<Function *> &curTrace,
-                                             set<vector<Function *>> &traces) {
-
-  curTrace.push_back(func);
-
-  if (caller2CalleeMap.find(func) == caller2CalleeMap.end()) {
-    traces.insert(curTrace);
-    curTrace.pop_back();
-    return;
-  }
-
-  for (auto callee : caller2CalleeMap[func]) {
-    funcCallLowerTracer(callee, curTrace, traces);
-  }
-
-  curTrace.pop_back();
-}
-
-void EnhancedSEGWrapper::funcCallUpperTracer(Function *func,
-                                             vector<Function *> &curTrace,
-                                             set<vector<Function *>> &traces) {
-  curTrace.push_back(func);
-
-  if (callee2CallerMap.find(func) == callee2CallerMap.end() ||
-      isIndirectCall(func)) {
-    auto reversedCallTrace = curTrace;
-    reverse(reversedCallTrace.begin(), reversedCallTrace.end());
-    traces.insert(reversedCallTrace);
-    curTrace.pop_back();
-    return;
-  }
-
-  for (auto caller : callee2CallerMap[func]) {
-    funcCallUpperTracer(caller, curTrace, traces);
-  }
-  curTrace.pop_back();
+CallContextIterator EnhancedSEGWrapper::callerContexts(Function *func) {
+  // indirect calls are where the slicing stops going up
+  return CallContextIterator(
+      func, callee2CallerMap, [&](Function *F) { return isIndirectCall(F); },
+      true, CallContextDepth.getValue(), CallContextBudget.getValue());
 }
 
 bool EnhancedSEGWrapper::needBackward(SEGNodeBase *node) {
@@ -2533,61 +3279,8 @@ bool EnhancedSEGWrapper::needForward(SEGNodeBase *node) {
   }
 }
 
-// remove cycle in graph
-void EnhancedSEGWrapper::removeCallGraphCycle(
-    map<Function *, set<Function *>> &graph,
-    map<Function *, set<Function *>> &tree) {
-
-  map<Function *, int> indegree;
-  queue<Function *> q;
-
-  // 初始化入度为0的节点
-  for (auto &[node, neighbors] : graph) {
-    indegree[node] = 0;
-    set<Function *> callees;
-    tree[node] = callees;
-  }
-
-  // 计算每个节点的入度
-  for (auto &[node, neighbors] : graph) {
-    for (auto &neighbor : neighbors) {
-      indegree[neighbor]++;
-    }
-  }
-
-  // 将入度为0的节点加入队列
-  for (auto &[node, degree] : indegree) {
-    if (degree == 0) {
-      q.push(node);
-    }
-  }
-
-  // 拓扑排序
-  while (!q.empty()) {
-    auto node = q.front();
-    q.pop();
-
-    if (graph.find(node) == graph.end()) {
-      continue;
-    }
-    // 将节点加入拓扑排序结果
-    for (auto &neighbor : graph[node]) {
-      tree[node].insert(neighbor);
-      indegree[neighbor]--;
-
-      if (indegree[neighbor] == 0) {
-        q.push(neighbor);
-      }
-    }
-  }
-
-  // 检查是否存在环
-  if (tree.size() != graph.size()) {
-    throw std::runtime_error("Graph contains a cycle");
-  }
-}
 void EnhancedSEGWrapper::computeCallGraph() {
-  map<Function *, set<Function *>> callGraphCycle;
+  map<Function *, set<Function *>> callGraph;
   for (CBCallGraph::const_iterator node_it = CBCG->begin();
        node_it != CBCG->end(); node_it++) {
     auto func = (Function *)node_it->first;
@@ -2596,7 +3289,7 @@ void EnhancedSEGWrapper::computeCallGraph() {
     }
     for (auto callee_it = node_it->second->begin();
          callee_it != node_it->second->end(); callee_it++) {
-      if (!callee_it->first) {
+      if (!callee_it->first || is_excopy_val(callee_it->first)) {
         continue;
       }
 
@@ -2610,15 +3303,19 @@ void EnhancedSEGWrapper::computeCallGraph() {
       if (callee->getName().startswith("asan.")) {
         continue;
       }
-      if (callGraphCycle.find(func) == callGraphCycle.end()) {
+      if (callGraph.find(func) == callGraph.end()) {
         set<Function *> children;
-        callGraphCycle[func] = children;
+        callGraph[func] = children;
       }
-      callGraphCycle[func].insert(callee);
+      callGraph[func].insert(callee);
     }
   }
 
-  removeCallGraphCycle(callGraphCycle, caller2CalleeMap);
+  callGraphSCC.build(callGraph);
+
+  // calls inside an SCC stay, call contexts through a recursion need them
+  // and CallContextIterator never enters a function twice on one chain
+  caller2CalleeMap = callGraph;
 
   for (auto it = caller2CalleeMap.begin(); it != caller2CalleeMap.end(); it++) {
     Function *caller = it->first;
@@ -2631,6 +3328,10 @@ void EnhancedSEGWrapper::computeCallGraph() {
       callee2CallerMap[*subIt].insert(caller);
     }
   }
+
+  callReachability.build(callGraphSCC);
+  DEBUG_WITH_TYPE("time", dbgs() << "Call reachability index over "
+                                 << callReachability.size() << " SCCs\n");
 }
 
 void EnhancedSEGWrapper::computeIndirectCall() {
@@ -2804,70 +3505,28 @@ Function *EnhancedSEGWrapper::getFuncByName(string fileFuncName) {
   return M->getFunction(funcName);
 }
 
-bool compareSEGVector(vector<SEGObject *> vec1, vector<SEGObject *> vec2) {
-  seg_cmp comparator;
-
-  if (vec1.size() == vec2.size()) {
-    for (int i = 0; i < vec1.size(); i++) {
-      if (comparator(vec1[i], vec2[i])) {
-        continue;
-      } else if (comparator(vec2[i], vec1[i])) {
-        return false; // vec2 is less than vec1 at index i
-      }
-    }
-    return true;
-  }
-  return vec1.size() < vec2.size();
-}
-
 // some rare cases that two SEG nodes essentially always carry on the same
 // value, but are different llvm value or different SEG nodes,
 // TODO: I tentatively use seg trace matching to
 bool EnhancedSEGWrapper::isTwoSEGNodeValueEqual(SEGNodeBase *node1,
                                                 SEGNodeBase *node2) {
+  set<SEGNodeBase *> onTrace;
+  auto backwardPaths1 = intraValueFlowBackward(intraSlicing, node1, onTrace);
+  auto backwardPaths2 = intraValueFlowBackward(intraSlicing, node2, onTrace);
 
-  map<Value *, Value *, llvm_cmp> matchedValues;
-
-  vector<SEGObject *> curTrace;
-  set<vector<SEGObject *>> intraTraceNodeVec1Set, intraTraceNodeVec2Set;
-
-  intraValueFlowBackward(node1, curTrace, intraTraceNodeVec1Set);
-  intraValueFlowBackward(node2, curTrace, intraTraceNodeVec2Set);
-
-  if (intraTraceNodeVec1Set.size() != intraTraceNodeVec2Set.size()) {
+  auto &pathDAG = intraSlicing.pathDAG;
+  if (pathDAG.countPaths(backwardPaths1) !=
+      pathDAG.countPaths(backwardPaths2)) {
     return false;
   }
-
-  vector<vector<SEGObject *>> intraTraceNodeVec1(intraTraceNodeVec1Set.begin(),
-                                                 intraTraceNodeVec1Set.end()),
-      intraTraceNodeVec2(intraTraceNodeVec2Set.begin(),
-                         intraTraceNodeVec2Set.end());
-
-  sort(intraTraceNodeVec1.begin(), intraTraceNodeVec1.end(), compareSEGVector);
-  sort(intraTraceNodeVec2.begin(), intraTraceNodeVec2.end(), compareSEGVector);
-
-  for (int i = 0; i < intraTraceNodeVec1.size(); i++) {
-    auto trace1 = intraTraceNodeVec1[i];
-    auto trace2 = intraTraceNodeVec2[i];
-
-    if (trace1.size() != trace2.size()) {
-      return false;
-    }
-
-    for (int j = 0; j < trace1.size(); j++) {
-      auto curNode1 = trace1[j];
-      auto curNode2 = trace2[j];
-
-      if (curNode1 == curNode2) {
-        continue;
-      }
-
-      //      if (!isPatchSEGNodeMatched(node1, node2, matchedValues)) {
-      //        return false;
-      //      }
-    }
+  if (!backwardPaths1 || !backwardPaths2) {
+    return true;
   }
-  return true;
+
+  // sorted traces are compared pairwise by length, which amounts to comparing
+  // the length distributions of both path sets
+  return pathDAG.lengthHistogram(backwardPaths1) ==
+         pathDAG.lengthHistogram(backwardPaths2);
 }
 
 bool EnhancedSEGWrapper::check_reachability_inter(Instruction *src_inst,
@@ -2885,119 +3544,110 @@ bool EnhancedSEGWrapper::check_reachability_inter(Instruction *src_inst,
   if (iter != reachabilityMap.end()) {
     return iter->second;
   }
-  set<pair<Function *, pair<SEGCallSite *, SEGCallSite *>>> func2cs12;
-  find_common_caller(src_func, dst_func, func2cs12);
 
-  // case 3: func1 and func2 have common caller
-  for (auto &item : func2cs12) {
-    auto common_caller = item.first;
-    auto cs_set = item.second;
-    if (common_caller == src_func) {
-      if (CRA->isReachable(src_inst, cs_set.second->getLLVMDbgInstruction())) {
-        reachabilityMap[inst_pair] = true;
-        return true;
-      }
-    } else if (common_caller == dst_func) {
-      if (CRA->isReachable(cs_set.first->getLLVMDbgInstruction(), dst_inst)) {
-        reachabilityMap[inst_pair] = true;
-        return true;
-      }
-    } else {
-      if (CRA->isReachable(cs_set.first->getLLVMDbgInstruction(),
-                           cs_set.second->getLLVMDbgInstruction())) {
-        reachabilityMap[inst_pair] = true;
-        return true;
-      }
+  auto &srcSites = getCallerSites(src_func);
+  auto &dstSites = getCallerSites(dst_func);
+  auto findCallSites =
+      [](const CallerSites &sites,
+         Function *caller) -> const vector<Instruction *> * {
+    auto it = lower_bound(
+        sites.begin(), sites.end(), caller,
+        [](const pair<Function *, vector<Instruction *>> &site,
+           Function *func) { return site.first < func; });
+    if (it == sites.end() || it->first != caller) {
+      return nullptr;
     }
-  }
-  reachabilityMap[inst_pair] = false;
-  return false;
-}
-
-void EnhancedSEGWrapper::find_common_caller(
-    Function *func1, Function *func2,
-    set<pair<Function *, pair<SEGCallSite *, SEGCallSite *>>> &func2cs) {
-
-  CBCallGraphNode *src_fnode = (*CBCG)[func1];
-  CBCallGraphNode *dst_fnode = (*CBCG)[func2];
-
-  if (src_fnode == dst_fnode) {
-    func2cs.insert({func1, make_pair(nullptr, nullptr)});
-    return;
-  }
-
-  auto fpair_iter = commonCaller2CS.find({func1, func2});
-  if (fpair_iter != commonCaller2CS.end()) {
-    func2cs.insert(fpair_iter->second.begin(), fpair_iter->second.end());
-    return;
-  }
+    return &it->second;
+  };
 
-  auto reverse_fpair_iter = commonCaller2CS.find({func2, func1});
-  if (reverse_fpair_iter != commonCaller2CS.end()) {
-    for (auto &pair : reverse_fpair_iter->second) {
-      auto caller = pair.first;
-      auto cs_pair = pair.second;
-      func2cs.insert({caller, {cs_pair.second, cs_pair.first}});
+  bool reachable = false;
+  // case 1: src_func (transitively) invokes dst_func
+  if (auto callSites = findCallSites(dstSites, src_func)) {
+    for (auto callSite : *callSites) {
+      if (CRA->isReachable(src_inst, callSite)) {
+        reachable = true;
+        break;
+      }
     }
-    return;
   }
 
-  DenseMap<CBCallGraphNode *, set<SEGCallSite *>> src_caller2cs;
-  DenseMap<CBCallGraphNode *, set<SEGCallSite *>> dst_caller2cs;
-
-  //  find_all_caller_dfs(src_fnode, history_calltrace, caller2cs_func1);
-  //  find_all_caller_dfs(dst_fnode, history_calltrace, caller2cs_func2);
-
-  find_all_callers_bfs(src_fnode, src_caller2cs);
-  find_all_callers_bfs(dst_fnode, dst_caller2cs);
-
-  // TODO: find least common caller
-  // case 1: func1 (transitively) invokes func2
-  auto dst_iter = dst_caller2cs.find(src_fnode);
-  if (dst_iter != dst_caller2cs.end()) {
-    for (auto &cur_cs : dst_iter->second) {
-      func2cs.insert({func1, make_pair(cur_cs, cur_cs)});
+  // case 2: dst_func (transitively) invokes src_func
+  auto callSites = findCallSites(srcSites, dst_func);
+  if (!reachable && callSites) {
+    for (auto callSite : *callSites) {
+      if (CRA->isReachable(callSite, dst_inst)) {
+        reachable = true;
+        break;
+      }
     }
   }
 
-  // case 2: func2 (transitively) invokes func1
-  auto src_iter = src_caller2cs.find(dst_fnode);
-  if (src_iter != src_caller2cs.end()) {
-    for (auto &cur_cs : src_iter->second) {
-      func2cs.insert({func2, make_pair(cur_cs, cur_cs)});
+  // case 3: src_func and dst_func have common caller
+  auto srcIt = srcSites.begin();
+  auto dstIt = dstSites.begin();
+  while (!reachable && srcIt != srcSites.end() && dstIt != dstSites.end()) {
+    if (srcIt->first < dstIt->first) {
+      srcIt++;
+      continue;
+    }
+    if (dstIt->first < srcIt->first) {
+      dstIt++;
+      continue;
+    }
+    // both reached through the same call sites, which orders neither
+    if (srcIt->second == dstIt->second) {
+      srcIt++;
+      dstIt++;
+      continue;
+    }
+    for (auto srcCallSite : srcIt->second) {
+      for (auto dstCallSite : dstIt->second) {
+        if (srcCallSite != dstCallSite &&
+            CRA->isReachable(srcCallSite, dstCallSite)) {
+          reachable = true;
+          break;
+        }
+      }
+      if (reachable) {
+        break;
+      }
     }
+    srcIt++;
+    dstIt++;
   }
 
-  // case 3: func1 and func2 have common caller
-  vector<CBCallGraphNode *> callers1, callers2;
-  callers1.reserve(src_caller2cs.size());
-  callers2.reserve(dst_caller2cs.size());
-  for (auto &kv : src_caller2cs)
-    callers1.push_back(kv.first);
-  for (auto &kv : dst_caller2cs)
-    callers2.push_back(kv.first);
+  reachabilityMap[inst_pair] = reachable;
+  return reachable;
+}
+
+const EnhancedSEGWrapper::CallerSites &
+EnhancedSEGWrapper::getCallerSites(Function *func) {
+  auto it = func2CallerSites.find(func);
+  if (it != func2CallerSites.end()) {
+    return it->second;
+  }
 
-  // Find intersection of keys
-  vector<CBCallGraphNode *> common_callers;
-  common_callers.reserve(min(callers1.size(), callers2.size()));
-  set_intersection(callers1.begin(), callers1.end(), callers2.begin(),
-                   callers2.end(), back_inserter(common_callers));
+  DenseMap<CBCallGraphNode *, set<SEGCallSite *>> caller2cs;
+  find_all_callers_bfs((*CBCG)[func], caller2cs);
 
-  for (auto &caller : common_callers) {
-    auto common_caller = caller->getFunction();
-    auto cs_set1 = src_caller2cs[caller];
-    auto cs_set2 = dst_caller2cs[caller];
-    if (cs_set1 == cs_set2)
-      continue;
-    for (auto &cs1 : cs_set1) {
-      for (auto &cs2 : cs_set2) {
-        if (cs1 == cs2)
-          continue;
-        func2cs.insert({common_caller, make_pair(cs1, cs2)});
+  auto &sites = func2CallerSites[func];
+  for (auto &[caller, callSites] : caller2cs) {
+    vector<Instruction *> insts;
+    for (auto callSite : callSites) {
+      if (callSite && callSite->getLLVMDbgInstruction()) {
+        insts.push_back(callSite->getLLVMDbgInstruction());
       }
     }
+    if (caller->getFunction() && !insts.empty()) {
+      sites.push_back({caller->getFunction(), insts});
+    }
   }
-  commonCaller2CS[{func1, func2}] = func2cs;
+  sort(sites.begin(), sites.end(),
+       [](const pair<Function *, vector<Instruction *>> &lhs,
+          const pair<Function *, vector<Instruction *>> &rhs) {
+         return lhs.first < rhs.first;
+       });
+  return sites;
 }
 
 void EnhancedSEGWrapper::find_all_callers_bfs(
@@ -3009,20 +3659,17 @@ void EnhancedSEGWrapper::find_all_callers_bfs(
     return;
   }
 
-  auto nodeIter = node2SCCRoot.find(node);
-  if (nodeIter != node2SCCRoot.end()) {
-    auto rootSCC = nodeIter->second;
+  int rootSCC = getRecursiveSCC(node);
+  if (rootSCC >= 0) {
     auto sccIter = SCC2CallerCS.find(rootSCC);
     if (sccIter != SCC2CallerCS.end()) {
       auto &scc_caller2cs = sccIter->second;
       caller2cs.insert(scc_caller2cs.begin(), scc_caller2cs.end());
       func2AllCallsites[node] = caller2cs;
+      return;
     }
-    return;
   }
 
-  Tarjan(node);
-
   set<CBCallGraphNode *> visited;
   queue<CBCallGraphNode *> worklist;
   worklist.push(node);
@@ -3046,9 +3693,8 @@ void EnhancedSEGWrapper::find_all_callers_bfs(
       }
       continue;
     }
-    nodeIter = node2SCCRoot.find(cur_node);
-    if (nodeIter != node2SCCRoot.end()) {
-      auto scc_root = nodeIter->second;
+    int scc_root = getRecursiveSCC(cur_node);
+    if (scc_root >= 0) {
       auto sccIter = SCC2CallerCS.find(scc_root);
       if (sccIter != SCC2CallerCS.end()) {
         auto scc_caller2cs = sccIter->second;
@@ -3077,10 +3723,8 @@ void EnhancedSEGWrapper::find_all_callers_bfs(
   }
   func2AllCallsites[node] = caller2cs;
 
-  nodeIter = node2SCCRoot.find(node);
-  if (nodeIter != node2SCCRoot.end()) {
+  if (rootSCC >= 0) {
     // if inside a scc
-    auto rootSCC = nodeIter->second;
     auto sccIter = SCC2CallerCS.find(rootSCC);
     if (sccIter == SCC2CallerCS.end()) {
       // dbgs() << "Found SCC, store caller2cs: " << caller2cs.size() << "\n");
@@ -3089,58 +3733,16 @@ void EnhancedSEGWrapper::find_all_callers_bfs(
   }
 }
 
-void EnhancedSEGWrapper::Tarjan(CBCallGraphNode *node) {
-
-  if (SCCs.find(node) != SCCs.end() ||
-      node2SCCRoot.find(node) != node2SCCRoot.end())
-    return;
-
-  dfn[node] = low[node] = ++token;
-  tarjanStack.emplace(node);
-  isInStack.emplace(node);
-  for (auto it = node->caller_begin(), ie = node->caller_end(); it != ie;
-       ++it) {
-    Value *value = it->first;
-    CBCallGraphNode *caller = it->second;
-    if (!value || is_excopy_val(value))
-      continue;
-    if (!dfn[caller]) {
-      Tarjan(caller);
-      low[node] = min(low[node], low[caller]);
-    } else if (isInStack.count(caller)) {
-      low[node] = min(low[node], dfn[caller]);
-    }
-  }
-
-  if (low[node] == dfn[node]) {
-    CBCallGraphNode *member;
-    set<CBCallGraphNode *> &sccMembers = SCCs[node];
-    do {
-      member = tarjanStack.top();
-      tarjanStack.pop();
-      isInStack.erase(member);
-      sccMembers.emplace(member);
-    } while (node != member);
-    if (sccMembers.size() == 1) {
-      return;
-    }
-    for (auto &member : sccMembers) {
-      node2SCCRoot[member] = node;
-    }
+int EnhancedSEGWrapper::getRecursiveSCC(CBCallGraphNode *node) {
+  int scc = callGraphSCC.getSCC(node->getFunction());
+  if (scc < 0 || callGraphSCC.getMembers(scc).size() == 1) {
+    return -1;
   }
+  return scc;
 }
 
 void EnhancedSEGWrapper::updateTraceOrder(
-    map<SEGNodeBase *, set<EnhancedSEGTrace *>> &groupedTraces) {
-  auto compare_inst_reach = [this](Instruction *lhs, Instruction *rhs) {
-    if (check_reachability_inter(lhs, rhs)) {
-      return -1;
-    } else if (check_reachability_inter(rhs, lhs)) {
-      return 1;
-    }
-    return 0;
-  };
-
+    map<SEGNodeBase *, EnhancedTraceSet> &groupedTraces) {
   for (auto group : groupedTraces) {
     map<Instruction *, int> store_orders;
     set<Instruction *> instructions;
@@ -3159,66 +3761,64 @@ void EnhancedSEGWrapper::updateTraceOrder(
       continue;
     }
 
+    // query each ordered pair of sites once, reach[i][j] is set if site i
+    // may execute before site j
     vector<Instruction *> instructionVec(instructions.begin(),
                                          instructions.end());
-    map<Instruction *, vector<Instruction *>> graph;
-    for (auto inst1 : instructionVec) {
-      for (auto inst2 : instructionVec) {
-        if (inst1 != inst2) {
-          int result = compare_inst_reach(inst1, inst2);
-          if (result == -1) {
-            graph[inst1].push_back(inst2);
-          } else if (result == 1) {
-            graph[inst2].push_back(inst1);
-          }
+    size_t numInsts = instructionVec.size();
+    vector<BitVector> reach(numInsts, BitVector(numInsts));
+    vector<int> inDegree(numInsts, 0);
+    for (size_t i = 0; i < numInsts; i++) {
+      for (size_t j = 0; j < numInsts; j++) {
+        if (i != j &&
+            check_reachability_inter(instructionVec[i], instructionVec[j])) {
+          reach[i].set(j);
+          inDegree[j]++;
         }
       }
     }
+    auto isOrdered = [&](size_t i, size_t j) {
+      return reach[i].test(j) || reach[j].test(i);
+    };
 
-    map<Instruction *, int> inDegree;
-    queue<Instruction *> zeroInDegree;
-    vector<Instruction *> topOrder;
-
-    for (auto inst1 : instructionVec) {
-      for (auto inst2 : graph[inst1]) {
-        inDegree[inst2]++;
-      }
-    }
-
-    for (auto inst : instructionVec) {
-      if (inDegree[inst] == 0) {
-        zeroInDegree.push(inst);
+    queue<size_t> zeroInDegree;
+    vector<size_t> topOrder;
+    for (size_t i = 0; i < numInsts; i++) {
+      if (inDegree[i] == 0) {
+        zeroInDegree.push(i);
       }
     }
 
     while (!zeroInDegree.empty()) {
-      auto inst = zeroInDegree.front();
+      auto cur = zeroInDegree.front();
       zeroInDegree.pop();
-      topOrder.push_back(inst);
+      topOrder.push_back(cur);
 
-      for (auto v : graph[inst]) {
-        if (--inDegree[v] == 0) {
-          zeroInDegree.push(v);
+      for (int next = reach[cur].find_first(); next != -1;
+           next = reach[cur].find_next(next)) {
+        if (--inDegree[next] == 0) {
+          zeroInDegree.push(next);
         }
       }
     }
 
-    if (topOrder.size() != instructionVec.size()) {
+    if (topOrder.size() != numInsts) {
       errs() << "!!!Loop exist!";
+      // sites on a loop keep their original relative order
+      for (size_t i = 0; i < numInsts; i++) {
+        if (inDegree[i] > 0) {
+          topOrder.push_back(i);
+        }
+      }
     }
 
     int currentPriority = 1;
-    store_orders[topOrder[0]] = 1; // Assign first priority
-    printSourceCodeInfoWithValue(topOrder[0]);
-    DEBUG_WITH_TYPE("statistics", dbgs() << "Order: " << currentPriority
-                                         << ", Site: " << *topOrder[0] << "\n");
-
-    set<Instruction *> curInstInPriors = {topOrder[0]};
-    for (size_t i = 1; i < topOrder.size(); ++i) {
-      // Compare with the previous element
+    vector<size_t> curInstInPriors;
+    for (auto cur : topOrder) {
+      // Compare with the sites of the current priority
       bool need_increase = false;
-      for (auto cur_inst : curInstInPriors) {
-        if (compare_inst_reach(cur_inst, topOrder[i])) {
+      for (auto prior : curInstInPriors) {
+        if (isOrdered(prior, cur)) {
           need_increase = true;
           break;
         }
@@ -3226,21 +3826,14 @@ void EnhancedSEGWrapper::updateTraceOrder(
       if (need_increase) {
         currentPriority++;
         curInstInPriors.clear();
-        curInstInPriors.insert(topOrder[i]);
-      } else {
-        curInstInPriors.insert(topOrder[i]);
       }
+      curInstInPriors.push_back(cur);
 
-      //      if (compare_inst_reach(topOrder[i - 1], topOrder[i]) ||
-      //          compare_inst_reach(topOrder[i], topOrder[i - 1])) {
-      //        // Increment priority if they are not equal
-      //        currentPriority++;
-      //      }
-      store_orders[topOrder[i]] = currentPriority; // Assign priority
-      printSourceCodeInfoWithValue(topOrder[i]);
-      DEBUG_WITH_TYPE("statistics", dbgs()
-                                        << "Order: " << currentPriority
-                                        << ", Site: " << *topOrder[i] << "\n");
+      auto inst = instructionVec[cur];
+      store_orders[inst] = currentPriority; // Assign priority
+      printSourceCodeInfoWithValue(inst);
+      DEBUG_WITH_TYPE("statistics", dbgs() << "Order: " << currentPriority
+                                           << ", Site: " << *inst << "\n");
     }
 
     for (auto trace : group.second) {
@@ -3382,14 +3975,7 @@ bool EnhancedSEGWrapper::isTransitiveCallee(Function *func1, Function *func2) {
   if (func1 == func2) {
     return true;
   }
-  if (caller2CalleeMap.find(func1) == caller2CalleeMap.end()) {
-    return false;
-  }
-  auto callees = caller2CalleeMap[func1];
-  if (callees.find(func2) == callees.end()) {
-    return false;
-  }
-  return true;
+  return callReachability.reaches(func1, func2);
 }
 
 void EnhancedSEGWrapper::findLastIcmp(BasicBlock *bb,
@@ -3455,7 +4041,7 @@ void EnhancedSEGWrapper::findErrorCodeInput(ICmpInst *icmpInst,
   return;
 }
 
-void EnhancedSEGWrapper::canFindOutput(const vector<SEGObject *> trace,
+void EnhancedSEGWrapper::canFindOutput(const vector<SEGObject *> &trace,
                                        set<OutputNode *> &outputNodes,
                                        bool isBenign, bool intra) {
   if (trace.empty()) {
@@ -3530,50 +4116,54 @@ void EnhancedSEGWrapper::canFindOutput(const vector<SEGObject *> trace,
 }
 
 bool EnhancedSEGWrapper::ifInOutputMatch(InputNode *start, OutputNode *end) {
+  return ifInOutputTypeMatch(start->type, end->type);
+}
+
+bool EnhancedSEGWrapper::ifInOutputTypeMatch(InputType start, OutputType end) {
   // todo: refine rules here
-  if (start->type == ErrorCode && end->type == IndirectRet) {
+  if (start == ErrorCode && end == IndirectRet) {
     return true;
   }
-  if (start->type == ArgRetOfAPI && end->type == IndirectRet) {
+  if (start == ArgRetOfAPI && end == IndirectRet) {
     return true;
   }
-  if (start->type == IndirectArg && end->type == CustmoizedAPI) {
+  if (start == IndirectArg && end == CustmoizedAPI) {
     return true;
   }
-  if (start->type == IndirectArg && end->type == SensitiveAPI) {
+  if (start == IndirectArg && end == SensitiveAPI) {
     return true;
   }
-  if (start->type == IndirectArg && end->type == SensitiveOp) {
+  if (start == IndirectArg && end == SensitiveOp) {
     return true;
   }
-  if (start->type == GlobalVarIn && end->type == CustmoizedAPI) {
+  if (start == GlobalVarIn && end == CustmoizedAPI) {
     return true;
   }
-  if (start->type == GlobalVarIn && end->type == SensitiveAPI) {
+  if (start == GlobalVarIn && end == SensitiveAPI) {
     return true;
   }
-  if (start->type == GlobalVarIn && end->type == SensitiveOp) {
+  if (start == GlobalVarIn && end == SensitiveOp) {
     return true;
   }
-  if (start->type == ArgRetOfAPI && end->type == SensitiveOp) {
+  if (start == ArgRetOfAPI && end == SensitiveOp) {
     return true;
   }
-  if (start->type == ArgRetOfAPI && end->type == SensitiveAPI) {
+  if (start == ArgRetOfAPI && end == SensitiveAPI) {
     return true;
   }
-  if (start->type == ArgRetOfAPI && end->type == CustmoizedAPI) {
+  if (start == ArgRetOfAPI && end == CustmoizedAPI) {
     return true;
   }
-  if (start->type == ArgRetOfAPI && end->type == GlobalVarOut) {
+  if (start == ArgRetOfAPI && end == GlobalVarOut) {
     return true;
   }
-  if (start->type == IndirectArg && end->type == GlobalVarOut) {
+  if (start == IndirectArg && end == GlobalVarOut) {
     return true;
   }
-  if (start->type == SensitiveIn && end->type == GlobalVarOut) {
+  if (start == SensitiveIn && end == GlobalVarOut) {
     return true;
   }
-  if (start->type == SensitiveIn && end->type == IndirectRet) {
+  if (start == SensitiveIn && end == IndirectRet) {
     return true;
   }
   return false;
@@ -3627,6 +4217,165 @@ bool EnhancedSEGWrapper::isInputNode(SEGNodeBase *startNode, bool intra) {
   return false;
 }
 
+// IO kinds the node itself may contribute once it is on a trace, an
+// over-approximation of canFindInput and canFindOutput in intra mode
+IOKindMask EnhancedSEGWrapper::getLocalIOMask(IntraSlicingState &state,
+                                              SEGNodeBase *node) {
+  auto cacheIt = state.localIOMask.find(node);
+  if (cacheIt != state.localIOMask.end()) {
+    return cacheIt->second;
+  }
+
+  // SensitiveIn and GlobalVarOut are never found on intra traces today, they
+  // are still seeded so that the mask stays an over-approximation
+  IOKindMask mask = 0;
+  if (isInputNode(node, true)) {
+    mask |= inputKindMask(SensitiveIn);
+    if (isa<SEGArgumentNode>(node) ||
+        (node->getLLVMDbgValue() && isa<Argument>(node->getLLVMDbgValue()))) {
+      mask |= inputKindMask(IndirectArg);
+    } else if (node->getLLVMDbgValue() &&
+               isa<GlobalVariable>(node->getLLVMDbgValue())) {
+      mask |= inputKindMask(GlobalVarIn);
+    } else {
+      mask |= inputKindMask(ArgRetOfAPI);
+    }
+  }
+  if (node->getLLVMDbgValue()) {
+    if (auto *constNum = dyn_cast<ConstantInt>(node->getLLVMDbgValue())) {
+      if (!constNum->isZero()) {
+        mask |= inputKindMask(ErrorCode);
+      }
+    }
+  }
+
+  if (isa<SEGCommonReturnNode>(node)) {
+    mask |= outputKindMask(IndirectRet);
+  }
+  if (node->getLLVMDbgValue() && isa<GlobalVariable>(node->getLLVMDbgValue())) {
+    mask |= outputKindMask(GlobalVarOut);
+  }
+  set<OutputType> sensitiveTypes;
+  obtainSensitiveTypes(node, sensitiveTypes);
+  for (auto type : sensitiveTypes) {
+    mask |= outputKindMask(type);
+  }
+  for (auto it = node->use_site_begin(); it != node->use_site_end(); it++) {
+    if (auto *SEGCS = dyn_cast<SEGCallSite>(*it)) {
+      if (SEGCS->isCommonInput(node) && SEGCS->getCalledFunction() &&
+          node->getLLVMType()->isPointerTy()) {
+        mask |= outputKindMask(CustmoizedAPI);
+      }
+    }
+  }
+  return state.localIOMask[node] = mask;
+}
+
+// successors of the node in intraValueFlowBackward/Forward
+void EnhancedSEGWrapper::nextIntraNodes(SEGNodeBase *node, bool backward,
+                                        vector<SEGNodeBase *> &nextNodes) {
+  if (node->getLLVMDbgValue() && is_excopy_val(node->getLLVMDbgValue())) {
+    return;
+  }
+  if (backward) {
+    for (unsigned int i = 0; i < node->getNumChildren(); i++) {
+      auto childNode = node->getChild(i);
+      if (isa<SEGOpcodeNode>(node) && childNode->getLLVMDbgValue() &&
+          (isa<ConstantPointerNull>(childNode->getLLVMDbgValue()) ||
+           isa<ConstantInt>(childNode->getLLVMDbgValue()))) {
+        continue;
+      }
+      nextNodes.push_back(childNode);
+    }
+  } else {
+    if (isa<SEGRegionNode>(node)) {
+      return;
+    }
+    for (auto It = node->parent_begin(); It != node->parent_end(); It++) {
+      nextNodes.push_back((SEGNodeBase *)*It);
+    }
+  }
+}
+
+// union of the IO kinds over all nodes reachable in the given direction,
+// computed once per SEG node by a worklist fixpoint over the reached region
+IOKindMask EnhancedSEGWrapper::getIOReachMask(IntraSlicingState &state,
+                                              SEGNodeBase *node,
+                                              bool backward) {
+  auto &reachMask = backward ? state.backwardIOMask : state.forwardIOMask;
+  auto cacheIt = reachMask.find(node);
+  if (cacheIt != reachMask.end()) {
+    return cacheIt->second;
+  }
+
+  // collect the region not computed yet, together with its reverse edges
+  map<SEGNodeBase *, vector<SEGNodeBase *>> predecessors;
+  map<SEGNodeBase *, IOKindMask> regionMask;
+  vector<SEGNodeBase *> worklist = {node};
+  regionMask[node] = 0;
+  while (!worklist.empty()) {
+    auto curNode = worklist.back();
+    worklist.pop_back();
+    bool isStop =
+        (curNode->getLLVMDbgValue() &&
+         is_excopy_val(curNode->getLLVMDbgValue())) ||
+        (!backward && isa<SEGRegionNode>(curNode));
+    regionMask[curNode] = isStop ? 0 : getLocalIOMask(state, curNode);
+
+    vector<SEGNodeBase *> nextNodes;
+    nextIntraNodes(curNode, backward, nextNodes);
+    for (auto nextNode : nextNodes) {
+      if (reachMask.count(nextNode)) {
+        regionMask[curNode] |= reachMask[nextNode];
+        continue;
+      }
+      predecessors[nextNode].push_back(curNode);
+      if (!regionMask.count(nextNode)) {
+        regionMask[nextNode] = 0;
+        worklist.push_back(nextNode);
+      }
+    }
+  }
+
+  // propagate kinds against the edges until nothing changes
+  for (auto &item : regionMask) {
+    worklist.push_back(item.first);
+  }
+  while (!worklist.empty()) {
+    auto curNode = worklist.back();
+    worklist.pop_back();
+    for (auto pred : predecessors[curNode]) {
+      IOKindMask merged = regionMask[pred] | regionMask[curNode];
+      if (merged != regionMask[pred]) {
+        regionMask[pred] = merged;
+        worklist.push_back(pred);
+      }
+    }
+  }
+
+  reachMask.insert(regionMask.begin(), regionMask.end());
+  return reachMask[node];
+}
+
+bool EnhancedSEGWrapper::isIOMaskMatched(IOKindMask mask) {
+  if (mask == IO_MASK_ALL) {
+    return true;
+  }
+  for (auto start : {IndirectArg, ArgRetOfAPI, ErrorCode, GlobalVarIn,
+                     SensitiveIn}) {
+    if (!(mask & inputKindMask(start))) {
+      continue;
+    }
+    for (auto end : {IndirectRet, SensitiveAPI, SensitiveOp, CustmoizedAPI,
+                     GlobalVarOut}) {
+      if ((mask & outputKindMask(end)) && ifInOutputTypeMatch(start, end)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 SEGNodeBase *EnhancedSEGWrapper::findFirstNode(vector<SEGObject *> trace) {
   SEGNodeBase *startNode = nullptr;
   for (int i = 0; i < trace.size(); i++) {
@@ -5,8 +5,27 @@
 #include "UtilsHelper.h"
 #include "ValueHelper.h"
 
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+static cl::opt<unsigned> SlicingThreads(
+    "slicing-threads",
+    cl::desc("Number of threads slicing the criteria of distinct SEGs in "
+             "parallel, 1 slices all criteria sequentially."),
+    cl::init(1), cl::Hidden);
+
+static cl::opt<unsigned> FingerprintWords(
+    "condition-fingerprint-words",
+    cl::desc("Number of 64-bit words of branch literal assignments two "
+             "conditions are compared under once their flows are matched; "
+             "equal truth tables over all assignments prove them equivalent "
+             "and skip the solver query, 0 always asks the solver."),
+    cl::init(4), cl::Hidden);
+
 GraphDiffer::GraphDiffer(EnhancedSEGWrapper *pSEGWrapper,
-                         SymbolicExprGraphSolver *pSEGSolver) {
+                         SymbolicExprGraphSolver *pSEGSolver,
+                         PatchContext &ctx)
+    : ctx(ctx) {
   SEGSolver = pSEGSolver;
   SEGWrapper = pSEGWrapper;
   //  computePeerFuncs(peerFile);
@@ -30,9 +49,12 @@ void GraphDiffer::parseValueFlowChanges(set<Value *> &addedValues,
   dbgs() << "[# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "[# Matched SEG Nodes After]: " << matchedNodesAfter.size() << "\n";
-  dbgs() << "[# Matched LLVM Value Before]: " << matchedIRsBefore.size()
+  dbgs() << "[# Matched LLVM Value Before]: " << ctx.matchedIRsBefore.size()
+         << "\n";
+  dbgs() << "[# Matched LLVM Value After]: " << ctx.matchedIRsAfter.size()
+         << "\n";
+  dbgs() << "[# Fingerprint Matched Conditions]: " << fingerprintMatchedNum
          << "\n";
-  dbgs() << "[# Matched LLVM Value After]: " << matchedIRsAfter.size() << "\n";
 }
 
 // give a llvm value, obtain all SEG nodes related to the value (instruction)
@@ -43,7 +65,7 @@ void GraphDiffer::matchABSEGNodes(set<Value *> &addedValues,
   SEGWrapper->value2EnhancedSEGNode(removedValues, removedSEGNodes);
 
   // for matched values, we further match their seg nodes
-  for (auto [value1, value2] : matchedIRsBefore) {
+  for (auto [value1, value2] : ctx.matchedIRsBefore) {
     set<Value *> beforeValue = {value1}, afterValue = {value2};
     set<SEGNodeBase *> beforeNodes, afterNodes;
 
@@ -64,7 +86,7 @@ void GraphDiffer::matchABSEGNodes(set<Value *> &addedValues,
             isCurrentValueSkipMatch(node2->getLLVMDbgValue())) {
           continue;
         }
-        if (!isPatchSEGNodeMatched(node1, node2)) {
+        if (!isPatchSEGNodeMatched(ctx, node1, node2)) {
           continue;
         }
         if (matchedNodesAfter.count(node2) &&
@@ -86,7 +108,7 @@ void GraphDiffer::matchABSEGNodes(set<Value *> &addedValues,
         dbgs() << "\n!!!No matched node before " << *node1 << "\n";
         for (auto node3 : afterNodes) {
           dbgs() << "!!!Check all after node " << *node3 << "\n";
-          dbgs() << isPatchSEGNodeMatched(node1, node3) << "\n";
+          dbgs() << isPatchSEGNodeMatched(ctx, node1, node3) << "\n";
         }
       }
     }
@@ -104,7 +126,7 @@ void GraphDiffer::matchABSEGNodes(set<Value *> &addedValues,
       //        << "\n";
       // for (auto node3 : beforeNodes) {
       //   dbgs() << "!!!Check all before node " << *node3 << " "
-      //          << isPatchSEGNodeMatched(node2, node3)
+      //          << isPatchSEGNodeMatched(ctx, node2, node3)
       //          << "\n";
       // }
     }
@@ -116,25 +138,27 @@ void GraphDiffer::matchABSEGNodes(set<Value *> &addedValues,
   dbgs() << "[# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "[# Matched SEG Nodes After]: " << matchedNodesAfter.size() << "\n";
-  dbgs() << "[# Matched LLVM Value Before]: " << matchedIRsBefore.size()
+  dbgs() << "[# Matched LLVM Value Before]: " << ctx.matchedIRsBefore.size()
+         << "\n";
+  dbgs() << "[# Matched LLVM Value After]: " << ctx.matchedIRsAfter.size()
          << "\n";
-  dbgs() << "[# Matched LLVM Value After]: " << matchedIRsAfter.size() << "\n";
 }
 
 void GraphDiffer::obtainIntraSlicingStage1(
-    set<SEGTraceWithBB> &intraSEGTracesBefore,
-    set<SEGTraceWithBB> &intraSEGTracesAfter) {
+    set<PooledSEGTrace> &intraSEGTracesBefore,
+    set<PooledSEGTrace> &intraSEGTracesAfter) {
 
+  vector<pair<SEGNodeBase *, bool>> criteria;
   for (auto addNode : addedSEGNodes) {
     processedAfterNodes.insert(addNode);
     afterGraphs.insert(addNode->getParentGraph());
-    SEGWrapper->intraValueFlow(addNode, intraSEGTracesAfter);
+    criteria.push_back({addNode, true});
   }
 
   for (auto removedNode : removedSEGNodes) {
     processedBeforeNodes.insert(removedNode);
     beforeGraphs.insert(removedNode->getParentGraph());
-    SEGWrapper->intraValueFlow(removedNode, intraSEGTracesBefore);
+    criteria.push_back({removedNode, false});
   }
 
   for (auto [beforeNode, afterNode] : matchedNodesBefore) {
@@ -146,20 +170,24 @@ void GraphDiffer::obtainIntraSlicingStage1(
             "after.patch.")) {
       continue;
     }
-    if (!changedFuncs.count(beforeNode->getParentFunction())) {
+    if (!ctx.changedFuncs.count(beforeNode->getParentFunction())) {
       continue;
     }
 
-    if (!changedFuncs.count(afterNode->getParentFunction())) {
+    if (!ctx.changedFuncs.count(afterNode->getParentFunction())) {
       continue;
     }
     beforeGraphs.insert(beforeNode->getParentGraph());
     afterGraphs.insert(afterNode->getParentGraph());
     processedBeforeNodes.insert((SEGNodeBase *)beforeNode);
     processedAfterNodes.insert((SEGNodeBase *)afterNode);
-    SEGWrapper->intraValueFlow((SEGNodeBase *)afterNode, intraSEGTracesAfter);
-    SEGWrapper->intraValueFlow((SEGNodeBase *)beforeNode, intraSEGTracesBefore);
+    criteria.push_back({(SEGNodeBase *)afterNode, true});
+    criteria.push_back({(SEGNodeBase *)beforeNode, false});
   }
+  // every node on these traces becomes a stage-2 criterion, so none of them
+  // may be pruned
+  sliceIntraCriteria(criteria, intraSEGTracesBefore, intraSEGTracesAfter,
+                     false);
 
   dbgs() << "\n=======2.2 [Obtain Intra SEG Slicing]========\n";
   dbgs() << "2.2 [# Before SEG Traces Stage 1]: " << intraSEGTracesBefore.size()
@@ -167,18 +195,83 @@ void GraphDiffer::obtainIntraSlicingStage1(
   dbgs() << "2.2 [# After  SEG Traces Stage 1]: " << intraSEGTracesAfter.size()
          << "\n";
   dbgs() << "2.2 [# Backward Visited Stage 1]: "
-         << SEGWrapper->backwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.backwardVisited.size() << "\n";
   dbgs() << "2.2 [# Forward  Visited Stage 1]: "
-         << SEGWrapper->forwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.forwardVisited.size() << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes After]: " << matchedNodesAfter.size()
          << "\n";
 }
 
+void GraphDiffer::sliceIntraCriteria(
+    const vector<pair<SEGNodeBase *, bool>> &criteria,
+    set<PooledSEGTrace> &intraSEGTracesBefore,
+    set<PooledSEGTrace> &intraSEGTracesAfter, bool finalStage) {
+  if (SlicingThreads.getValue() <= 1) {
+    for (auto [criterion, isAfter] : criteria) {
+      SEGWrapper->intraValueFlow(
+          criterion, isAfter ? intraSEGTracesAfter : intraSEGTracesBefore,
+          finalStage);
+    }
+    return;
+  }
+
+  // slicing never leaves the SEG of its criterion, so tasks of distinct SEGs
+  // share nothing, while each task still slices in the sequential order. A
+  // SEG must belong to a single task, as slicing reads its phi nodes.
+  struct SlicingTask {
+    vector<pair<SEGNodeBase *, bool>> criteria;
+    set<PooledSEGTrace> tracesBefore;
+    set<PooledSEGTrace> tracesAfter;
+    unique_ptr<IntraSlicingState> state;
+  };
+  vector<SlicingTask> tasks;
+  map<const SymbolicExprGraph *, int> graph2Task;
+  for (auto criterion : criteria) {
+    auto graph = criterion.first->getParentGraph();
+    if (!graph2Task.count(graph)) {
+      graph2Task[graph] = tasks.size();
+      tasks.emplace_back();
+      tasks.back().state.reset(new IntraSlicingState(++numSlicingTasks));
+      tasks.back().state->seed(SEGWrapper->intraSlicing, graph);
+      // the only write slicing does to a SEG, done before going parallel
+      SEGWrapper->normalizePhiIncomings(
+          const_cast<SymbolicExprGraph *>(graph));
+    }
+    tasks[graph2Task[graph]].criteria.push_back(criterion);
+  }
+
+  tbb::task_arena arena(SlicingThreads.getValue());
+  arena.execute([&] {
+    tbb::parallel_for(size_t(0), tasks.size(), [&](size_t i) {
+      auto &task = tasks[i];
+      for (auto [criterion, isAfter] : task.criteria) {
+        SEGWrapper->intraValueFlow(
+            criterion, isAfter ? task.tracesAfter : task.tracesBefore,
+            *task.state, finalStage);
+      }
+    });
+  });
+
+  // merge in task order, so the result does not depend on the scheduling
+  for (auto &task : tasks) {
+    vector<TracePool::Handle> traceRemap;
+    SEGWrapper->mergeIntraSlicing(std::move(task.state), traceRemap);
+    for (auto &trace : task.tracesBefore) {
+      intraSEGTracesBefore.emplace(traceRemap[trace.handle], trace.bbs,
+                                   trace.startIdx, trace.endIdx);
+    }
+    for (auto &trace : task.tracesAfter) {
+      intraSEGTracesAfter.emplace(traceRemap[trace.handle], trace.bbs,
+                                  trace.startIdx, trace.endIdx);
+    }
+  }
+}
+
 void GraphDiffer::obtainIntraSlicingStage2(
-    set<SEGTraceWithBB> &intraSEGTracesBefore,
-    set<SEGTraceWithBB> &intraSEGTracesAfter) {
+    set<PooledSEGTrace> &intraSEGTracesBefore,
+    set<PooledSEGTrace> &intraSEGTracesAfter) {
   //    for (auto before_SEG : beforeGraphs) {
   //      for (auto it = before_SEG->non_value_node_begin();
   //           it != before_SEG->non_value_node_end(); it++) {
@@ -245,8 +338,9 @@ void GraphDiffer::obtainIntraSlicingStage2(
 
   set<SEGNodeBase *> beforeNeedComputed, afterNeedComputed;
 
-  for (auto trace : intraSEGTracesBefore) {
-    for (auto node : trace.trace) {
+  auto &visitedTraces = SEGWrapper->intraSlicing.visitedTraces;
+  for (auto &trace : intraSEGTracesBefore) {
+    for (auto node : visitedTraces.get(trace.handle)) {
       if (isa<SEGOpcodeNode>(node)) {
         continue;
       }
@@ -268,8 +362,8 @@ void GraphDiffer::obtainIntraSlicingStage2(
     }
   }
 
-  for (auto trace : intraSEGTracesAfter) {
-    for (auto node : trace.trace) {
+  for (auto &trace : intraSEGTracesAfter) {
+    for (auto node : visitedTraces.get(trace.handle)) {
       if (isa<SEGOpcodeNode>(node)) {
         continue;
       }
@@ -291,12 +385,15 @@ void GraphDiffer::obtainIntraSlicingStage2(
     }
   }
 
+  vector<pair<SEGNodeBase *, bool>> criteria;
   for (auto node : beforeNeedComputed) {
-    SEGWrapper->intraValueFlow(node, intraSEGTracesBefore);
+    criteria.push_back({node, false});
   }
   for (auto node : afterNeedComputed) {
-    SEGWrapper->intraValueFlow(node, intraSEGTracesAfter);
+    criteria.push_back({node, true});
   }
+  sliceIntraCriteria(criteria, intraSEGTracesBefore, intraSEGTracesAfter,
+                     true);
 
   //    for (auto trace1 : tmpBeforeIntraTrace) {
   //      dbgs() << "2.2 [# Before SEG Traces Stage 2]" << "\n";
@@ -314,9 +411,9 @@ void GraphDiffer::obtainIntraSlicingStage2(
   dbgs() << "2.2 [# After  SEG Traces Stage 2]: " << intraSEGTracesAfter.size()
          << "\n";
   dbgs() << "2.2 [# Backward Visited Stage 2]: "
-         << SEGWrapper->backwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.backwardVisited.size() << "\n";
   dbgs() << "2.2 [# Forward  Visited Stage 2]: "
-         << SEGWrapper->forwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.forwardVisited.size() << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes After]: " << matchedNodesAfter.size()
@@ -324,10 +421,10 @@ void GraphDiffer::obtainIntraSlicingStage2(
 }
 
 void GraphDiffer::obtainIntraSlicingStage3(
-    set<SEGTraceWithBB> &intraSEGTracesBefore,
-    set<SEGTraceWithBB> &intraSEGTracesAfter) {
-  set<EnhancedSEGTrace *> tmpBeforeIntraTrace;
-  set<EnhancedSEGTrace *> tmpAfterIntraTrace;
+    set<PooledSEGTrace> &intraSEGTracesBefore,
+    set<PooledSEGTrace> &intraSEGTracesAfter) {
+  EnhancedTraceSet tmpBeforeIntraTrace;
+  EnhancedTraceSet tmpAfterIntraTrace;
 
   SEGWrapper->obtainIntraEnhancedSlicing(intraSEGTracesBefore,
                                          tmpBeforeIntraTrace);
@@ -339,15 +436,15 @@ void GraphDiffer::obtainIntraSlicingStage3(
   dbgs() << "2.2 [# After  SEG Traces Stage 3]: " << tmpAfterIntraTrace.size()
          << "\n";
   dbgs() << "2.2 [# Backward Visited Stage 3]: "
-         << SEGWrapper->backwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.backwardVisited.size() << "\n";
   dbgs() << "2.2 [# Forward  Visited Stage 3]: "
-         << SEGWrapper->forwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.forwardVisited.size() << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes After]: " << matchedNodesAfter.size()
          << "\n";
 
-  set<EnhancedSEGTrace *> toBeRemoved;
+  EnhancedTraceSet toBeRemoved;
 
   for (auto it1 = tmpBeforeIntraTrace.begin(); it1 != tmpBeforeIntraTrace.end();
        it1++) {
@@ -375,20 +472,12 @@ void GraphDiffer::obtainIntraSlicingStage3(
     }
   }
 
+  // equal traces are interned into one, so the set removes duplicates
   for (auto item : tmpBeforeIntraTrace) {
     if (toBeRemoved.count(item)) {
       continue;
     }
-    bool found_exist = false;
-    for (auto cur_item : beforeIntraTraces) {
-      if (SEGWrapper->isTwoEnhancedTraceEq(item, cur_item)) {
-        found_exist = true;
-        break;
-      }
-    }
-    if (!found_exist) {
-      beforeIntraTraces.insert(item);
-    }
+    beforeIntraTraces.insert(item);
   }
 
   toBeRemoved.clear();
@@ -418,20 +507,12 @@ void GraphDiffer::obtainIntraSlicingStage3(
     }
   }
 
+  // equal traces are interned into one, so the set removes duplicates
   for (auto item : tmpAfterIntraTrace) {
     if (toBeRemoved.count(item)) {
       continue;
     }
-    bool found_exist = false;
-    for (auto cur_item : afterIntraTraces) {
-      if (SEGWrapper->isTwoEnhancedTraceEq(item, cur_item)) {
-        found_exist = true;
-        break;
-      }
-    }
-    if (!found_exist) {
-      afterIntraTraces.insert(item);
-    }
+    afterIntraTraces.insert(item);
   }
 
   //    for (auto trace1 : beforeIntraTraces) {
@@ -449,9 +530,9 @@ void GraphDiffer::obtainIntraSlicingStage3(
   dbgs() << "2.2 [# After  SEG Traces Stage 4]: " << afterIntraTraces.size()
          << "\n";
   dbgs() << "2.2 [# Backward Visited Stage 4]: "
-         << SEGWrapper->backwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.backwardVisited.size() << "\n";
   dbgs() << "2.2 [# Forward  Visited Stage 4]: "
-         << SEGWrapper->forwardIntraVisited.size() << "\n";
+         << SEGWrapper->intraSlicing.forwardVisited.size() << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "2.2 [# Matched SEG Nodes After]: " << matchedNodesAfter.size()
@@ -469,8 +550,8 @@ void GraphDiffer::obtainIntraSlicingStage3(
 }
 
 void GraphDiffer::obtainIntraSlicing() {
-  set<SEGTraceWithBB> intraSEGTracesBefore;
-  set<SEGTraceWithBB> intraSEGTracesAfter;
+  set<PooledSEGTrace> intraSEGTracesBefore;
+  set<PooledSEGTrace> intraSEGTracesAfter;
 
   obtainIntraSlicingStage1(intraSEGTracesBefore, intraSEGTracesAfter);
   obtainIntraSlicingStage2(intraSEGTracesBefore, intraSEGTracesAfter);
@@ -481,13 +562,14 @@ void GraphDiffer::obtainIntraSlicing() {
   dbgs() << "[# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "[# Matched SEG Nodes After]: " << matchedNodesAfter.size() << "\n";
-  dbgs() << "[# Matched LLVM Value Before]: " << matchedIRsBefore.size()
+  dbgs() << "[# Matched LLVM Value Before]: " << ctx.matchedIRsBefore.size()
+         << "\n";
+  dbgs() << "[# Matched LLVM Value After]: " << ctx.matchedIRsAfter.size()
          << "\n";
-  dbgs() << "[# Matched LLVM Value After]: " << matchedIRsAfter.size() << "\n";
 
   // update order based on CFG reachability
-  map<SEGNodeBase *, set<EnhancedSEGTrace *>> groupedAddedTraces;
-  map<SEGNodeBase *, set<EnhancedSEGTrace *>> groupedRemovedTraces;
+  map<SEGNodeBase *, EnhancedTraceSet> groupedAddedTraces;
+  map<SEGNodeBase *, EnhancedTraceSet> groupedRemovedTraces;
   for (const auto &trace : afterIntraTraces) {
     groupedAddedTraces[trace->input_node->usedNode].insert(trace);
   }
@@ -499,7 +581,7 @@ void GraphDiffer::obtainIntraSlicing() {
   SEGWrapper->updateTraceOrder(groupedRemovedTraces);
 
   for (auto [node1, node2] : matchedNodesBefore) {
-    if (changedFuncs.count(node1->getParentGraph()->getBaseFunc())) {
+    if (ctx.changedFuncs.count(node1->getParentGraph()->getBaseFunc())) {
       DEBUG_WITH_TYPE("statistics", dbgs() << "2.2 Matched Nodes Before\n"
                                            << *node1 << "\n"
                                            << *node2 << "\n");
@@ -510,18 +592,31 @@ void GraphDiffer::obtainIntraSlicing() {
 // if all intra enhanced slicing matched, then they are matchedNodes
 void GraphDiffer::diffABIntraTraces() {
 
-  auto tmp1 = matchedIRsBefore;
+  auto tmp1 = ctx.matchedIRsBefore;
 
   auto tmp3 = matchedNodesBefore;
 
   dbgs() << "\n=======2.3 [Diff Intra SEG Traces]========\n";
 
-  map<EnhancedSEGTrace *, EnhancedSEGTrace *> condMatchTrace;
-  map<EnhancedSEGTrace *, EnhancedSEGTrace *> orderMatchTrace;
+  EnhancedTraceMap condMatchTrace;
+  EnhancedTraceMap orderMatchTrace;
+
+  // only traces with the same fingerprint can match
+  auto afterGroups = groupByFingerprint(afterIntraTraces);
+  size_t comparedPairs = 0;
+  for (auto trace1 : beforeIntraTraces) {
+    auto it = afterGroups.find(traceFingerprint(trace1));
+    if (it != afterGroups.end()) {
+      comparedPairs += it->second.size();
+    }
+  }
+  dbgs() << "2.3 [# Fingerprint Buckets]: " << afterGroups.size() << "\n";
+  dbgs() << "2.3 [# Trace Pairs Compared]: " << comparedPairs << " of "
+         << beforeIntraTraces.size() * afterIntraTraces.size() << "\n";
 
   for (auto trace1 : beforeIntraTraces) {
-    set<EnhancedSEGTrace *> matchedForTrace1;
-    for (auto trace2 : afterIntraTraces) {
+    EnhancedTraceSet matchedForTrace1;
+    for (auto trace2 : afterGroups[traceFingerprint(trace1)]) {
       if (!isTwoEnhancedTraceMatch(trace1, trace2)) {
         continue;
       }
@@ -538,7 +633,7 @@ void GraphDiffer::diffABIntraTraces() {
   }
 
   for (auto trace1 : beforeIntraTraces) {
-    for (auto trace2 : afterIntraTraces) {
+    for (auto trace2 : afterGroups[traceFingerprint(trace1)]) {
       if (unchangedIntraTraces.count(trace2)) {
         continue;
       }
@@ -585,7 +680,7 @@ void GraphDiffer::diffABIntraTraces() {
     }
     bool find_match = false;
     removedIntraTraces.insert(trace1);
-    for (auto trace2 : afterIntraTraces) {
+    for (auto trace2 : afterGroups[traceFingerprint(trace1)]) {
       if (unchangedIntraTraces.count(trace2)) {
         continue;
       }
@@ -708,9 +803,9 @@ void GraphDiffer::diffABIntraTraces() {
   //    "\n");
   //  }
 
-  for (auto [beforeIR, afterIR] : matchedIRsBefore) {
+  for (auto [beforeIR, afterIR] : ctx.matchedIRsBefore) {
     if (auto *bb = dyn_cast<BasicBlock>(beforeIR)) {
-      //      if (!changedFuncs.count(bb->getParent())) {
+      //      if (!ctx.changedFuncs.count(bb->getParent())) {
       //        continue;
       //      }
       DEBUG_WITH_TYPE("statistics", dbgs() << "2.3 Matched BB Before\n"
@@ -718,7 +813,7 @@ void GraphDiffer::diffABIntraTraces() {
                                            << *afterIR << "\n");
 
     } else if (auto *inst = dyn_cast<Instruction>(beforeIR)) {
-      //      if (!changedFuncs.count(inst->getParent()->getParent())) {
+      //      if (!ctx.changedFuncs.count(inst->getParent()->getParent())) {
       //        continue;
       //      }
       DEBUG_WITH_TYPE("statistics", dbgs() << "2.3 Matched IR Before\n"
@@ -774,9 +869,10 @@ void GraphDiffer::diffABIntraTraces() {
   dbgs() << "\n[# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "[# Matched SEG Nodes After]: " << matchedNodesAfter.size() << "\n";
-  dbgs() << "[# Matched LLVM Value Before]: " << matchedIRsBefore.size()
+  dbgs() << "[# Matched LLVM Value Before]: " << ctx.matchedIRsBefore.size()
+         << "\n";
+  dbgs() << "[# Matched LLVM Value After]: " << ctx.matchedIRsAfter.size()
          << "\n";
-  dbgs() << "[# Matched LLVM Value After]: " << matchedIRsAfter.size() << "\n";
 
   for (auto trace : addedIntraTraces) {
     if (orderMatchTrace.count(trace)) {
@@ -816,7 +912,7 @@ void GraphDiffer::diffABIntraTraces() {
 
 void GraphDiffer::intra2InterTraces() {
   // only extend changed intra seg traces to inter
-  set<EnhancedSEGTrace *> addedTmpTraces, removedTmpTraces;
+  EnhancedTraceSet addedTmpTraces, removedTmpTraces;
 
   // extend to Inter (_, S+)
   for (auto trace : addedIntraTraces) {
@@ -826,8 +922,8 @@ void GraphDiffer::intra2InterTraces() {
   for (auto trace : removedIntraTraces) {
     SEGWrapper->obtainInterSlicing(trace, removedTmpTraces);
   }
-  map<SEGNodeBase *, set<EnhancedSEGTrace *>> groupedAddedTraces;
-  map<SEGNodeBase *, set<EnhancedSEGTrace *>> groupedRemovedTraces;
+  map<SEGNodeBase *, EnhancedTraceSet> groupedAddedTraces;
+  map<SEGNodeBase *, EnhancedTraceSet> groupedRemovedTraces;
   for (const auto &trace : addedTmpTraces) {
     groupedAddedTraces[trace->input_node->usedNode].insert(trace);
   }
@@ -844,7 +940,7 @@ void GraphDiffer::intra2InterTraces() {
   SEGWrapper->updateTraceOrder(groupedRemovedTraces);
 
   for (auto [node1, node2] : matchedNodesBefore) {
-    if (changedFuncs.count(node1->getParentGraph()->getBaseFunc())) {
+    if (ctx.changedFuncs.count(node1->getParentGraph()->getBaseFunc())) {
       DEBUG_WITH_TYPE("statistics", dbgs() << "2.4 Matched Nodes Before\n"
                                            << *node1 << "\n"
                                            << *node2 << "\n");
@@ -857,15 +953,18 @@ void GraphDiffer::intra2InterTraces() {
 
 // four result: added, removed, changed, unchanged
 void GraphDiffer::classifyInterEnhancedTraces(
-    set<EnhancedSEGTrace *> &beforeInterTraces,
-    set<EnhancedSEGTrace *> &afterInterTraces) {
+    EnhancedTraceSet &beforeInterTraces,
+    EnhancedTraceSet &afterInterTraces) {
   DEBUG_WITH_TYPE(
       "statistics",
       dbgs() << "\n=======2.4 [Extend Intra to Inter Slicings]========\n");
 
+  // only traces with the same fingerprint can match
+  auto afterGroups = groupByFingerprint(afterInterTraces);
+
   for (auto beforeTrace : beforeInterTraces) {
     bool find_match = false;
-    for (auto afterTrace : afterInterTraces) {
+    for (auto afterTrace : afterGroups[traceFingerprint(beforeTrace)]) {
       if (!isTwoSEGTraceMatched(beforeTrace->trace, afterTrace->trace)) {
         continue;
       }
@@ -954,9 +1053,34 @@ void GraphDiffer::classifyInterEnhancedTraces(
   dbgs() << "\n[# Matched SEG Nodes Before]: " << matchedNodesBefore.size()
          << "\n";
   dbgs() << "[# Matched SEG Nodes After]: " << matchedNodesAfter.size() << "\n";
-  dbgs() << "[# Matched LLVM Value Before]: " << matchedIRsBefore.size()
+  dbgs() << "[# Matched LLVM Value Before]: " << ctx.matchedIRsBefore.size()
+         << "\n";
+  dbgs() << "[# Matched LLVM Value After]: " << ctx.matchedIRsAfter.size()
+         << "\n";
+  dbgs() << "[# Fingerprint Matched Conditions]: " << fingerprintMatchedNum
          << "\n";
-  dbgs() << "[# Matched LLVM Value After]: " << matchedIRsAfter.size() << "\n";
+}
+
+// isTwoSEGTraceMatched aligns traces with or without their phi nodes and
+// learns matched nodes while comparing, so neither the nodes nor the length
+// of a trace are invariant. What every match requires is the same number of
+// basic blocks, which isTwoSEGTraceMatched checks before it learns any node,
+// so skipping the pairs of other buckets learns nothing less. I/O kinds are
+// left out: they are only compared after the trace, whose matched nodes are
+// then learned even if the I/O nodes differ.
+vector<int> GraphDiffer::traceFingerprint(EnhancedSEGTrace *trace) {
+  return {(int)trace->trace.bbs.size()};
+}
+
+// buckets keep the iteration order of traces, so the first match found in
+// a bucket is the first one of the all-pairs comparison
+map<vector<int>, vector<EnhancedSEGTrace *>>
+GraphDiffer::groupByFingerprint(const EnhancedTraceSet &traces) {
+  map<vector<int>, vector<EnhancedSEGTrace *>> groups;
+  for (auto trace : traces) {
+    groups[traceFingerprint(trace)].push_back(trace);
+  }
+  return groups;
 }
 
 bool GraphDiffer::isTwoEnhancedTraceMatch(EnhancedSEGTrace *trace1,
@@ -1025,7 +1149,7 @@ bool GraphDiffer::isTwoSEGTraceMatchedWithPhi(
     if (isa<SEGOperandNode>(node1) && isa<SEGOperandNode>(node2)) {
       auto *segNode1 = dyn_cast<SEGNodeBase>(node1);
       auto *segNode2 = dyn_cast<SEGNodeBase>(node2);
-      if (!isPatchSEGNodeMatched(segNode1, segNode2)) {
+      if (!isPatchSEGNodeMatched(ctx, segNode1, segNode2)) {
         // special treatment for phi node
         if (isa<SEGPhiNode>(node1) && isa<SEGPhiNode>(node2)) {
           auto *phiNode1 = dyn_cast<SEGPhiNode>(node1);
@@ -1061,7 +1185,7 @@ bool GraphDiffer::isTwoSEGTraceMatchedWithPhi(
               if (matchedBBs.count(bbNode2)) {
                 continue;
               }
-              if (isTwoValueMatchedHelper(bbNode1, bbNode2)) {
+              if (isTwoValueMatchedHelper(ctx, bbNode1, bbNode2)) {
                 matchedBBs.insert({bbNode1, bbNode2});
               }
             }
@@ -1156,7 +1280,7 @@ bool GraphDiffer::isTwoSEGTraceMatchedWithoutPhi(
     if (isa<SEGOperandNode>(node1) && isa<SEGOperandNode>(node2)) {
       auto *segNode1 = dyn_cast<SEGNodeBase>(node1);
       auto *segNode2 = dyn_cast<SEGNodeBase>(node2);
-      if (!isPatchSEGNodeMatched(segNode1, segNode2)) {
+      if (!isPatchSEGNodeMatched(ctx, segNode1, segNode2)) {
         return false;
       }
       if (node1->getParentGraph()->getBaseFunc()->getName().startswith(
@@ -1178,21 +1302,21 @@ bool GraphDiffer::isTwoSEGTraceMatchedWithoutPhi(
 
 bool GraphDiffer::isTwoIONodeMatched(EnhancedSEGTrace *trace1,
                                      EnhancedSEGTrace *trace2) {
-  if (!isPatchSEGNodeMatched(trace1->input_node->usedNode,
+  if (!isPatchSEGNodeMatched(ctx, trace1->input_node->usedNode,
                              trace2->input_node->usedNode)) {
     return false;
   }
 
-  if (!isPatchSEGNodeMatched(trace1->output_node->usedNode,
+  if (!isPatchSEGNodeMatched(ctx, trace1->output_node->usedNode,
                              trace2->output_node->usedNode)) {
     return false;
   }
-  if (!isPatchSEGSiteMatched(trace1->input_node->usedSite,
+  if (!isPatchSEGSiteMatched(ctx, trace1->input_node->usedSite,
                              trace2->input_node->usedSite)) {
     return false;
   }
 
-  if (!isPatchSEGSiteMatched(trace1->output_node->usedSite,
+  if (!isPatchSEGSiteMatched(ctx, trace1->output_node->usedSite,
                              trace2->output_node->usedSite)) {
     return false;
   }
@@ -1202,6 +1326,12 @@ bool GraphDiffer::isTwoIONodeMatched(EnhancedSEGTrace *trace1,
 // can be invoked for both before/after patch and all before or all after patch
 bool GraphDiffer::isTwoSEGTraceMatched(SEGTraceWithBB &trace1,
                                        SEGTraceWithBB &trace2) {
+  // compare basic block, filter out obviously unmatched bbs. Checked before
+  // matching the nodes, which records matched nodes as a side effect, so that
+  // traces of distinct bb counts never match anything
+  if (trace1.bbs.size() != trace2.bbs.size()) {
+    return false;
+  }
 
   if (!isTwoSEGTraceMatchedWithPhi(trace1.trace, trace2.trace)) {
     if (!isTwoSEGTraceMatchedWithoutPhi(trace1.trace, trace2.trace)) {
@@ -1214,11 +1344,6 @@ bool GraphDiffer::isTwoSEGTraceMatched(SEGTraceWithBB &trace1,
   // dbgs() << "[Match bbs for trace2]:\n";
   // trace2.dump();
 
-  // compare basic block, filter out obviously unmatched bbs
-  if (trace1.bbs.size() != trace2.bbs.size()) {
-    return false;
-  }
-
   for (int i = 0; i < trace1.bbs.size(); i++) {
     auto bb1 = trace1.bbs[i];
     auto bb2 = trace2.bbs[i];
@@ -1232,22 +1357,22 @@ bool GraphDiffer::isTwoSEGTraceMatched(SEGTraceWithBB &trace1,
         continue;
       }
     }
-    if (matchedIRsBefore.count(bb1)) {
-      if (matchedIRsBefore[bb1] == bb2) {
+    if (ctx.matchedIRsBefore.count(bb1)) {
+      if (ctx.matchedIRsBefore[bb1] == bb2) {
         continue;
       } else {
         return false;
       }
     }
-    if (matchedIRsAfter.count(bb2)) {
-      if (matchedIRsAfter[bb2] == bb1) {
+    if (ctx.matchedIRsAfter.count(bb2)) {
+      if (ctx.matchedIRsAfter[bb2] == bb1) {
         continue;
       } else {
         return false;
       }
     }
     // unmatched basic block may have same irs
-    //    if (!isTwoValueMatchedHelper(bb1, bb2)) {
+    //    if (!isTwoValueMatchedHelper(ctx, bb1, bb2)) {
     //      return false;
     //    }
   }
@@ -1265,6 +1390,79 @@ bool GraphDiffer::isTwoConditionMatched(ConditionNode *cond1,
   return false;
 }
 
+// Whether both conditions agree under every assignment of their branch
+// literals, where a literal of cond2 takes the value of the cond1 literal
+// the solver query would assert it equal to. Conditions equal as boolean
+// functions are equal whatever their literals stand for, so the solver is
+// not needed. Any other outcome proves nothing, since the solver also knows
+// how the literals depend on each other. Only enumerates up to
+// FingerprintWords * 64 assignments, 64 at a time. This only replaces the
+// solver query, the flows of the literals are matched before either way.
+bool GraphDiffer::isTwoConditionFingerprintEqual(
+    ConditionNode *cond1, ConditionNode *cond2,
+    map<SEGNodeBase *, SEGNodeBase *> &matchedNodesInCond21) {
+  if (!FingerprintWords) {
+    return false;
+  }
+  // evaluate drops constants from their parent, which the solver takes as
+  // true, so conditions with constants are left to the solver
+  function<bool(ConditionNode *)> hasConst = [&](ConditionNode *node) {
+    return node->type == NODE_CONST ||
+           any_of(node->children.begin(), node->children.end(), hasConst);
+  };
+  if (hasConst(cond1) || hasConst(cond2)) {
+    return false;
+  }
+
+  auto atoms1 = cond1->obtainNodes();
+  auto atoms2 = cond2->obtainNodes();
+  map<SEGNodeBase *, SEGNodeBase *> atom2Peer;
+  for (auto atom2 : atoms2) {
+    if (atoms1.count(atom2)) {
+      atom2Peer[atom2] = atom2;
+      continue;
+    }
+    auto it = matchedNodesInCond21.find(atom2);
+    if (it != matchedNodesInCond21.end() && atoms1.count(it->second)) {
+      atom2Peer[atom2] = it->second;
+    }
+  }
+
+  vector<SEGNodeBase *> literals(atoms1.begin(), atoms1.end());
+  for (auto atom2 : atoms2) {
+    if (!atom2Peer.count(atom2)) {
+      literals.push_back(atom2);
+    }
+  }
+
+  unsigned numAssignments = FingerprintWords * 64;
+  if (literals.size() >= 32 || (1ULL << literals.size()) > numAssignments) {
+    return false;
+  }
+  map<SEGNodeBase *, ConditionTree::TruthTable> atomTables;
+  for (unsigned index = 0; index < literals.size(); index++) {
+    ConditionTree::TruthTable table(FingerprintWords, 0);
+    for (unsigned m = 0; m < numAssignments; m++) {
+      if ((m >> index) & 1) {
+        table[m / 64] |= 1ULL << (m % 64);
+      }
+    }
+    atomTables[literals[index]] = table;
+  }
+  for (auto [atom2, atom1] : atom2Peer) {
+    atomTables[atom2] = atomTables[atom1];
+  }
+
+  // evaluate matches toSMTExpr on what is left, empty ORs being false and
+  // empty ANDs true; anything it still drops proves nothing
+  ConditionTree::TruthTable table1, table2;
+  if (!ConditionTree::evaluate(cond1, atomTables, table1) ||
+      !ConditionTree::evaluate(cond2, atomTables, table2)) {
+    return false;
+  }
+  return table1 == table2;
+}
+
 // A fast way to compare two condition tree
 // when the tree structure is exactly the same,
 // return true
@@ -1317,7 +1515,7 @@ bool GraphDiffer::isTwoConditionMatchedFast(ConditionNode *cond1,
 
     if (!matchedNodesBefore.count(cond1->value) &&
         !matchedNodesAfter.count(cond2->value)) {
-      if (isPatchSEGNodeMatched(cond1->value, cond2->value)) {
+      if (isPatchSEGNodeMatched(ctx, cond1->value, cond2->value)) {
         if (cond1->value->getParentGraph()->getBaseFunc()->getName().startswith(
                 "before.patch") &&
             cond2->value->getParentGraph()->getBaseFunc()->getName().startswith(
@@ -1383,18 +1581,16 @@ bool GraphDiffer::isTwoConditionMatchedSMT(ConditionNode *cond1,
   map<SEGNodeBase *, SEGNodeBase *> matchedNodesInCond12;
   map<SEGNodeBase *, SEGNodeBase *> matchedNodesInCond21;
 
-  map<SEGNodeBase *, set<vector<SEGObject *>>> backwardTraces;
+  map<SEGNodeBase *, PathDAGNode *> backwardTraces;
   SEGWrapper->condNode2FlowIntra(cond1->obtainNodes(), backwardTraces);
-  for (auto [node, traces] : backwardTraces) { // and relation
-    if (traces.empty()) {
+  for (auto [node, paths] : backwardTraces) { // and relation
+    if (!SEGWrapper->intraSlicing.pathDAG.countPaths(paths)) {
       continue;
     }
     nodeInCond1.insert(node);
-    for (auto trace : traces) {
-      if (trace.empty()) {
-        continue;
-      }
-      auto startNode = trace.back();
+    set<SEGObject *> startNodes;
+    SEGWrapper->intraSlicing.pathDAG.collectPathEnds(paths, startNodes);
+    for (auto startNode : startNodes) {
       if (startNode->getLLVMDbgValue() &&
           isa<Constant>(startNode->getLLVMDbgValue())) {
         continue;
@@ -1404,16 +1600,14 @@ bool GraphDiffer::isTwoConditionMatchedSMT(ConditionNode *cond1,
   }
   backwardTraces.clear();
   SEGWrapper->condNode2FlowIntra(cond2->obtainNodes(), backwardTraces);
-  for (auto [node, traces] : backwardTraces) { // and relation
-    if (traces.empty()) {
+  for (auto [node, paths] : backwardTraces) { // and relation
+    if (!SEGWrapper->intraSlicing.pathDAG.countPaths(paths)) {
       continue;
     }
     nodeInCond2.insert(node);
-    for (auto trace : traces) {
-      if (trace.empty()) {
-        continue;
-      }
-      auto startNode = trace.back();
+    set<SEGObject *> startNodes;
+    SEGWrapper->intraSlicing.pathDAG.collectPathEnds(paths, startNodes);
+    for (auto startNode : startNodes) {
       if (startNode->getLLVMDbgValue() &&
           isa<Constant>(startNode->getLLVMDbgValue())) {
         continue;
@@ -1434,7 +1628,7 @@ bool GraphDiffer::isTwoConditionMatchedSMT(ConditionNode *cond1,
     } else {
       for (auto node2 : nodeInCond2) {
         if (matchedNodesInCond21.count(node2) == 0 &&
-            isPatchSEGNodeMatched(node1, node2)) {
+            isPatchSEGNodeMatched(ctx, node1, node2)) {
           if (node1->getParentGraph()->getBaseFunc()->getName().startswith(
                   "before.patch") &&
               node2->getParentGraph()->getBaseFunc()->getName().startswith(
@@ -1472,20 +1666,29 @@ bool GraphDiffer::isTwoConditionMatchedSMT(ConditionNode *cond1,
   if (condPairFeasibility.count({cond1, cond2})) {
     return condPairFeasibility[{cond1, cond2}] == SMTSolver::SMTRT_Unsat;
   }
-  // then, we employ SMT solver to determine the feasibility
-  auto smtDataExpr1 = SEGWrapper->condNode2SMTExprIntra(cond1);
-  auto smtDataExpr2 = SEGWrapper->condNode2SMTExprIntra(cond2);
 
-  SEGSolver->push();
-  for (auto [node1, node2] : matchedNodesInCond12) {
-    SEGSolver->add(SEGSolver->getOrInsertExpr(node1) ==
-                   SEGSolver->getOrInsertExpr(node2));
+  SMTSolver::SMTResultType checkRet;
+  if (isTwoConditionFingerprintEqual(cond1, cond2, matchedNodesInCond21)) {
+    // the XOR query below cannot be satisfiable
+    fingerprintMatchedNum += 1;
+    checkRet = SMTSolver::SMTRT_Unsat;
+  } else {
+    // then, we employ SMT solver to determine the feasibility
+    auto smtDataExpr1 = SEGWrapper->condNode2SMTExprIntra(cond1);
+    auto smtDataExpr2 = SEGWrapper->condNode2SMTExprIntra(cond2);
+
+    SEGSolver->push();
+    for (auto [node1, node2] : matchedNodesInCond12) {
+      SEGSolver->add(SEGSolver->getOrInsertExpr(node1) ==
+                     SEGSolver->getOrInsertExpr(node2));
+    }
+    SEGSolver->add(SEGWrapper->condNode2SMTExpr(cond1) ^
+                   SEGWrapper->condNode2SMTExpr(cond2));
+    SEGSolver->add(smtDataExpr1);
+    SEGSolver->add(smtDataExpr2);
+    checkRet = SEGSolver->check();
+    SEGSolver->pop();
   }
-  SEGSolver->add(cond1->toSMTExpr(SEGSolver) ^ cond2->toSMTExpr(SEGSolver));
-  SEGSolver->add(smtDataExpr1);
-  SEGSolver->add(smtDataExpr2);
-  auto checkRet = SEGSolver->check();
-  SEGSolver->pop();
 
   condPairFeasibility[{cond1, cond2}] = checkRet;
   condPairFeasibility[{cond2, cond1}] = checkRet;
@@ -1504,8 +1707,8 @@ bool GraphDiffer::isTwoFlowOrderMatched(EnhancedSEGTrace *trace1,
   return true;
   auto site1 = trace1->output_node->usedSite->getInstruction();
   auto site2 = trace2->output_node->usedSite->getInstruction();
-  if (matchedIRsBefore.count(site1)) {
-    if (matchedIRsBefore[site1] != site2) {
+  if (ctx.matchedIRsBefore.count(site1)) {
+    if (ctx.matchedIRsBefore[site1] != site2) {
       return false;
     } else {
       if (trace1->output_order != trace2->output_order) {
@@ -1515,8 +1718,8 @@ bool GraphDiffer::isTwoFlowOrderMatched(EnhancedSEGTrace *trace1,
       }
     }
   }
-  if (matchedIRsAfter.count(site1)) {
-    if (matchedIRsAfter[site1] != site2) {
+  if (ctx.matchedIRsAfter.count(site1)) {
+    if (ctx.matchedIRsAfter[site1] != site2) {
       return false;
     } else {
       if (trace1->output_order != trace2->output_order) {
@@ -1527,8 +1730,8 @@ bool GraphDiffer::isTwoFlowOrderMatched(EnhancedSEGTrace *trace1,
     }
   }
 
-  if (matchedIRsBefore.count(site2)) {
-    if (matchedIRsBefore[site2] != site1) {
+  if (ctx.matchedIRsBefore.count(site2)) {
+    if (ctx.matchedIRsBefore[site2] != site1) {
       return false;
     } else {
       if (trace1->output_order != trace2->output_order) {
@@ -1539,8 +1742,8 @@ bool GraphDiffer::isTwoFlowOrderMatched(EnhancedSEGTrace *trace1,
     }
   }
 
-  if (matchedIRsAfter.count(site2)) {
-    if (matchedIRsAfter[site2] != site1) {
+  if (ctx.matchedIRsAfter.count(site2)) {
+    if (ctx.matchedIRsAfter[site2] != site1) {
       return false;
     } else {
       if (trace1->output_order != trace2->output_order) {
@@ -1551,7 +1754,7 @@ bool GraphDiffer::isTwoFlowOrderMatched(EnhancedSEGTrace *trace1,
     }
   }
 
-  if (!isTwoIRMatched(site1, site2)) {
+  if (!isTwoIRMatched(ctx, site1, site2)) {
     return false;
   } else {
     if (trace1->output_order != trace2->output_order) {
@@ -1583,7 +1786,7 @@ bool GraphDiffer::isTwoConditionSubMatched(ConditionNode *cond1,
 
     if (matchedNodesBefore.find(cond1->value) == matchedNodesBefore.end() &&
         matchedNodesAfter.find(cond2->value) == matchedNodesAfter.end()) {
-      if (!isPatchSEGNodeMatched(cond1->value, cond2->value)) {
+      if (!isPatchSEGNodeMatched(ctx, cond1->value, cond2->value)) {
         return false;
       } else {
         if (cond1->value->getParentGraph()->getBaseFunc()->getName().startswith(
@@ -1638,13 +1841,14 @@ void GraphDiffer::diffTwoPathCondNum(map<Instruction *, CDType> &cond1,
       if (pair1.first->getOpcode() != pair2.first->getOpcode()) {
         continue;
       }
-      if (matchedIRsAfter.find(pair2.first) != matchedIRsAfter.end() &&
-          matchedIRsAfter[pair2.first] != pair1.first) {
+      if (ctx.matchedIRsAfter.find(pair2.first) != ctx.matchedIRsAfter.end() &&
+          ctx.matchedIRsAfter[pair2.first] != pair1.first) {
         continue;
       }
 
-      if (matchedIRsBefore.find(pair1.first) != matchedIRsBefore.end() &&
-          matchedIRsBefore[pair1.first] != pair2.first) {
+      if (ctx.matchedIRsBefore.find(pair1.first) !=
+              ctx.matchedIRsBefore.end() &&
+          ctx.matchedIRsBefore[pair1.first] != pair2.first) {
         continue;
       }
 
@@ -1769,8 +1973,8 @@ GraphDiffer::diffTwoOrder(map<OutputNode *, int> &site2order1,
         continue;
       }
       auto site2 = output2->usedSite->getInstruction();
-      if (matchedIRsBefore.count(site1)) {
-        if (matchedIRsBefore[site1] != site2) {
+      if (ctx.matchedIRsBefore.count(site1)) {
+        if (ctx.matchedIRsBefore[site1] != site2) {
           continue;
         } else {
           matchedOutput.insert({output1, output2});
@@ -1782,8 +1986,8 @@ GraphDiffer::diffTwoOrder(map<OutputNode *, int> &site2order1,
           break;
         }
       }
-      if (matchedIRsAfter.count(site1)) {
-        if (matchedIRsAfter[site1] != site2) {
+      if (ctx.matchedIRsAfter.count(site1)) {
+        if (ctx.matchedIRsAfter[site1] != site2) {
           continue;
         } else {
           matchedOutput.insert({output1, output2});
@@ -1796,8 +2000,8 @@ GraphDiffer::diffTwoOrder(map<OutputNode *, int> &site2order1,
         }
       }
 
-      if (matchedIRsBefore.count(site2)) {
-        if (matchedIRsBefore[site2] != site1) {
+      if (ctx.matchedIRsBefore.count(site2)) {
+        if (ctx.matchedIRsBefore[site2] != site1) {
           continue;
         } else {
           matchedOutput.insert({output1, output2});
@@ -1809,8 +2013,8 @@ GraphDiffer::diffTwoOrder(map<OutputNode *, int> &site2order1,
           break;
         }
       }
-      if (matchedIRsAfter.count(site2)) {
-        if (matchedIRsAfter[site2] != site1) {
+      if (ctx.matchedIRsAfter.count(site2)) {
+        if (ctx.matchedIRsAfter[site2] != site1) {
           continue;
         } else {
           matchedOutput.insert({output1, output2});
@@ -1823,7 +2027,7 @@ GraphDiffer::diffTwoOrder(map<OutputNode *, int> &site2order1,
         }
       }
 
-      if (!isTwoIRMatched(site1, site2)) {
+      if (!isTwoIRMatched(ctx, site1, site2)) {
         continue;
       }
 
@@ -1873,7 +2077,7 @@ void GraphDiffer::diffTwoConditionSEGNodes(ConditionNode *condMap1,
 
       if (matchedNodesAfter.find(cond1) == matchedNodesAfter.end() &&
           matchedNodesBefore.find(cond1) == matchedNodesBefore.end()) {
-        if (!isPatchSEGNodeMatched(cond1, cond2)) {
+        if (!isPatchSEGNodeMatched(ctx, cond1, cond2)) {
           continue;
         }
         nodeMaps.insert({cond1, cond2});
@@ -1885,7 +2089,7 @@ void GraphDiffer::diffTwoConditionSEGNodes(ConditionNode *condMap1,
 
       if (matchedNodesAfter.find(cond2) == matchedNodesAfter.end() &&
           matchedNodesBefore.find(cond2) == matchedNodesBefore.end()) {
-        if (!isPatchSEGNodeMatched(cond1, cond2)) {
+        if (!isPatchSEGNodeMatched(ctx, cond1, cond2)) {
           continue;
         }
         nodeMaps.insert({cond1, cond2});
@@ -2000,14 +2204,8 @@ ConditionNode *GraphDiffer::diffTwoConditions(ConditionNode *condMap1,
   //  dbgs() << "After Cond2\n");
   //  dbgs() << condMap2->dump();
 
-  ConditionNode *diffNode = new ConditionNode(SEGWrapper, NODE_AND);
-  ConditionNode *notNode = new ConditionNode(SEGWrapper, NODE_NOT);
-  notNode->addChild(condMap1);
-  diffNode->addChild(notNode);
-  diffNode->addChild(condMap2);
-  // dbgs() << "Before Diff\n");
-  // dbgs() << diffNode->dump();
-  diffNode->simplify();
+  // nullptr if condMap2 never holds without condMap1
+  ConditionNode *diffNode = ConditionTree::diffCondition(condMap1, condMap2);
 
   DEBUG_WITH_TYPE("condition", dbgs() << "\nMatched Cond Node "
                                       << matchedCondNodes.size() << "\n");
@@ -2016,6 +2214,9 @@ ConditionNode *GraphDiffer::diffTwoConditions(ConditionNode *condMap1,
   DEBUG_WITH_TYPE("condition", dbgs() << "Matched Single Cond Node "
                                       << matchedSingleNode << "\n");
   DEBUG_WITH_TYPE("condition", dbgs() << "After Diff\n");
+  if (!diffNode) {
+    return nullptr;
+  }
   DEBUG_WITH_TYPE("condition", dbgs() << diffNode->dump());
   //  exit(0);
   if (diffNode->type == NODE_CONST) {
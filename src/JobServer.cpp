@@ -0,0 +1,132 @@
+#include "JobServer.h"
+#include <llvm/Support/raw_ostream.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+JobServer::JobServer(string socketPath) : socketPath(std::move(socketPath)) {
+  if (this->socketPath.empty()) {
+    return;
+  }
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (this->socketPath.size() >= sizeof(addr.sun_path)) {
+    return;
+  }
+  strncpy(addr.sun_path, this->socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  // a socket left over by a previous server, but never any other file
+  struct stat info;
+  if (lstat(this->socketPath.c_str(), &info) == 0) {
+    if (!S_ISSOCK(info.st_mode)) {
+      return;
+    }
+    unlink(this->socketPath.c_str());
+  }
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return;
+  }
+  if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listenFd, 1) < 0) {
+    close(listenFd);
+    listenFd = -1;
+  }
+}
+
+JobServer::~JobServer() {
+  if (clientFd >= 0) {
+    close(clientFd);
+  }
+  if (listenFd >= 0) {
+    close(listenFd);
+    unlink(socketPath.c_str());
+  }
+}
+
+bool JobServer::next(string &job) {
+  while (true) {
+    if (socketPath.empty()) {
+      if (!getline(cin, job)) {
+        return false;
+      }
+    } else {
+      if (listenFd < 0) {
+        return false;
+      }
+      if (clientFd < 0) {
+        clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+      }
+      if (!readClientLine(job)) {
+        close(clientFd);
+        clientFd = -1;
+        pending.clear();
+        continue;
+      }
+    }
+
+    if (!job.empty() && job.back() == '\r') {
+      job.pop_back();
+    }
+    if (job.find_first_not_of(" \t") != string::npos) {
+      return true;
+    }
+  }
+}
+
+bool JobServer::readClientLine(string &line) {
+  size_t end;
+  while ((end = pending.find('\n')) == string::npos) {
+    char buf[4096];
+    ssize_t size = read(clientFd, buf, sizeof(buf));
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      return false;
+    }
+    pending.append(buf, size);
+  }
+  line = pending.substr(0, end);
+  pending.erase(0, end + 1);
+  return true;
+}
+
+void JobServer::reply(const string &line) {
+  if (socketPath.empty()) {
+    outs() << line << "\n";
+    outs().flush();
+    return;
+  }
+  if (clientFd < 0) {
+    return;
+  }
+  string data = line + "\n";
+  size_t sent = 0;
+  while (sent < data.size()) {
+    // a client that went away must not kill the server with SIGPIPE
+    ssize_t size =
+        send(clientFd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      return;
+    }
+    sent += size;
+  }
+}
@@ -55,12 +55,13 @@ bool diffSEGCommonArgument(SEGNodeBase *node1, SEGNodeBase *node2) {
   return true;
 }
 
-bool diffSEGPseudoIO(SEGNodeBase *node1, SEGNodeBase *node2) {
+bool diffSEGPseudoIO(PatchContext &ctx, SEGNodeBase *node1,
+                     SEGNodeBase *node2) {
   auto callSite1 = getCallSite(node1);
   auto callSite2 = getCallSite(node2);
   if (callSite1 && callSite2) {
-    if (matchedIRsBefore.count(callSite1)) {
-      if (matchedIRsBefore[callSite1] != callSite2) {
+    if (ctx.matchedIRsBefore.count(callSite1)) {
+      if (ctx.matchedIRsBefore[callSite1] != callSite2) {
         return false;
       }
     }
@@ -83,7 +84,8 @@ bool diffSEGPseudoIO(SEGNodeBase *node1, SEGNodeBase *node2) {
 }
 
 // check node properties only
-bool isTwoSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
+bool isTwoSEGNodeMatched(PatchContext &ctx, SEGNodeBase *node1,
+                         SEGNodeBase *node2) {
   if (node1 == node2) {
     return true;
   }
@@ -102,13 +104,14 @@ bool isTwoSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
     return false;
   }
 
-  if (!diffSEGPseudoIO(node1, node2)) {
+  if (!diffSEGPseudoIO(ctx, node1, node2)) {
     return false;
   }
   return true;
 }
 
-bool isPatchSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
+bool isPatchSEGNodeMatched(PatchContext &ctx, SEGNodeBase *node1,
+                           SEGNodeBase *node2) {
   if (node1 == node2) {
     return true;
   }
@@ -125,7 +128,7 @@ bool isPatchSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
     return false;
   }
 
-  if (!isTwoSEGNodeMatched(node1, node2)) {
+  if (!isTwoSEGNodeMatched(ctx, node1, node2)) {
     return false;
   }
 
@@ -154,7 +157,7 @@ bool isPatchSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
         return true;
       }
       if (parentFuncName1 != parentFuncName2) {
-        if (!isTwoValueMatchedHelper(node1->getLLVMDbgValue(),
+        if (!isTwoValueMatchedHelper(ctx, node1->getLLVMDbgValue(),
                                      node2->getLLVMDbgValue())) {
           return false;
         }
@@ -168,8 +171,9 @@ bool isPatchSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
   return true;
 }
 
-bool isDriverSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
-  if (!isTwoSEGNodeMatched(node1, node2)) {
+bool isDriverSEGNodeMatched(PatchContext &ctx, SEGNodeBase *node1,
+                            SEGNodeBase *node2) {
+  if (!isTwoSEGNodeMatched(ctx, node1, node2)) {
     return false;
   }
   if (isa<SEGSimpleOperandNode>(node1) && isa<SEGSimpleOperandNode>(node2)) {
@@ -208,7 +212,8 @@ bool isDriverSEGNodeMatched(SEGNodeBase *node1, SEGNodeBase *node2) {
   return true;
 }
 
-bool isPatchSEGSiteMatched(SEGSiteBase *site1, SEGSiteBase *site2) {
+bool isPatchSEGSiteMatched(PatchContext &ctx, SEGSiteBase *site1,
+                           SEGSiteBase *site2) {
 
   if (site1 == site2) {
     return true;
@@ -233,39 +238,39 @@ bool isPatchSEGSiteMatched(SEGSiteBase *site1, SEGSiteBase *site2) {
   auto inst1 = site1->getInstruction();
   auto inst2 = site2->getInstruction();
 
-  if (matchedIRsBefore.count(inst1)) {
-    if (matchedIRsBefore[inst1] != inst2) {
+  if (ctx.matchedIRsBefore.count(inst1)) {
+    if (ctx.matchedIRsBefore[inst1] != inst2) {
       return false;
     } else {
       return true;
     }
   }
 
-  if (matchedIRsBefore.count(inst2)) {
-    if (matchedIRsBefore[inst2] != inst1) {
+  if (ctx.matchedIRsBefore.count(inst2)) {
+    if (ctx.matchedIRsBefore[inst2] != inst1) {
       return false;
     } else {
       return true;
     }
   }
 
-  if (matchedIRsAfter.count(inst1)) {
-    if (matchedIRsAfter[inst1] != inst2) {
+  if (ctx.matchedIRsAfter.count(inst1)) {
+    if (ctx.matchedIRsAfter[inst1] != inst2) {
       return false;
     } else {
       return true;
     }
   }
 
-  if (matchedIRsAfter.count(inst2)) {
-    if (matchedIRsAfter[inst2] != inst1) {
+  if (ctx.matchedIRsAfter.count(inst2)) {
+    if (ctx.matchedIRsAfter[inst2] != inst1) {
       return false;
     } else {
       return true;
     }
   }
 
-  if (!isTwoIRMatched(inst1, inst2)) {
+  if (!isTwoIRMatched(ctx, inst1, inst2)) {
     return false;
   }
 
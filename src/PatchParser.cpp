@@ -2,13 +2,129 @@
 #include "PatchParser.h"
 #include "UtilsHelper.h"
 #include "ValueHelper.h"
+#include "llvm/ADT/Hashing.h"
 
 static cl::opt<bool, false>
     DumpDiffProcess("dump-ir-diff",
                     cl::desc("Dump the process of IR difference."),
                     cl::init(false), cl::Hidden);
 
-PatchParser::PatchParser(Module *M, DebugInfoAnalysis *pDIA, string patchFile) {
+static cl::opt<bool>
+    AlignIR("align-ir",
+            cl::desc("Match pre- and post-patch IRs by aligning the "
+                     "instruction streams of each function before matching "
+                     "them by line."),
+            cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned>
+    AlignIRMaxEdits("align-ir-max-edits",
+                    cl::desc("Give up aligning the changed middle of two "
+                             "functions beyond this many inserted or removed "
+                             "instructions."),
+                    cl::init(2048), cl::Hidden);
+
+// opcode, type and the shape of the operands of an instruction; equal tokens
+// are a prerequisite of matched IRs
+static size_t irToken(Instruction *inst) {
+  size_t token = hash_combine(inst->getOpcode(), inst->getNumOperands());
+  token = hash_combine(token, hash<string>()(type2String(inst->getType())));
+  if (auto *icmpInst = dyn_cast<ICmpInst>(inst)) {
+    token = hash_combine(token, icmpInst->getPredicate());
+  }
+  for (auto &op : inst->operands()) {
+    Value *value = op.get();
+    size_t shape = value->getValueID();
+    if (auto *opInst = dyn_cast<Instruction>(value)) {
+      shape = hash_combine(shape, opInst->getOpcode());
+    } else if (auto *arg = dyn_cast<Argument>(value)) {
+      shape = hash_combine(shape, arg->getArgNo());
+    } else if (auto *constInt = dyn_cast<ConstantInt>(value)) {
+      shape = hash_combine(shape, constInt->getSExtValue());
+    } else if (isa<GlobalValue>(value) && value->hasName()) {
+      string name = value->getName().str();
+      cleanString(name);
+      shape = hash_combine(shape, hash<string>()(name));
+    }
+    token = hash_combine(token, shape);
+  }
+  return token;
+}
+
+// longest common subsequence of two token streams by Myers' algorithm, after
+// stripping their common prefix and suffix. The middle is left unaligned if
+// it takes more than maxEdits insertions and removals.
+static void alignTokens(const vector<size_t> &a, const vector<size_t> &b,
+                        unsigned maxEdits,
+                        vector<pair<size_t, size_t>> &aligned) {
+  size_t prefix = 0;
+  while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+    aligned.emplace_back(prefix, prefix);
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+         a[a.size() - suffix - 1] == b[b.size() - suffix - 1]) {
+    suffix++;
+  }
+
+  int n = a.size() - prefix - suffix;
+  int m = b.size() - prefix - suffix;
+  int maxD = min(n + m, (int)maxEdits);
+  int offset = maxD + 1;
+  vector<int> v(2 * maxD + 3, 0);
+  // trace[d] keeps v[-d - 1 .. d + 1] as it was before round d
+  vector<vector<int>> trace;
+  bool reached = n == 0 && m == 0;
+  for (int d = 0; d <= maxD && !reached; d++) {
+    trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+    for (int k = -d; k <= d; k += 2) {
+      int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                  ? v[offset + k + 1]
+                  : v[offset + k - 1] + 1;
+      int y = x - k;
+      while (x < n && y < m && a[prefix + x] == b[prefix + y]) {
+        x++;
+        y++;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        reached = true;
+        break;
+      }
+    }
+  }
+
+  if (reached) {
+    vector<pair<size_t, size_t>> middle;
+    int x = n, y = m;
+    for (int d = (int)trace.size() - 1; d >= 0; d--) {
+      auto &prevV = trace[d];
+      int k = x - y;
+      int prevK =
+          (k == -d || (k != d && prevV[k - 1 + d + 1] < prevV[k + 1 + d + 1]))
+              ? k + 1
+              : k - 1;
+      int prevX = prevV[prevK + d + 1];
+      int prevY = prevX - prevK;
+      while (x > prevX && y > prevY) {
+        x--;
+        y--;
+        middle.emplace_back(prefix + x, prefix + y);
+      }
+      x = prevX;
+      y = prevY;
+    }
+    aligned.insert(aligned.end(), middle.rbegin(), middle.rend());
+  }
+
+  for (size_t i = suffix; i > 0; i--) {
+    aligned.emplace_back(a.size() - i, b.size() - i);
+  }
+}
+
+PatchParser::PatchParser(Module *M, DebugInfoAnalysis *pDIA, PatchContext &ctx,
+                         string patchFile)
+    : ctx(ctx) {
   this->M = M;
   DIA = pDIA;
   cacheFuncBBScope();
@@ -18,10 +134,22 @@ PatchParser::PatchParser(Module *M, DebugInfoAnalysis *pDIA, string patchFile) {
 }
 
 void PatchParser::parseIRChanges() {
-  //  for (auto func : changedFuncs) {
+  //  for (auto func : ctx.changedFuncs) {
   //    outs() << *func << "\n";
   //  }
 
+  if (AlignIR.getValue()) {
+    for (Function &F : *M) {
+      if (F.isDeclaration() || !F.getName().startswith("before.patch.")) {
+        continue;
+      }
+      auto afterFunc = M->getFunction(findABMatchFunc(F.getName()));
+      if (afterFunc && !afterFunc->isDeclaration()) {
+        alignFuncIRs(&F, afterFunc);
+      }
+    }
+  }
+
   matchBBByLine();
   matchUnChangedIRs();
   matchAndDiffChangedIRs();
@@ -29,12 +157,13 @@ void PatchParser::parseIRChanges() {
   dbgs() << "\n=========1 [Print PatchParser Statistics] =======\n";
   dbgs() << "[# Added   LLVM Values]: " << addedValues.size() << "\n";
   dbgs() << "[# Removed LLVM Values]: " << removedValues.size() << "\n";
-  dbgs() << "[# Matched IRs Before]: " << matchedIRsBefore.size() << "\n";
-  dbgs() << "[# Matched IRs After]: " << matchedIRsAfter.size() << "\n";
+  dbgs() << "[# Matched IRs Before]: " << ctx.matchedIRsBefore.size() << "\n";
+  dbgs() << "[# Matched IRs After]: " << ctx.matchedIRsAfter.size() << "\n";
+  dbgs() << "[# Aligned IRs]: " << alignedIRNum << "\n";
 
-  for (auto [beforeIR, afterIR] : matchedIRsBefore) {
+  for (auto [beforeIR, afterIR] : ctx.matchedIRsBefore) {
     if (auto *bb = dyn_cast<BasicBlock>(beforeIR)) {
-      if (!changedFuncs.count(bb->getParent())) {
+      if (!ctx.changedFuncs.count(bb->getParent())) {
         continue;
       }
       DEBUG_WITH_TYPE("statistics", dbgs() << "1.0 Matched BB Before\n"
@@ -42,7 +171,7 @@ void PatchParser::parseIRChanges() {
                                            << *afterIR << "\n");
 
     } else if (auto *inst = dyn_cast<Instruction>(beforeIR)) {
-      if (!changedFuncs.count(inst->getParent()->getParent())) {
+      if (!ctx.changedFuncs.count(inst->getParent()->getParent())) {
         continue;
       }
       DEBUG_WITH_TYPE("statistics", dbgs() << "1.0 Matched IR Before\n"
@@ -54,10 +183,10 @@ void PatchParser::parseIRChanges() {
                                            << *afterIR << "\n");
     }
   }
-  // make sure matchedIRsBefore and matchedIRAfter have the same number of
+  // make sure ctx.matchedIRsBefore and matchedIRAfter have the same number of
   // mappings
-  for (auto [beforeIR, afterIR] : matchedIRsBefore) {
-    if (matchedIRsAfter.count(afterIR) == 0) {
+  for (auto [beforeIR, afterIR] : ctx.matchedIRsBefore) {
+    if (ctx.matchedIRsAfter.count(afterIR) == 0) {
       dbgs() << "!!!Incorrect in matched IR after: " << *afterIR << "\n";
     }
   }
@@ -130,54 +259,194 @@ void PatchParser::cacheFuncBBScope() {
       funcSourceFile.insert({&F, final_source_file.c_str()});
     }
   }
+
+  for (auto [func, scope] : funcLineScope) {
+    bool isAfter = func->getName().startswith("after.patch.");
+    if (!isAfter && !func->getName().startswith("before.patch.")) {
+      continue;
+    }
+    funcIntervals[{funcSourceFile[func], isAfter}].scopes.push_back(
+        {scope, func});
+  }
+  for (auto &[key, intervals] : funcIntervals) {
+    sort(intervals.scopes.begin(), intervals.scopes.end());
+    int maxEnd = INT_MIN;
+    for (auto &[scope, func] : intervals.scopes) {
+      maxEnd = max(maxEnd, scope.second);
+      intervals.maxEnd.push_back(maxEnd);
+    }
+  }
+
+  // an instruction is found at a line only within the scope of its block
+  for (Function &F : *M) {
+    for (BasicBlock &B : F) {
+      auto scopeIt = blockLineScope.find(&B);
+      if (scopeIt == blockLineScope.end()) {
+        continue;
+      }
+      vector<pair<Instruction *, int>> inst2Line;
+      collectBlockLines(B, inst2Line);
+      for (auto [inst, line] : inst2Line) {
+        if (line >= scopeIt->second.first && line <= scopeIt->second.second) {
+          funcLineInsts[&F][line].push_back(inst);
+        }
+      }
+    }
+  }
 }
 
-// Given diff file, identify changed functions and lines
-void PatchParser::parsePatchFile(string patchFile) {
-  ifstream file(patchFile);
+// path of the file in a "--- a/path" or "+++ b/path" header of a unified
+// diff, empty for /dev/null
+static string diffHeaderPath(StringRef header) {
+  StringRef path = header.drop_front(4).split('\t').first.rtrim();
+  if (path == "/dev/null") {
+    return "";
+  }
+  if (path.startswith("a/") || path.startswith("b/")) {
+    path = path.drop_front(2);
+  }
+  return path.str();
+}
 
-  if (file.fail()) {
-    return;
+// "start[,count]" of a hunk header; the start of an empty range is the line
+// before it
+static bool parseHunkRange(StringRef range, int &start, int &count) {
+  auto [startStr, countStr] = range.split(',');
+  count = 1;
+  if (startStr.getAsInteger(10, start) ||
+      (!countStr.empty() && countStr.getAsInteger(10, count))) {
+    return false;
   }
-  if (file.is_open()) {
-    string line, curFunc;
-    while (getline(file, line)) {
-      if (line[0] == '+') {
-        auto addLine = ChangedLine(line);
-        auto add_funcs =
-            findEnclosedFunc(addLine.sourceFile, addLine.line, true);
-        for (auto func : add_funcs) {
-          addLine.func = func;
-          changedFuncs.insert(addLine.func);
-          changedFuncs.insert(
-              M->getFunction(findABMatchFunc(addLine.func->getName())));
-          addedLines.push_back(addLine);
-        }
-      } else if (line[0] == '-') {
-        auto removedLine = ChangedLine(line);
-        auto removed_funcs =
-            findEnclosedFunc(removedLine.sourceFile, removedLine.line, false);
-        for (auto func : removed_funcs) {
-          removedLine.func = func;
-          changedFuncs.insert(removedLine.func);
-          changedFuncs.insert(
-              M->getFunction(findABMatchFunc(removedLine.func->getName())));
-          removedLines.push_back(removedLine);
+  if (count == 0) {
+    start++;
+  }
+  return true;
+}
+
+// Given diff file, identify changed functions and lines. The diff is either
+// a unified diff, e.g. from git format-patch, or a list of "+file:line" and
+// "-file:line" changes. A patch file "-" is read from stdin.
+void PatchParser::parsePatchFile(string patchFile) {
+  ifstream file;
+  if (patchFile != "-") {
+    file.open(patchFile);
+    if (file.fail()) {
+      return;
+    }
+  }
+  istream &in = patchFile == "-" ? cin : file;
+
+  bool sawDiffHeader = false;
+  string oldPath, newPath;
+  int oldLine = 0, newLine = 0, oldRemain = 0, newRemain = 0;
+  // removed lines of the current run of changes in a hunk, the first
+  // numReplaced of them are paired with added lines
+  vector<int> runRemoved;
+  size_t numReplaced = 0;
+  bool offsetChanged = false;
+
+  auto endRun = [&]() {
+    if (offsetChanged) {
+      lineOffsets[oldPath][oldLine] = newLine - oldLine;
+    }
+    runRemoved.clear();
+    numReplaced = 0;
+    offsetChanged = false;
+  };
+
+  string line;
+  while (getline(in, line)) {
+    StringRef str(line);
+    if (oldRemain > 0 || newRemain > 0) {
+      if (str.startswith("\\")) {
+        continue;
+      }
+      if (str.startswith("-")) {
+        addChangedLine(ChangedLine(oldPath, oldLine, false));
+        runRemoved.push_back(oldLine);
+        oldLine++;
+        oldRemain--;
+        offsetChanged = true;
+      } else if (str.startswith("+")) {
+        addChangedLine(ChangedLine(newPath, newLine, true));
+        if (numReplaced < runRemoved.size()) {
+          replacedLines[oldPath][runRemoved[numReplaced++]] = newLine;
         }
+        newLine++;
+        newRemain--;
+        offsetChanged = true;
+      } else {
+        endRun();
+        oldLine++;
+        newLine++;
+        oldRemain--;
+        newRemain--;
       }
+      if (oldRemain <= 0 && newRemain <= 0) {
+        oldRemain = newRemain = 0;
+        endRun();
+      }
+      continue;
+    }
+
+    if (str.startswith("diff --git ")) {
+      sawDiffHeader = true;
+    } else if (str.startswith("--- ")) {
+      sawDiffHeader = true;
+      oldPath = diffHeaderPath(str);
+    } else if (str.startswith("+++ ")) {
+      newPath = diffHeaderPath(str);
+    } else if (str.startswith("@@ ")) {
+      SmallVector<StringRef, 4> fields;
+      str.split(fields, " ");
+      if (fields.size() < 3 || !fields[1].startswith("-") ||
+          !fields[2].startswith("+") ||
+          !parseHunkRange(fields[1].drop_front(), oldLine, oldRemain) ||
+          !parseHunkRange(fields[2].drop_front(), newLine, newRemain)) {
+        oldRemain = newRemain = 0;
+        continue;
+      }
+      isUnifiedDiff = true;
+    } else if (!sawDiffHeader && (str.startswith("+") || str.startswith("-"))) {
+      unsigned lineNum;
+      if (str.drop_front().split(':').second.getAsInteger(10, lineNum)) {
+        continue;
+      }
+      addChangedLine(ChangedLine(str));
     }
-    file.close();
   }
 
-  for (auto F : changedFuncs) {
+  for (auto F : ctx.changedFuncs) {
     DEBUG_WITH_TYPE("statistics", dbgs() << *F << "\n");
   }
 }
 
+void PatchParser::addChangedLine(ChangedLine changedLine) {
+  auto funcs = findEnclosedFunc(changedLine.sourceFile, changedLine.line,
+                                changedLine.is_add);
+  for (auto func : funcs) {
+    changedLine.func = func;
+    ctx.changedFuncs.insert(func);
+    ctx.changedFuncs.insert(M->getFunction(findABMatchFunc(func->getName())));
+    if (changedLine.is_add) {
+      addedLines.push_back(changedLine);
+      addedLineSet[changedLine.sourceFile].insert(changedLine.line);
+    } else {
+      removedLines.push_back(changedLine);
+      removedLineSet[changedLine.sourceFile].insert(changedLine.line);
+    }
+  }
+}
+
 // Establish the line number mapping between pre- and post- patch codes
 void PatchParser::computeBeforeAfterLineMap() {
+  if (isUnifiedDiff) {
+    computeUnifiedDiffLineMap();
+    return;
+  }
+
   // handle changed function
-  for (auto before_func : changedFuncs) {
+  for (auto before_func : ctx.changedFuncs) {
     if (before_func->getName().startswith("after.patch.")) {
       continue;
     }
@@ -214,23 +483,23 @@ void PatchParser::computeBeforeAfterLineMap() {
       after_line++;
     }
 
-    if (unChangedMapping.find(srcfile) == unChangedMapping.end()) {
-      unChangedMapping[srcfile];
+    if (ctx.unChangedMapping.find(srcfile) == ctx.unChangedMapping.end()) {
+      ctx.unChangedMapping[srcfile];
     }
 
-    if (changedMapping.find(srcfile) == changedMapping.end()) {
-      changedMapping[srcfile];
+    if (ctx.changedMapping.find(srcfile) == ctx.changedMapping.end()) {
+      ctx.changedMapping[srcfile];
     }
 
-    unChangedMapping[srcfile].insert(codeUnChangedInFunc.begin(),
+    ctx.unChangedMapping[srcfile].insert(codeUnChangedInFunc.begin(),
                                      codeUnChangedInFunc.end());
-    changedMapping[srcfile].insert(codeChangedInFunc.begin(),
+    ctx.changedMapping[srcfile].insert(codeChangedInFunc.begin(),
                                    codeChangedInFunc.end());
   }
 
   // handle unchanged functions
   for (auto it : funcLineScope) {
-    if (changedFuncs.find(it.first) != changedFuncs.end()) {
+    if (ctx.changedFuncs.find(it.first) != ctx.changedFuncs.end()) {
       continue;
     }
     if (it.first->getName().startswith("after.patch.")) {
@@ -250,11 +519,162 @@ void PatchParser::computeBeforeAfterLineMap() {
       before_line++;
       after_line++;
     }
-    unChangedMapping[srcfile].insert(codeUnChangedInFunc.begin(),
+    ctx.unChangedMapping[srcfile].insert(codeUnChangedInFunc.begin(),
                                      codeUnChangedInFunc.end());
   }
 }
 
+// match the IRs of two versions of a function that the alignment of their
+// instruction streams pairs up, if their operands are matched as well. IRs
+// left unmatched fall back to the line-based matching. IRs of added or removed
+// lines are changed IRs and never aligned.
+void PatchParser::alignFuncIRs(Function *beforeFunc, Function *afterFunc) {
+  vector<Instruction *> beforeIRs, afterIRs;
+  vector<size_t> beforeTokens, afterTokens;
+  for (BasicBlock &B : *beforeFunc) {
+    for (Instruction &I : B) {
+      if (isIROnChangedLine(&I)) {
+        continue;
+      }
+      beforeIRs.push_back(&I);
+      beforeTokens.push_back(irToken(&I));
+    }
+  }
+  for (BasicBlock &B : *afterFunc) {
+    for (Instruction &I : B) {
+      if (isIROnChangedLine(&I)) {
+        continue;
+      }
+      afterIRs.push_back(&I);
+      afterTokens.push_back(irToken(&I));
+    }
+  }
+
+  vector<pair<size_t, size_t>> aligned;
+  alignTokens(beforeTokens, afterTokens, AlignIRMaxEdits.getValue(), aligned);
+
+  // operands defined later, i.e. incoming values of phis, are only matched
+  // once all other aligned IRs are
+  vector<pair<Instruction *, Instruction *>> phis;
+  for (auto [beforeIdx, afterIdx] : aligned) {
+    auto beforeIR = beforeIRs[beforeIdx];
+    auto afterIR = afterIRs[afterIdx];
+    if (isa<PHINode>(beforeIR)) {
+      phis.emplace_back(beforeIR, afterIR);
+    } else if (isAlignedIRConsistent(beforeIR, afterIR)) {
+      ctx.matchedIRsBefore.insert({beforeIR, afterIR});
+      ctx.matchedIRsAfter.insert({afterIR, beforeIR});
+      alignedIRNum++;
+    }
+  }
+  for (auto [beforeIR, afterIR] : phis) {
+    if (isAlignedIRConsistent(beforeIR, afterIR)) {
+      ctx.matchedIRsBefore.insert({beforeIR, afterIR});
+      ctx.matchedIRsAfter.insert({afterIR, beforeIR});
+      alignedIRNum++;
+    }
+  }
+
+  // blocks of changed functions whose IRs are all matched, in order, to the
+  // IRs of one block are matched
+  if (!ctx.changedFuncs.count(beforeFunc)) {
+    return;
+  }
+  for (BasicBlock &B : *beforeFunc) {
+    if (ctx.matchedIRsBefore.count(&B)) {
+      continue;
+    }
+    auto it = ctx.matchedIRsBefore.find(&B.front());
+    if (it == ctx.matchedIRsBefore.end()) {
+      continue;
+    }
+    auto afterBB = cast<Instruction>(it->second)->getParent();
+    if (ctx.matchedIRsAfter.count(afterBB) ||
+        afterBB->getInstList().size() != B.getInstList().size()) {
+      continue;
+    }
+    bool allMatched = true;
+    auto afterIt = afterBB->begin();
+    for (auto beforeIt = B.begin(); beforeIt != B.end();
+         beforeIt++, afterIt++) {
+      it = ctx.matchedIRsBefore.find(&*beforeIt);
+      if (it == ctx.matchedIRsBefore.end() || it->second != &*afterIt) {
+        allMatched = false;
+        break;
+      }
+    }
+    if (allMatched) {
+      ctx.matchedIRsBefore.insert({&B, afterBB});
+      ctx.matchedIRsAfter.insert({afterBB, &B});
+    }
+  }
+}
+
+bool PatchParser::isAlignedIRConsistent(Instruction *beforeIR,
+                                        Instruction *afterIR) {
+  if (ctx.matchedIRsBefore.count(beforeIR) ||
+      ctx.matchedIRsAfter.count(afterIR)) {
+    return false;
+  }
+  if (beforeIR->getOpcode() != afterIR->getOpcode() ||
+      beforeIR->getNumOperands() != afterIR->getNumOperands()) {
+    return false;
+  }
+
+  string src_file1 = getSrcFileName(beforeIR);
+  string src_file2 = getSrcFileName(afterIR);
+  if (!src_file1.empty() && !src_file2.empty() && src_file1 != src_file2) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < beforeIR->getNumOperands(); i++) {
+    auto op1 = beforeIR->getOperand(i);
+    auto op2 = afterIR->getOperand(i);
+    if (isa<BasicBlock>(op1) && isa<BasicBlock>(op2)) {
+      continue;
+    }
+    if (isa<Instruction>(op1) || isa<Instruction>(op2)) {
+      auto it = ctx.matchedIRsBefore.find(op1);
+      if (it == ctx.matchedIRsBefore.end() || it->second != op2) {
+        return false;
+      }
+      continue;
+    }
+    if (!isTwoValueMatchedHelper(ctx, op1, op2)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Establish the line number mapping of all pre-patch functions from the line
+// offsets and replaced lines of a unified diff
+void PatchParser::computeUnifiedDiffLineMap() {
+  for (auto [func, scope] : funcLineScope) {
+    if (!func->getName().startswith("before.patch.")) {
+      continue;
+    }
+    string srcfile = funcSourceFile[func];
+    auto &offsets = lineOffsets[srcfile];
+    auto &replaced = replacedLines[srcfile];
+    auto &codeUnChanged = ctx.unChangedMapping[srcfile];
+    auto &codeChanged = ctx.changedMapping[srcfile];
+
+    for (int line = scope.first; line <= scope.second; line++) {
+      if (isLineRemoved(srcfile, line)) {
+        auto it = replaced.find(line);
+        if (it != replaced.end() && isLineAdded(srcfile, it->second)) {
+          codeChanged.insert(*it);
+        }
+        continue;
+      }
+      auto it = offsets.upper_bound(line);
+      int offset = it == offsets.begin() ? 0 : prev(it)->second;
+      codeUnChanged.insert({line, line + offset});
+    }
+  }
+}
+
 void PatchParser::matchBBByLine() {
   map<string, map<pair<int, int>, vector<BasicBlock *>>> valueToBlocks;
 
@@ -269,7 +689,7 @@ void PatchParser::matchBBByLine() {
     if (block->getParent()->getName().startswith("after.patch")) {
       value.first = entry.second.first;
       value.second = entry.second.second;
-      //       if (changedFuncs.count(block->getParent())) {
+      //       if (ctx.changedFuncs.count(block->getParent())) {
       //         dbgs() << "\nSrc file: " << src_file << "\n";
       //         dbgs() << "Range of original after bb " << block->getName() <<
       //         " in "
@@ -278,19 +698,19 @@ void PatchParser::matchBBByLine() {
       //                << "\n";
       //       }
     } else {
-      //       if (changedFuncs.count(block->getParent())) {
+      //       if (ctx.changedFuncs.count(block->getParent())) {
       //         dbgs() << "\nSrc file: " << src_file << "\n";
       //         dbgs() << "Range of before bb " << block->getName() << " in "
       //                << block->getParent()->getName() << " is from "
       //                << entry.second.first << " to " << entry.second.second
       //                << "\n";
       //       }
-      if (unChangedMapping.count(src_file)) {
-        if (unChangedMapping[src_file].count(entry.second.first) &&
-            unChangedMapping[src_file].count(entry.second.second)) {
-          value.first = unChangedMapping[src_file][entry.second.first];
-          value.second = unChangedMapping[src_file][entry.second.second];
-          //           if (changedFuncs.count(block->getParent())) {
+      if (ctx.unChangedMapping.count(src_file)) {
+        if (ctx.unChangedMapping[src_file].count(entry.second.first) &&
+            ctx.unChangedMapping[src_file].count(entry.second.second)) {
+          value.first = ctx.unChangedMapping[src_file][entry.second.first];
+          value.second = ctx.unChangedMapping[src_file][entry.second.second];
+          //           if (ctx.changedFuncs.count(block->getParent())) {
           //             dbgs() << "Range of mapped after bb " <<
           //             block->getName() << " in "
           //                    << block->getParent()->getName() << " is from "
@@ -313,7 +733,7 @@ void PatchParser::matchBBByLine() {
       if (pairedBlocks.empty()) {
         continue;
       }
-      //      if (changedFuncs.count(pairedBlocks.front()->getParent())) {
+      //      if (ctx.changedFuncs.count(pairedBlocks.front()->getParent())) {
       //        DEBUG_WITH_TYPE("statistics", dbgs() << "Range of mapped from "
       //        << item.first.first << " to "
       //               << item.first.second << ": " << pairedBlocks.size()
@@ -335,51 +755,56 @@ void PatchParser::matchBBByLine() {
         }
       } else {
         for (auto bbBefore : pairedBlocks) {
-          if (changedFuncs.count(bbBefore->getParent())) {
+          if (ctx.changedFuncs.count(bbBefore->getParent())) {
             DEBUG_WITH_TYPE("statistics",
                             dbgs() << "Line Scope UnMatched Before BB:"
                                    << bbBefore->getName() << "\n");
           }
         }
-        unMatchedBBs.insert(pairedBlocks.begin(), pairedBlocks.end());
+        for (auto bb : pairedBlocks) {
+          if (!ctx.matchedIRsBefore.count(bb) &&
+              !ctx.matchedIRsAfter.count(bb)) {
+            ctx.unMatchedBBs.insert(bb);
+          }
+        }
         continue;
       }
 
       for (auto bbBefore : beforeBBs) {
         for (auto bbAfter : afterBBs) {
-          if (matchedIRsAfter.count(bbAfter)) {
+          if (ctx.matchedIRsAfter.count(bbAfter)) {
             continue;
           }
-          if (isTwoValueMatchedHelper(bbBefore, bbAfter)) {
-            if (changedFuncs.count(bbBefore->getParent())) {
+          if (isTwoValueMatchedHelper(ctx, bbBefore, bbAfter)) {
+            if (ctx.changedFuncs.count(bbBefore->getParent())) {
               DEBUG_WITH_TYPE("statistics", dbgs()
                                                 << "Line Scope Matched BB:"
                                                 << bbBefore->getName() << ", "
                                                 << bbAfter->getName() << "\n");
             }
-            matchedIRsBefore.insert({bbBefore, bbAfter});
-            matchedIRsAfter.insert({bbAfter, bbBefore});
+            ctx.matchedIRsBefore.insert({bbBefore, bbAfter});
+            ctx.matchedIRsAfter.insert({bbAfter, bbBefore});
             break;
           }
         }
-        if (!matchedIRsBefore.count(bbBefore)) {
-          if (changedFuncs.count(bbBefore->getParent())) {
+        if (!ctx.matchedIRsBefore.count(bbBefore)) {
+          if (ctx.changedFuncs.count(bbBefore->getParent())) {
             DEBUG_WITH_TYPE("statistics",
                             dbgs() << "Line Scope UnMatched Before BB:"
                                    << bbBefore->getName() << "\n");
           }
-          unMatchedBBs.insert(bbBefore);
+          ctx.unMatchedBBs.insert(bbBefore);
         }
       }
 
       for (auto bbAfter : afterBBs) {
-        if (!matchedIRsAfter.count(bbAfter)) {
-          if (changedFuncs.count(bbAfter->getParent())) {
+        if (!ctx.matchedIRsAfter.count(bbAfter)) {
+          if (ctx.changedFuncs.count(bbAfter->getParent())) {
             DEBUG_WITH_TYPE("statistics",
                             dbgs() << "Line Scope UnMatched After BB:"
                                    << bbAfter->getName() << "\n");
           }
-          unMatchedBBs.insert(bbAfter);
+          ctx.unMatchedBBs.insert(bbAfter);
         }
       }
     }
@@ -388,7 +813,7 @@ void PatchParser::matchBBByLine() {
 
 void PatchParser::matchUnChangedIRs() {
   dbgs() << "\n=======1.1 Same Line But Different IRs========\n";
-  for (auto [srcfile, lineNumMap] : unChangedMapping) {
+  for (auto [srcfile, lineNumMap] : ctx.unChangedMapping) {
     for (auto [beforeLine, afterLine] : lineNumMap) {
       vector<Instruction *> beforeIRs, afterIRs;
 
@@ -408,17 +833,18 @@ void PatchParser::matchUnChangedIRs() {
           continue;
         }
         bool find_match = false;
-        if (matchedIRsBefore.count(beforeIR)) {
+        if (ctx.matchedIRsBefore.count(beforeIR)) {
           find_match = true;
         } else {
           for (auto afterIR : afterIRs) {
             if (isCurrentIRSkipMatch(afterIR)) {
               continue;
             }
-            if (matchedIRsAfter.find(afterIR) != matchedIRsAfter.end()) {
+            if (ctx.matchedIRsAfter.find(afterIR) !=
+                ctx.matchedIRsAfter.end()) {
               continue;
             }
-            if (!isTwoIRMatched(beforeIR, afterIR, true)) {
+            if (!isTwoIRMatched(ctx, beforeIR, afterIR, true)) {
               continue;
             }
             find_match = true;
@@ -438,11 +864,12 @@ void PatchParser::matchUnChangedIRs() {
           if (DumpDiffProcess.getValue()) {
             for (auto afterIR : afterIRs) {
               dbgs() << "\tCompare with candidate IR: " << *afterIR << "\n";
-              if (matchedIRsAfter.find(afterIR) != matchedIRsAfter.end() &&
-                  isTwoIRMatched(beforeIR, afterIR, true)) {
+              if (ctx.matchedIRsAfter.find(afterIR) !=
+                      ctx.matchedIRsAfter.end() &&
+                  isTwoIRMatched(ctx, beforeIR, afterIR, true)) {
 
                 dbgs() << "\tCompare with candidate IR: "
-                       << *matchedIRsAfter[afterIR] << "\n";
+                       << *ctx.matchedIRsAfter[afterIR] << "\n";
               }
             }
           }
@@ -451,7 +878,7 @@ void PatchParser::matchUnChangedIRs() {
 
       is_print = false;
       for (auto afterIR : afterIRs) {
-        if (matchedIRsAfter.find(afterIR) == matchedIRsAfter.end() &&
+        if (ctx.matchedIRsAfter.find(afterIR) == ctx.matchedIRsAfter.end() &&
             !isCurrentIRSkipMatch(afterIR)) {
           if (!is_print) {
             dbgs() << "\n===============Line: " << srcfile << " +" << afterLine
@@ -463,9 +890,11 @@ void PatchParser::matchUnChangedIRs() {
           addedValues.insert(afterIR);
           if (DumpDiffProcess.getValue()) {
             for (auto beforeIR : beforeIRs) {
-              if (matchedIRsBefore.find(beforeIR) == matchedIRsBefore.end()) {
+              if (ctx.matchedIRsBefore.find(beforeIR) ==
+                  ctx.matchedIRsBefore.end()) {
                 dbgs() << "\tCompare with candidate IR: " << *beforeIR << "\n";
-                dbgs() << "\t" << isTwoIRMatched(beforeIR, afterIR) << "\n";
+                dbgs() << "\t" << isTwoIRMatched(ctx, beforeIR, afterIR)
+                       << "\n";
               }
             }
           }
@@ -479,7 +908,7 @@ void PatchParser::matchAndDiffChangedIRs() {
   dbgs() << "\n=======1.2 Different Line And Different IRs========\n";
   // add instructions in changed mapping into addedValues/removedValues,
   // since we cannot determine their equivalence so far
-  for (auto [srcfile, lineNumMap] : changedMapping) {
+  for (auto [srcfile, lineNumMap] : ctx.changedMapping) {
     for (auto [beforeLine, afterLine] : lineNumMap) {
 
       // necessary for later printing
@@ -581,105 +1010,117 @@ set<Function *> PatchParser::findEnclosedFunc(string srcFile, int line,
                                               bool isAdded) {
   set<Function *> enclosedFuncs;
 
-  for (auto [func, pair] : funcLineScope) {
-    if (isAdded && !func->getName().startswith("after.patch.")) {
-      continue;
-    }
-    if (!isAdded && !func->getName().startswith("before.patch.")) {
-      continue;
-    }
-
-    if (funcSourceFile[func] == srcFile && line >= pair.first &&
-        line <= pair.second) {
-      enclosedFuncs.insert(func);
+  auto it = funcIntervals.find({srcFile, isAdded});
+  if (it == funcIntervals.end()) {
+    return enclosedFuncs;
+  }
+  auto &scopes = it->second.scopes;
+  auto &maxEnd = it->second.maxEnd;
+
+  // scopes starting after line cannot enclose it
+  size_t end = upper_bound(scopes.begin(), scopes.end(), line,
+                           [](int line, const pair<pair<int, int>,
+                                                   Function *> &scope) {
+                             return line < scope.first.first;
+                           }) -
+               scopes.begin();
+  for (size_t i = end; i > 0 && maxEnd[i - 1] >= line; i--) {
+    if (scopes[i - 1].first.second >= line) {
+      enclosedFuncs.insert(scopes[i - 1].second);
     }
   }
   return enclosedFuncs;
 }
 
+// whether inst is on a line added to its after-patch function or removed from
+// its before-patch function
+bool PatchParser::isIROnChangedLine(Instruction *inst) {
+  auto func = inst->getParent()->getParent();
+  auto line = guessInstructionLineNum(inst);
+  if (!line) {
+    return false;
+  }
+  string srcfile = funcSourceFile[func];
+  if (func->getName().startswith("after.patch.")) {
+    return isLineAdded(srcfile, line);
+  }
+  return isLineRemoved(srcfile, line);
+}
+
 bool PatchParser::isLineAdded(const std::string &srcfile, int lineNum) {
-  return std::any_of(addedLines.begin(), addedLines.end(),
-                     [lineNum, &srcfile](const ChangedLine &added) {
-                       return added.line == lineNum &&
-                              added.sourceFile == srcfile;
-                     });
+  auto it = addedLineSet.find(srcfile);
+  return it != addedLineSet.end() && it->second.count(lineNum);
 }
 
 bool PatchParser::isLineRemoved(const std::string &srcfile, int lineNum) {
-  return std::any_of(removedLines.begin(), removedLines.end(),
-                     [lineNum, &srcfile](const ChangedLine &removed) {
-                       return removed.line == lineNum &&
-                              removed.sourceFile == srcfile;
-                     });
+  auto it = removedLineSet.find(srcfile);
+  return it != removedLineSet.end() && it->second.count(lineNum);
 }
 
 // give the line number and function, return all instructions in the function
 // that at specific line number
 void PatchParser::getLineNumInsts(Function *func, int line,
                                   vector<Instruction *> &insts) {
+  auto funcIt = funcLineInsts.find(func);
+  if (funcIt == funcLineInsts.end()) {
+    return;
+  }
+  auto lineIt = funcIt->second.find(line);
+  if (lineIt != funcIt->second.end()) {
+    insts.insert(insts.end(), lineIt->second.begin(), lineIt->second.end());
+  }
+}
 
-  for (BasicBlock &bb : *func) {
-    int bb_start_line = blockLineScope[&bb].first;
-    int bb_end_line = blockLineScope[&bb].second;
-
-    if (bb_start_line > line || bb_end_line < line) {
+// the instructions of bb that may be mapped to a source line, with their
+// line numbers
+void PatchParser::collectBlockLines(
+    BasicBlock &bb, vector<pair<Instruction *, int>> &inst2Line) {
+  for (Instruction &i : bb) {
+    if (isa<ReturnInst>(&i)) {
       continue;
     }
-
-    vector<pair<Instruction *, int>> inst2Line;
-    for (Instruction &i : bb) {
-      if (isa<ReturnInst>(&i)) {
+    if (auto *br_inst = dyn_cast<BranchInst>(&i)) {
+      if (!br_inst->isConditional()) {
         continue;
       }
-      if (auto *br_inst = dyn_cast<BranchInst>(&i)) {
-        if (!br_inst->isConditional()) {
-          continue;
-        }
-      }
-      auto ir_line = guessInstructionLineNum(&i);
-      if (!ir_line) {
-        continue;
-      }
-      if (is_excopy_val(&i)) {
+    }
+    auto ir_line = guessInstructionLineNum(&i);
+    if (!ir_line) {
+      continue;
+    }
+    if (is_excopy_val(&i)) {
+      continue;
+    }
+    if (auto *callInst = dyn_cast<CallInst>(&i)) {
+      if (callInst->getCalledFunction() &&
+          callInst->getCalledFunction()->hasName() &&
+          callInst->getCalledFunction()->getName().startswith("llvm.")) {
         continue;
       }
-      if (auto *callInst = dyn_cast<CallInst>(&i)) {
-        if (callInst->getCalledFunction() &&
-            callInst->getCalledFunction()->hasName() &&
-            callInst->getCalledFunction()->getName().startswith("llvm.")) {
-          continue;
-        }
-      }
-      // if (changedFuncs.count(func)) {
-      //   dbgs() << "Line: " << ir_line << ", Site: " << i << "\n";
-      // }
-      inst2Line.emplace_back(&i, ir_line);
     }
+    // if (ctx.changedFuncs.count(func)) {
+    //   dbgs() << "Line: " << ir_line << ", Site: " << i << "\n";
+    // }
+    inst2Line.emplace_back(&i, ir_line);
+  }
 
-    // below are some heuristics to filter out the invalid line number,
-    // for instance, the number of current instruction maybe larger than the
-    // next inst
-    int last_line = -1;
-    for (auto it1 = inst2Line.begin(); it1 != inst2Line.end(); it1++) {
-      if (last_line == -1) {
-        last_line = it1->second;
-        continue;
-      }
-      if (it1->second < last_line) {
-        for (auto it2 = it1; it2 != inst2Line.begin(); it2--) {
-          if (it2->second > it1->second) {
-            it2->second = it1->second;
-          }
-        }
-      }
+  // below are some heuristics to filter out the invalid line number,
+  // for instance, the number of current instruction maybe larger than the
+  // next inst
+  int last_line = -1;
+  for (auto it1 = inst2Line.begin(); it1 != inst2Line.end(); it1++) {
+    if (last_line == -1) {
       last_line = it1->second;
+      continue;
     }
-
-    for (auto &it : inst2Line) {
-      if (it.second == line) {
-        insts.push_back(it.first);
+    if (it1->second < last_line) {
+      for (auto it2 = it1; it2 != inst2Line.begin(); it2--) {
+        if (it2->second > it1->second) {
+          it2->second = it1->second;
+        }
       }
     }
+    last_line = it1->second;
   }
 }
 
@@ -2,9 +2,12 @@
 #include "Checker/CBCheckerManager.h"
 #include "Checker/CBPluginPass.h"
 #include "EnhancedSEG.h"
+#include "JobServer.h"
 #include "Platform/OS/Profiler.h"
 #include <llvm/IR/Module.h>
+#include <fstream>
 #include <llvm/Support/Debug.h>
+#include <sstream>
 using namespace llvm;
 using namespace std;
 
@@ -31,6 +34,12 @@ static cl::opt<std::string>
     Output("output", cl::desc("Dump generated specifications into output file"),
            cl::init(""), cl::Hidden);
 
+static cl::opt<std::string> InferPatchManifest(
+    "infer-patch-manifest",
+    cl::desc("Extract specifications for each \"<patch> <output>\" line of "
+             "the manifest, sharing the analyses of the module."),
+    cl::value_desc("file Name"), cl::init(""), cl::Hidden);
+
 static cl::opt<bool, false>
     DetectPatchBug("detect-patch-bug",
                    cl::desc("Detect bugs using patch specifications."),
@@ -40,10 +49,34 @@ static cl::opt<std::string>
     Specs("specs", cl::desc("Input specifications generated from patches"),
           cl::init(""), cl::Hidden);
 
+static cl::opt<bool, false>
+    Serve("serve",
+          cl::desc("Keep the analyses of the module loaded and run "
+                   "\"infer <patch> [output]\" and \"detect <specs>\" jobs "
+                   "until \"quit\" or the end of input. Detect jobs reply "
+                   "with source/sink candidates, the checkers report bugs "
+                   "after \"quit\"."),
+          cl::init(false), cl::Hidden);
+
+static cl::opt<std::string> ServeSocket(
+    "serve-socket",
+    cl::desc("Read the jobs of -serve from this Unix socket instead of stdin."),
+    cl::value_desc("socket path"), cl::init(""), cl::Hidden);
+
 static cl::opt<std::string> Peers("peer", cl::desc("Peer function information"),
                                   cl::value_desc("file Name"), cl::ReallyHidden,
                                   cl::ValueOptional, cl::init(""));
 
+// the replies of -serve on stdout must not interleave with progress logs
+static raw_ostream &progress() { return Serve.getValue() ? errs() : outs(); }
+
+// the profiler reports on stdout, so -serve keeps it quiet
+static void printSnapshot(Profiler &profiler, const char *title) {
+  if (!Serve.getValue()) {
+    profiler.print_snapshot_result(title);
+  }
+}
+
 static CBPluginPassRegistry<SEGPathDiff>
     X("patch-plugin", "Run spec inference and bug detection plugin.");
 
@@ -78,7 +111,7 @@ void SEGPathDiff::runOnModule(llvm::Module &M) {
   SEGWrapper = new EnhancedSEGWrapper(&M, SEGBuilder, pSolver, pDIA, pCBCG,
                                       pCDGs, pCRA, pDT);
 
-  outs() << "Starting Checking..";
+  progress() << "Starting Checking..";
   if (DumpIndirectCall.getValue()) {
     // output all indirect called functions
 
@@ -127,62 +160,208 @@ void SEGPathDiff::runOnModule(llvm::Module &M) {
         }
       }
     }
+  } else if (Serve.getValue()) {
+    serve(M);
+  } else if (!InferPatchManifest.getValue().empty()) {
+    ifstream manifest(InferPatchManifest.getValue());
+    if (manifest.fail()) {
+      errs() << "Cannot open patch manifest " << InferPatchManifest.getValue()
+             << "\n";
+      return;
+    }
+    string line;
+    while (getline(manifest, line)) {
+      istringstream fields(line);
+      string patchFile, outputFile;
+      if (!(fields >> patchFile) || patchFile[0] == '#') {
+        continue;
+      }
+      fields >> outputFile;
+      outs() << "\n[Patch]: " << patchFile << "\n";
+      inferPatchSpec(M, patchFile, outputFile);
+    }
   } else if (InferPatchSpec.getValue()) {
-    Profiler TimeMemProfiler(Profiler::TIME | Profiler::MEMORY);
-    Profiler TimeMemProfiler1(Profiler::TIME | Profiler::MEMORY);
-
-    // step 1: changes in code => changes in values
-    // input: LLVM IR before and after changes, patch file
-    // output: (V-, V+, V=)
-    outs() << "\n[Phase 1]: Parsing added/removed LLVM values from patch...\n";
-    patchParser = new PatchParser(&M, pDIA, Patch.getValue());
-    patchParser->parseIRChanges();
-
-    outs() << "\n";
-    TimeMemProfiler1.create_snapshot();
-    TimeMemProfiler1.print_snapshot_result("Patch analysis stage 1 done");
-
-    Profiler TimeMemProfiler2(Profiler::TIME | Profiler::MEMORY);
-    // step 2: changes in value => changes in graph
-    // input: (V-, V+, V=)
-    // output: (S-, _), (S+, _), (S-, S+), (S, S)
-    outs() << "\n[Phase 2]: Found added/removed value flows from add/removed "
-              "LLVM values...\n";
-    graphParser = new GraphDiffer(SEGWrapper, pSolver);
-    graphParser->parseValueFlowChanges(patchParser->addedValues,
-                                       patchParser->removedValues);
-
-    outs() << "\n";
-    TimeMemProfiler2.create_snapshot();
-    TimeMemProfiler2.print_snapshot_result("Patch analysis stage 2 done");
-
-    Profiler TimeMemProfiler3(Profiler::TIME | Profiler::MEMORY);
-
-    // step 3: bug spec inference
-    // input: (S-, _), (S+, _), (S-, S+), (S, S)
-    // output: (X, Y) + cond + order
-    outs() << "\n[Phase 3]: Summarize bug specifications from add/removed "
-              "value flows...\n";
-    specParser = new SpecParser(SEGWrapper, graphParser);
-    specParser->abstractBugSpec(Output.getValue());
-    outs() << "\n";
-    TimeMemProfiler3.create_snapshot();
-    TimeMemProfiler3.print_snapshot_result("Patch analysis stage 3 done");
-
-    outs() << "\n";
-    TimeMemProfiler.create_snapshot();
-    TimeMemProfiler.print_snapshot_result("Patch analysis done");
+    inferPatchSpec(M, Patch.getValue(), Output.getValue());
   } else if (DetectPatchBug) {
-    graphParser = new GraphDiffer(SEGWrapper, pSolver);
-    specParser = new SpecParser(SEGWrapper, graphParser);
+    loadDetectionCheckers(Specs.getValue(), customizedCheckers);
 
-    // step 4: bug matching
-    // input: (X, Y) + cond + order
-    // output: customized bug checkers
-    specParser->loadSpecFromFile(Specs.getValue());
-    specParser->transformToCheckers();
-    customizedCheckers = specParser->customizedCheckers;
+    CBCheckerManager *checker_mgr = CBCheckerManager::getCheckerManager();
+    checker_mgr->initializeExternalCheckers(&M, customizedCheckers);
+  }
+}
+
+void SEGPathDiff::inferPatchSpec(Module &M, const string &patchFile,
+                                 const string &outputFile) {
+  // objects of the previous patch of a manifest or of -serve
+  delete specParser;
+  delete graphParser;
+  delete patchParser;
+  delete patchContext;
+  patchContext = new PatchContext;
+  SEGWrapper->resetPatchState();
+
+  Profiler TimeMemProfiler(Profiler::TIME | Profiler::MEMORY);
+  Profiler TimeMemProfiler1(Profiler::TIME | Profiler::MEMORY);
+
+  // step 1: changes in code => changes in values
+  // input: LLVM IR before and after changes, patch file
+  // output: (V-, V+, V=)
+  progress()
+      << "\n[Phase 1]: Parsing added/removed LLVM values from patch...\n";
+  patchParser = new PatchParser(&M, pDIA, *patchContext, patchFile);
+  patchParser->parseIRChanges();
+
+  progress() << "\n";
+  TimeMemProfiler1.create_snapshot();
+  printSnapshot(TimeMemProfiler1, "Patch analysis stage 1 done");
+
+  Profiler TimeMemProfiler2(Profiler::TIME | Profiler::MEMORY);
+  // step 2: changes in value => changes in graph
+  // input: (V-, V+, V=)
+  // output: (S-, _), (S+, _), (S-, S+), (S, S)
+  progress() << "\n[Phase 2]: Found added/removed value flows from "
+                "add/removed LLVM values...\n";
+  graphParser = new GraphDiffer(SEGWrapper, pSolver, *patchContext);
+  graphParser->parseValueFlowChanges(patchParser->addedValues,
+                                     patchParser->removedValues);
+
+  progress() << "\n";
+  TimeMemProfiler2.create_snapshot();
+  printSnapshot(TimeMemProfiler2, "Patch analysis stage 2 done");
+
+  Profiler TimeMemProfiler3(Profiler::TIME | Profiler::MEMORY);
+
+  // step 3: bug spec inference
+  // input: (S-, _), (S+, _), (S-, S+), (S, S)
+  // output: (X, Y) + cond + order
+  progress() << "\n[Phase 3]: Summarize bug specifications from "
+                "add/removed value flows...\n";
+  specParser = new SpecParser(SEGWrapper, graphParser);
+  specParser->abstractBugSpec(outputFile);
+  progress() << "\n";
+  TimeMemProfiler3.create_snapshot();
+  printSnapshot(TimeMemProfiler3, "Patch analysis stage 3 done");
+
+  progress() << "\n";
+  TimeMemProfiler.create_snapshot();
+  printSnapshot(TimeMemProfiler, "Patch analysis done");
+}
+
+void SEGPathDiff::loadDetectionCheckers(
+    const string &specFile, vector<shared_ptr<Vulnerability>> &checkers) {
+  // referred to by the checkers for the rest of the run
+  auto *detectContext = new PatchContext;
+  auto *differ = new GraphDiffer(SEGWrapper, pSolver, *detectContext);
+  auto *parser = new SpecParser(SEGWrapper, differ);
+
+  // step 4: bug matching
+  // input: (X, Y) + cond + order
+  // output: customized bug checkers
+  parser->loadSpecFromFile(specFile);
+  parser->transformToCheckers();
+  checkers.insert(checkers.end(), parser->customizedCheckers.begin(),
+                  parser->customizedCheckers.end());
+}
+
+static string siteLocation(SEGSiteBase *site) {
+  auto *inst = site->getInstruction();
+  if (auto *loc = getSourceLocation(inst)) {
+    return getFileName(loc) + ":" + to_string(loc->getLineNumber());
+  }
+  return inst->getParent()->getParent()->getName().str();
+}
+
+void SEGPathDiff::matchDetectionCheckers(
+    Module &M, const vector<shared_ptr<Vulnerability>> &checkers,
+    vector<string> &candidates) {
+  for (size_t i = 0; i < checkers.size(); i++) {
+    auto &checker = checkers[i];
+    vector<pair<Function *, SEGSiteBase *>> sources, sinks;
+    auto matchNode = [&](Function *func, SEGNodeBase *node) {
+      for (auto it = node->use_site_begin(); it != node->use_site_end();
+           it++) {
+        if (checker->isSource(node, *it)) {
+          sources.push_back({func, *it});
+        }
+        if (checker->isSink(node, *it)) {
+          sinks.push_back({func, *it});
+        }
+      }
+    };
+    for (Function &F : M) {
+      if (F.isDeclaration()) {
+        continue;
+      }
+      auto *SEG = SEGBuilder->getSymbolicExprGraph(&F);
+      if (!SEG) {
+        continue;
+      }
+      for (auto it = SEG->value_node_begin(); it != SEG->value_node_end();
+           it++) {
+        matchNode(&F, it->second);
+      }
+      for (auto it = SEG->non_value_node_begin();
+           it != SEG->non_value_node_end(); it++) {
+        matchNode(&F, *it);
+      }
+    }
+
+    for (auto &source : sources) {
+      for (auto &sink : sinks) {
+        if (SEGWrapper->isTransitiveCallee(source.first, sink.first)) {
+          candidates.push_back("candidate " + to_string(i) + " " +
+                               siteLocation(source.second) + " -> " +
+                               siteLocation(sink.second));
+        }
+      }
+    }
+  }
+}
+
+void SEGPathDiff::serve(Module &M) {
+  JobServer server(ServeSocket.getValue());
+  if (!server.isReady()) {
+    errs() << "Cannot listen on " << ServeSocket.getValue() << "\n";
+    return;
+  }
+  progress() << "\n[Serve]: Waiting for jobs...\n";
+
+  string job;
+  while (server.next(job)) {
+    istringstream fields(job);
+    string command, file, outputFile;
+    fields >> command >> file >> outputFile;
+    if (command[0] == '#') {
+      continue;
+    }
+    if (command == "quit") {
+      server.reply("ok quit");
+      break;
+    }
+    if (command == "infer" && !file.empty()) {
+      inferPatchSpec(M, file, outputFile);
+      server.reply("ok infer " + file);
+    } else if (command == "detect" && !file.empty()) {
+      vector<shared_ptr<Vulnerability>> checkers;
+      loadDetectionCheckers(file, checkers);
+      vector<string> candidates;
+      matchDetectionCheckers(M, checkers, candidates);
+      for (auto &candidate : candidates) {
+        server.reply(candidate);
+      }
+      server.reply("ok detect " + file + " " + to_string(checkers.size()) +
+                   " checkers " + to_string(candidates.size()) +
+                   " candidates");
+      customizedCheckers.insert(customizedCheckers.end(), checkers.begin(),
+                                checkers.end());
+    } else {
+      server.reply("error unknown job: " + job);
+    }
+  }
 
+  // the candidates above are only flow-insensitive source and sink pairs,
+  // the checker engine reports bugs once this pass is done
+  if (!customizedCheckers.empty()) {
     CBCheckerManager *checker_mgr = CBCheckerManager::getCheckerManager();
     checker_mgr->initializeExternalCheckers(&M, customizedCheckers);
   }
@@ -24,47 +24,59 @@ void obtainSensitive(const vector<SEGObject *> &segTrace,
   }
 }
 
-OutputNode *isNullPtrDerefSite(SEGNodeBase *node, SEGSiteBase *site) {
+static bool matchNullPtrDerefSite(SEGNodeBase *node, SEGSiteBase *site) {
   // 1. deref pointer or struct
   // 2. access memory with load
   // 3. access memory with store
 
   if (!isa<SEGOperandNode>(node)) {
-    return nullptr;
+    return false;
   }
 
   auto *operandNode = dyn_cast<SEGOperandNode>(node);
   if (auto *derefSite = dyn_cast<SEGDereferenceSite>(site)) {
-    if (derefSite->deref(operandNode)) {
-      auto output = new SensitiveOpNode(
-          "deref", -1, operandNode->getParentGraph()->getBaseFunc()->getName());
-      output->usedNode = node;
-      output->usedSite = site;
-      return (OutputNode *)output;
-    }
+    return derefSite->deref(operandNode);
   }
-  return nullptr;
+  return false;
 }
 
-OutputNode *isDivideByZeroSite(SEGNodeBase *node, SEGSiteBase *site) {
+OutputNode *isNullPtrDerefSite(SEGNodeBase *node, SEGSiteBase *site) {
+  if (!matchNullPtrDerefSite(node, site)) {
+    return nullptr;
+  }
+  auto output = new SensitiveOpNode(
+      "deref", -1, node->getParentGraph()->getBaseFunc()->getName());
+  output->usedNode = node;
+  output->usedSite = site;
+  return (OutputNode *)output;
+}
+
+static bool matchDivideByZeroSite(SEGNodeBase *node, SEGSiteBase *site) {
   if (!isa<SEGDivSite>(site) || !isa<SEGOperandNode>(node) ||
       !node->getLLVMDbgValue()) {
-    return nullptr;
+    return false;
   }
   auto *divSite = dyn_cast<SEGDivSite>(site);
-  if (divSite->getSEGValue()->isDivInst() &&
-      node->getLLVMDbgValue() ==
-          site->getSEGValue()->getInstOperand(1)->getValue()) {
-    auto output = new SensitiveOpNode(
-        "div", 1, site->getParentGraph()->getBaseFunc()->getName());
-    output->usedNode = node;
-    output->usedSite = site;
-    return (OutputNode *)output;
+  return divSite->getSEGValue()->isDivInst() &&
+         node->getLLVMDbgValue() ==
+             site->getSEGValue()->getInstOperand(1)->getValue();
+}
+
+OutputNode *isDivideByZeroSite(SEGNodeBase *node, SEGSiteBase *site) {
+  if (!matchDivideByZeroSite(node, site)) {
+    return nullptr;
   }
-  return nullptr;
+  auto output = new SensitiveOpNode(
+      "div", 1, site->getParentGraph()->getBaseFunc()->getName());
+  output->usedNode = node;
+  output->usedSite = site;
+  return (OutputNode *)output;
 }
 
-OutputNode *isOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site) {
+// return the memcpy-like callee if node is used as its size argument
+static Function *matchOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site,
+                                        int &ArgNo) {
+  ArgNo = -1;
   if (!isa<SEGOperandNode>(node) || !node->getLLVMDbgValue()) {
     return nullptr;
   }
@@ -73,7 +85,6 @@ OutputNode *isOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site) {
       Function *F = CS->getCalledFunction();
       if ((F->isIntrinsic() && F->getIntrinsicID() == Intrinsic::memcpy) ||
           (F->hasName() && F->getName().equals("__memcpy"))) {
-        int ArgNo = -1;
         for (int j = 0; j < CS->getLLVMCallSite().arg_size(); j++) {
           if (node->getLLVMDbgValue() == CS->getLLVMCallSite().getArgument(j)) {
             ArgNo = j;
@@ -81,15 +92,36 @@ OutputNode *isOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site) {
           }
         }
         if (ArgNo == 2) {
-          auto output = new SensitiveAPINode(
-              F->getName(), ArgNo,
-              node->getParentGraph()->getBaseFunc()->getName());
-          output->usedNode = node;
-          output->usedSite = site;
-          return (OutputNode *)output;
+          return F;
         }
       }
     }
   }
   return nullptr;
 }
+
+OutputNode *isOutOfBoundarySite(SEGNodeBase *node, SEGSiteBase *site) {
+  int ArgNo;
+  Function *F = matchOutOfBoundarySite(node, site, ArgNo);
+  if (!F) {
+    return nullptr;
+  }
+  auto output = new SensitiveAPINode(
+      F->getName(), ArgNo, node->getParentGraph()->getBaseFunc()->getName());
+  output->usedNode = node;
+  output->usedSite = site;
+  return (OutputNode *)output;
+}
+
+void obtainSensitiveTypes(SEGNodeBase *node, set<OutputType> &types) {
+  for (auto uit = node->use_site_begin(); uit != node->use_site_end(); uit++) {
+    int ArgNo;
+    if (matchDivideByZeroSite(node, *uit) ||
+        matchNullPtrDerefSite(node, *uit)) {
+      types.insert(SensitiveOp);
+    }
+    if (matchOutOfBoundarySite(node, *uit, ArgNo)) {
+      types.insert(SensitiveAPI);
+    }
+  }
+}
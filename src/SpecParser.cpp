@@ -415,7 +415,7 @@ void SpecParser::specToOutput(string outputFile) {
       SEGWrapper->SEGSolver->add(
           SEGWrapper->condNode2SMTExprInter(item->conditions));
       SEGWrapper->SEGSolver->add(
-          item->conditions->toSMTExpr(SEGWrapper->SEGSolver));
+          SEGWrapper->condNode2SMTExpr(item->conditions));
       smt_string = SEGWrapper->SEGSolver->to_smt2();
       SEGWrapper->SEGSolver->pop();
 
@@ -459,7 +459,7 @@ void SpecParser::specToOutput(string outputFile) {
       SEGWrapper->SEGSolver->add(
           SEGWrapper->condNode2SMTExprInter(item->conditions));
       SEGWrapper->SEGSolver->add(
-          item->conditions->toSMTExpr(SEGWrapper->SEGSolver));
+          SEGWrapper->condNode2SMTExpr(item->conditions));
       smt_string = SEGWrapper->SEGSolver->to_smt2();
       SEGWrapper->SEGSolver->pop();
 
@@ -503,7 +503,7 @@ void SpecParser::specToOutput(string outputFile) {
       SEGWrapper->SEGSolver->add(
           SEGWrapper->condNode2SMTExprInter(item->conditions));
       SEGWrapper->SEGSolver->add(
-          item->conditions->toSMTExpr(SEGWrapper->SEGSolver));
+          SEGWrapper->condNode2SMTExpr(item->conditions));
       smt_string = SEGWrapper->SEGSolver->to_smt2();
       SEGWrapper->SEGSolver->pop();
 
@@ -624,7 +624,7 @@ void SpecParser::handleDiffCondition() {
           dbgs() << "\n=======Condition Single Src Single Sink Spec Start #"
                  << condPairs.size() << "======\n");
       // diff condition and generate bug spec;
-      auto notDiff = new ConditionNode(diff->SEGWrapper, NODE_NOT);
+      auto notDiff = diff->SEGWrapper->newCondition(NODE_NOT);
       notDiff->addChild(diff);
       dbgs() << "\n[Spec Type] Src Must Not Reach Sink\n";
       dbgs() << "[Start " << afterfuncName
@@ -1001,7 +1001,18 @@ void SpecParser::filterInvalidCond(vector<SEGObject *> &guardedTrace,
     //    dbgs() << "[Invalid Cond Node] " << *node << "\n";
     condNode->eliminateCond(node);
   }
-  condNode->simplify();
+  auto simplified = ConditionTree::simplifyCondition(SEGWrapper, condNode);
+  if (simplified) {
+    condNode->type = simplified->type;
+    condNode->value = simplified->value;
+    condNode->children = simplified->children;
+  } else {
+    // never holds, kept as the empty OR that encodes false
+    DEBUG_WITH_TYPE("condition", dbgs() << "Unsatisfiable condition\n");
+    condNode->type = NODE_OR;
+    condNode->value = nullptr;
+    condNode->children.clear();
+  }
   //  dbgs() << "===After Remove Invalid Cond:\n " << condNode->dump() << "\n";
   vf_stop = chrono::high_resolution_clock::now();
   vf_duration =
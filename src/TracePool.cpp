@@ -0,0 +1,72 @@
+#include "TracePool.h"
+#include <llvm/ADT/Hashing.h>
+#include <algorithm>
+
+uint32_t TracePool::getObjectId(SEGObject *object) {
+  auto it = objectIds.find(object);
+  if (it != objectIds.end()) {
+    return it->second;
+  }
+  objectIds[object] = objects.size();
+  objects.push_back(object);
+  return objects.size() - 1;
+}
+
+pair<TracePool::Handle, bool>
+TracePool::insert(const vector<SEGObject *> &trace) {
+  uint32_t offset = buffer.size();
+  for (auto object : trace) {
+    buffer.push_back(getObjectId(object));
+  }
+  return commit(offset);
+}
+
+void TracePool::merge(const TracePool &other, vector<Handle> *remap) {
+  if (remap) {
+    remap->clear();
+    remap->reserve(other.spans.size());
+  }
+  for (auto [begin, length] : other.spans) {
+    uint32_t offset = buffer.size();
+    for (uint32_t i = begin; i < begin + length; i++) {
+      buffer.push_back(getObjectId(other.objects[other.buffer[i]]));
+    }
+    auto handle = commit(offset).first;
+    if (remap) {
+      remap->push_back(handle);
+    }
+  }
+}
+
+vector<SEGObject *> TracePool::get(Handle handle) const {
+  auto [begin, length] = spans[handle];
+  vector<SEGObject *> trace;
+  trace.reserve(length);
+  for (uint32_t i = begin; i < begin + length; i++) {
+    trace.push_back(objects[buffer[i]]);
+  }
+  return trace;
+}
+
+pair<TracePool::Handle, bool> TracePool::commit(uint32_t offset) {
+  uint32_t length = buffer.size() - offset;
+  size_t hash = length;
+  for (uint32_t i = offset; i < buffer.size(); i++) {
+    hash = hash_combine(hash, buffer[i]);
+  }
+
+  auto &bucket = buckets[hash];
+  for (auto handle : bucket) {
+    auto [begin, otherLength] = spans[handle];
+    if (otherLength == length &&
+        equal(buffer.begin() + begin, buffer.begin() + begin + length,
+              buffer.begin() + offset)) {
+      buffer.resize(offset);
+      return {handle, false};
+    }
+  }
+  Handle handle = spans.size();
+  bucket.push_back(handle);
+  spans.push_back({offset, length});
+  return {handle, true};
+}
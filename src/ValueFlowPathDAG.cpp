@@ -0,0 +1,157 @@
+#include "ValueFlowPathDAG.h"
+#include <llvm/ADT/Hashing.h>
+#include <algorithm>
+
+ValueFlowPathDAG::ValueFlowPathDAG(unsigned tag) : tag(tag) {
+  emptyPath = getOrInsert(nullptr, true, {});
+}
+
+PathDAGNode *ValueFlowPathDAG::getOrInsert(SEGObject *head, bool terminal,
+                                           vector<PathDAGNode *> succs) {
+  // canonical successor order, also removes duplicated paths
+  sort(succs.begin(), succs.end(),
+       [](const PathDAGNode *a, const PathDAGNode *b) {
+         return a->id < b->id;
+       });
+  succs.erase(unique(succs.begin(), succs.end()), succs.end());
+
+  size_t hash = hash_combine(std::hash<SEGObject *>()(head), terminal);
+  for (auto succ : succs) {
+    hash = hash_combine(hash, succ->id);
+  }
+
+  auto &bucket = buckets[hash];
+  for (auto candidate : bucket) {
+    if (candidate->head == head && candidate->terminal == terminal &&
+        candidate->succs == succs) {
+      return candidate;
+    }
+  }
+
+  nodes.emplace_back(head, terminal, std::move(succs),
+                     (tag << 32) | nodes.size(), hash);
+  bucket.push_back(&nodes.back());
+  return &nodes.back();
+}
+
+uint64_t ValueFlowPathDAG::countPaths(PathDAGNode *node) {
+  if (!node) {
+    return 0;
+  }
+  if (node->numPathsComputed) {
+    return node->numPaths;
+  }
+  uint64_t total = node->terminal ? 1 : 0;
+  for (auto succ : node->succs) {
+    uint64_t succPaths = countPaths(succ);
+    total = (total > UINT64_MAX - succPaths) ? UINT64_MAX : total + succPaths;
+  }
+  node->numPaths = total;
+  node->numPathsComputed = true;
+  return total;
+}
+
+const map<unsigned, uint64_t> &
+ValueFlowPathDAG::lengthHistogram(PathDAGNode *node) {
+  auto it = lengthHistograms.find(node);
+  if (it != lengthHistograms.end()) {
+    return it->second;
+  }
+
+  map<unsigned, uint64_t> histogram;
+  unsigned headLen = node->head ? 1 : 0;
+  if (node->terminal) {
+    histogram[headLen] += 1;
+  }
+  for (auto succ : node->succs) {
+    for (auto [len, num] : lengthHistogram(succ)) {
+      histogram[len + headLen] += num;
+    }
+  }
+  return lengthHistograms[node] = histogram;
+}
+
+void ValueFlowPathDAG::collectPathEnds(PathDAGNode *node,
+                                       set<SEGObject *> &ends) {
+  if (!node) {
+    return;
+  }
+  set<PathDAGNode *> visited;
+  vector<PathDAGNode *> worklist = {node};
+  while (!worklist.empty()) {
+    auto curNode = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(curNode).second) {
+      continue;
+    }
+    if (curNode->terminal && curNode->head) {
+      ends.insert(curNode->head);
+    }
+    worklist.insert(worklist.end(), curNode->succs.begin(),
+                    curNode->succs.end());
+  }
+}
+
+bool ValueFlowPathDAG::forEachPath(
+    PathDAGNode *node,
+    const function<bool(const vector<SEGObject *> &)> &visitor) {
+  if (!node) {
+    return true;
+  }
+  vector<SEGObject *> curPath;
+  return forEachPath(node, curPath, visitor);
+}
+
+bool ValueFlowPathDAG::forEachPath(
+    PathDAGNode *node, vector<SEGObject *> &curPath,
+    const function<bool(const vector<SEGObject *> &)> &visitor) {
+  if (node->head) {
+    curPath.push_back(node->head);
+  }
+  bool keepGoing = true;
+  if (node->terminal) {
+    keepGoing = visitor(curPath);
+  }
+  for (auto succ : node->succs) {
+    if (!keepGoing) {
+      break;
+    }
+    keepGoing = forEachPath(succ, curPath, visitor);
+  }
+  if (node->head) {
+    curPath.pop_back();
+  }
+  return keepGoing;
+}
+
+bool ValueFlowPathDAG::forEachPrefix(
+    PathDAGNode *node, const function<bool(SEGObject *)> &isEnd,
+    const function<bool(const vector<SEGObject *> &)> &visitor) {
+  if (!node) {
+    return true;
+  }
+  vector<SEGObject *> curPath;
+  return forEachPrefix(node, curPath, isEnd, visitor);
+}
+
+bool ValueFlowPathDAG::forEachPrefix(
+    PathDAGNode *node, vector<SEGObject *> &curPath,
+    const function<bool(SEGObject *)> &isEnd,
+    const function<bool(const vector<SEGObject *> &)> &visitor) {
+  if (!node->head) {
+    return true;
+  }
+  curPath.push_back(node->head);
+  bool keepGoing = true;
+  if (isEnd(node->head)) {
+    keepGoing = visitor(curPath);
+  }
+  for (auto succ : node->succs) {
+    if (!keepGoing) {
+      break;
+    }
+    keepGoing = forEachPrefix(succ, curPath, isEnd, visitor);
+  }
+  curPath.pop_back();
+  return keepGoing;
+}
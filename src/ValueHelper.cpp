@@ -1,19 +1,10 @@
 #include "ValueHelper.h"
 #include "UtilsHelper.h"
 
-set<Function *> changedFuncs;
-
-map<Value *, Value *, llvm_cmp> matchedIRsBefore;
-map<Value *, Value *, llvm_cmp> matchedIRsAfter;
-
-set<BasicBlock *> unMatchedBBs;
-
-map<string, map<int, int>> changedMapping;
-map<string, map<int, int>> unChangedMapping;
-
-bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
-  if (matchedIRsBefore.count(value1)) {
-    return matchedIRsBefore[value1] == value2;
+bool isTwoValueMatchedHelper(PatchContext &ctx, Value *value1, Value *value2,
+                             bool matchBB) {
+  if (ctx.matchedIRsBefore.count(value1)) {
+    return ctx.matchedIRsBefore[value1] == value2;
   }
 
   if (value1 == value2) {
@@ -78,7 +69,7 @@ bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
       if (isa<Instruction>(metaValue1) && isa<Instruction>(metaValue2)) {
         return true;
       }
-      if (!isTwoValueMatchedHelper(metaValue1, metaValue2, matchBB)) {
+      if (!isTwoValueMatchedHelper(ctx, metaValue1, metaValue2, matchBB)) {
         return false;
       }
     }
@@ -86,7 +77,7 @@ bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
     auto *arg1 = dyn_cast<Argument>(value1);
     auto *arg2 = dyn_cast<Argument>(value2);
     if (arg1->getParent() && arg2->getParent()) {
-      if (!isTwoValueMatchedHelper(arg1->getParent(), arg2->getParent())) {
+      if (!isTwoValueMatchedHelper(ctx, arg1->getParent(), arg2->getParent())) {
         return false;
       }
       if (arg1->getArgNo() != arg2->getArgNo()) {
@@ -123,7 +114,7 @@ bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
     }
 
     for (auto i = 0; i < constExpr1->getNumOperands(); i++) {
-      if (!isTwoValueMatchedHelper(constExpr1->getOperand(i),
+      if (!isTwoValueMatchedHelper(ctx, constExpr1->getOperand(i),
                                    constExpr2->getOperand(i))) {
         return false;
       }
@@ -134,15 +125,15 @@ bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
     auto *bb1 = dyn_cast<BasicBlock>(value1);
     auto *bb2 = dyn_cast<BasicBlock>(value2);
 
-    if (!isTwoValueMatchedHelper(bb1->getParent(), bb2->getParent())) {
+    if (!isTwoValueMatchedHelper(ctx, bb1->getParent(), bb2->getParent())) {
       return false;
     }
 
-    if (!changedFuncs.count(bb1->getParent())) {
+    if (!ctx.changedFuncs.count(bb1->getParent())) {
       return bb1->getName() == bb2->getName();
     }
 
-    if (unMatchedBBs.count(bb1) || unMatchedBBs.count(bb2)) {
+    if (ctx.unMatchedBBs.count(bb1) || ctx.unMatchedBBs.count(bb2)) {
       return false;
     }
     if (bb1->getInstList().size() != bb2->getInstList().size()) {
@@ -187,11 +178,11 @@ bool isTwoValueMatchedHelper(Value *value1, Value *value2, bool matchBB) {
         return false;
       }
     }
-    matchedIRsBefore.insert({value1, value2});
-    matchedIRsAfter.insert({value2, value1});
+    ctx.matchedIRsBefore.insert({value1, value2});
+    ctx.matchedIRsAfter.insert({value2, value1});
     return true;
   } else if (isa<Instruction>(value1)) {
-    return isTwoIRMatched(dyn_cast<Instruction>(value1),
+    return isTwoIRMatched(ctx, dyn_cast<Instruction>(value1),
                           dyn_cast<Instruction>(value2), matchBB);
   } else {
     dbgs() << "\n!!!UnHandled value " << value1->getValueName() << "\n";
@@ -227,9 +218,10 @@ bool isCurrentValueSkipMatch(Value *value) {
 }
 
 // used for pre-patch and post-patch comparison
-bool isTwoIRMatched(Instruction *inst1, Instruction *inst2, bool matchBB) {
-  if (matchedIRsBefore.find(inst1) != matchedIRsBefore.end()) {
-    if (matchedIRsBefore[inst1] == inst2) {
+bool isTwoIRMatched(PatchContext &ctx, Instruction *inst1, Instruction *inst2,
+                    bool matchBB) {
+  if (ctx.matchedIRsBefore.find(inst1) != ctx.matchedIRsBefore.end()) {
+    if (ctx.matchedIRsBefore[inst1] == inst2) {
       return true;
     }
   }
@@ -257,9 +249,9 @@ bool isTwoIRMatched(Instruction *inst1, Instruction *inst2, bool matchBB) {
       return false;
     }
 
-    if (unChangedMapping.count(src_file1)) {
-      if (unChangedMapping[src_file1].count(src_line1)) {
-        if (unChangedMapping[src_file1][src_line1] != src_line2) {
+    if (ctx.unChangedMapping.count(src_file1)) {
+      if (ctx.unChangedMapping[src_file1].count(src_line1)) {
+        if (ctx.unChangedMapping[src_file1][src_line1] != src_line2) {
           return false;
         }
       }
@@ -279,13 +271,13 @@ bool isTwoIRMatched(Instruction *inst1, Instruction *inst2, bool matchBB) {
         if (isa<Instruction>(op1) && isa<Instruction>(op2)) {
           auto *nextInst1 = dyn_cast<Instruction>(op1);
           auto *nextInst2 = dyn_cast<Instruction>(op2);
-          if (isTwoIRMatched(nextInst1, nextInst2, matchBB)) {
+          if (isTwoIRMatched(ctx, nextInst1, nextInst2, matchBB)) {
             matchedOperandIdxs.insert(j);
             has_matched = true;
             break;
           }
         } else {
-          if (isTwoValueMatchedHelper(inst1->getOperand(i),
+          if (isTwoValueMatchedHelper(ctx, inst1->getOperand(i),
                                       inst2->getOperand(j))) {
             matchedOperandIdxs.insert(j);
             has_matched = true;
@@ -313,12 +305,12 @@ bool isTwoIRMatched(Instruction *inst1, Instruction *inst2, bool matchBB) {
       if (isa<Instruction>(op1) && isa<Instruction>(op2)) {
         auto *nextInst1 = dyn_cast<Instruction>(op1);
         auto *nextInst2 = dyn_cast<Instruction>(op2);
-        if (!isTwoIRMatched(nextInst1, nextInst2, matchBB)) {
+        if (!isTwoIRMatched(ctx, nextInst1, nextInst2, matchBB)) {
           return false;
         }
       } else if (isa<BasicBlock>(op1) && isa<BasicBlock>(op2)) {
       } else {
-        if (!isTwoValueMatchedHelper(inst1->getOperand(i),
+        if (!isTwoValueMatchedHelper(ctx, inst1->getOperand(i),
                                      inst2->getOperand(i))) {
           return false;
         }
@@ -327,11 +319,11 @@ bool isTwoIRMatched(Instruction *inst1, Instruction *inst2, bool matchBB) {
   }
 
   if (matchBB &&
-      !isTwoValueMatchedHelper(inst1->getParent(), inst2->getParent())) {
+      !isTwoValueMatchedHelper(ctx, inst1->getParent(), inst2->getParent())) {
     return false;
   }
-  matchedIRsBefore.insert({inst1, inst2});
-  matchedIRsAfter.insert({inst2, inst1});
+  ctx.matchedIRsBefore.insert({inst1, inst2});
+  ctx.matchedIRsAfter.insert({inst2, inst1});
   return true;
 }
 